@@ -8,34 +8,52 @@ namespace sqrp
 	class Device;
 	class Fence;
 	class FrameBuffer;
+	class FrameCapture;
+	class FrameCommandAllocator;
 	class GUI;
 	class Image;
 	class MeshBase;
 	class GLTFMesh;
 	class Mesh;
+	class ParallelRecorder;
 	class Pipeline;
+	class PipelineStatistics;
 	class GraphicsPipeline;
 	class ComputePipeline;
+	class Profiler;
+	class RenderGraph;
 	class RenderPass;
+	class RingBuffer;
 	class Semaphore;
 	class Shader;
+	class SubmitBatch;
 	class Swapchain;
+	class TimelineSemaphore;
 
 	using BufferHandle = std::shared_ptr<Buffer>;
 	using CommandBufferHandle = std::shared_ptr<CommandBuffer>;
 	using DescriptorSetHandle = std::shared_ptr<DescriptorSet>;
 	using FenceHandle = std::shared_ptr<Fence>;
 	using FrameBufferHandle = std::shared_ptr<FrameBuffer>;
+	using FrameCaptureHandle = std::shared_ptr<FrameCapture>;
+	using FrameCommandAllocatorHandle = std::shared_ptr<FrameCommandAllocator>;
 	using GUIHandle = std::shared_ptr<GUI>;
 	using ImageHandle = std::shared_ptr<Image>;
 	using MeshBaseHandle = std::shared_ptr<MeshBase>;
 	using GLTFMeshHandle = std::shared_ptr<GLTFMesh>;
 	using MeshHandle = std::shared_ptr<Mesh>;
+	using ParallelRecorderHandle = std::shared_ptr<ParallelRecorder>;
 	using GraphicsPipelineHandle = std::shared_ptr<GraphicsPipeline>;
 	using ComputePipelineHandle = std::shared_ptr<ComputePipeline>;
 	using PipelineHandle = std::shared_ptr<Pipeline>;
+	using PipelineStatisticsHandle = std::shared_ptr<PipelineStatistics>;
+	using ProfilerHandle = std::shared_ptr<Profiler>;
+	using RenderGraphHandle = std::shared_ptr<RenderGraph>;
 	using RenderPassHandle = std::shared_ptr<RenderPass>;
+	using RingBufferHandle = std::shared_ptr<RingBuffer>;
 	using SemaphoreHandle = std::shared_ptr<Semaphore>;
 	using ShaderHandle = std::shared_ptr<Shader>;
+	using SubmitBatchHandle = std::shared_ptr<SubmitBatch>;
 	using SwapchainHandle = std::shared_ptr<Swapchain>;
+	using TimelineSemaphoreHandle = std::shared_ptr<TimelineSemaphore>;
 }
\ No newline at end of file
@@ -2,6 +2,8 @@
 
 #include "pch.hpp"
 
+#include "Alias.hpp"
+
 namespace sqrp
 {
 	struct MousePosition
@@ -115,6 +117,9 @@ namespace sqrp
 		std::string appName_;
 		unsigned int windowWidth_;
 		unsigned int windowHeight_;
+		// CPU time of each OnUpdate is measured as "Frame" if set
+		// Not owned, the profiler must be destroyed before the device which is usually a member of the derived class
+		Profiler* pProfiler_ = nullptr;
 
 		static void WindowSizeCallback(GLFWwindow* window, int width, int height);
 
@@ -138,5 +143,6 @@ namespace sqrp
 
 		void SetWindowWidth(unsigned int width);
 		void SetWindowHeight(unsigned int height);
+		void SetProfiler(Profiler* pProfiler);
 	};
 }
\ No newline at end of file
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "pch.hpp"
+
+#include "Alias.hpp"
+
+namespace sqrp
+{
+	class Buffer;
+	class Image;
+
+	// Stages and accesses which use an image in the layout
+	struct LayoutSyncInfo
+	{
+		vk::PipelineStageFlags2 stageMask = vk::PipelineStageFlagBits2::eNone;
+		vk::AccessFlags2 accessMask = vk::AccessFlagBits2::eNone;
+	};
+
+	constexpr vk::QueueFlags AllQueueFlags = vk::QueueFlagBits::eGraphics | vk::QueueFlagBits::eCompute | vk::QueueFlagBits::eTransfer;
+
+	// Removes the stages which the queue family can't execute
+	vk::PipelineStageFlags2 GetSupportedStageMask(vk::PipelineStageFlags2 stageMask, vk::QueueFlags queueFlags);
+	LayoutSyncInfo GetLayoutSyncInfo(vk::ImageLayout layout, vk::QueueFlags queueFlags = AllQueueFlags);
+
+	// NOTE : Legacy bits have the same values in the 64 bit flags of synchronization2
+	inline vk::PipelineStageFlags2 ToPipelineStageFlags2(vk::PipelineStageFlags stageMask)
+	{
+		return vk::PipelineStageFlags2(static_cast<VkPipelineStageFlags2>(static_cast<VkPipelineStageFlags>(stageMask)));
+	}
+
+	inline vk::AccessFlags2 ToAccessFlags2(vk::AccessFlags accessMask)
+	{
+		return vk::AccessFlags2(static_cast<VkAccessFlags2>(static_cast<VkAccessFlags>(accessMask)));
+	}
+
+	// Collects barriers and records them with one vkCmdPipelineBarrier2
+	// Transitions of the same image range are merged while they are pending, no command can be between them
+	// Stages are masked by the capabilities of the queue the barriers are recorded on
+	class BarrierBatcher
+	{
+	private:
+		vk::QueueFlags queueFlags_ = AllQueueFlags;
+		std::vector<vk::MemoryBarrier2> memoryBarriers_;
+		std::vector<vk::BufferMemoryBarrier2> bufferBarriers_;
+		std::vector<vk::ImageMemoryBarrier2> imageBarriers_;
+
+	public:
+		BarrierBatcher() = default;
+		BarrierBatcher(vk::QueueFlags queueFlags);
+		~BarrierBatcher() = default;
+
+		void SetQueueFlags(vk::QueueFlags queueFlags) { queueFlags_ = queueFlags; }
+
+		// Masks are derived from the layouts, the layout tracked by the image is updated
+		void Transition(ImageHandle pImage, vk::ImageLayout oldLayout, vk::ImageLayout newLayout);
+		void Transition(ImageHandle pImage, vk::ImageLayout newLayout);
+		// Previous contents are discarded, still waits for the accesses of the tracked layout
+		void Discard(ImageHandle pImage, vk::ImageLayout newLayout);
+		void AddImageBarrier(const vk::ImageMemoryBarrier2& barrier);
+		// Queue family indices are kept, so it can release or acquire the ownership
+		void AddBufferBarrier(const vk::BufferMemoryBarrier2& barrier);
+		void AddBufferBarrier(
+			BufferHandle pBuffer,
+			vk::PipelineStageFlags2 srcStageMask, vk::AccessFlags2 srcAccessMask,
+			vk::PipelineStageFlags2 dstStageMask, vk::AccessFlags2 dstAccessMask,
+			vk::DeviceSize offset = 0, vk::DeviceSize size = VK_WHOLE_SIZE
+		);
+		void AddMemoryBarrier(
+			vk::PipelineStageFlags2 srcStageMask, vk::AccessFlags2 srcAccessMask,
+			vk::PipelineStageFlags2 dstStageMask, vk::AccessFlags2 dstAccessMask
+		);
+		// Does nothing if empty
+		void Flush(vk::CommandBuffer commandBuffer);
+
+		bool IsEmpty() const;
+	};
+}
\ No newline at end of file
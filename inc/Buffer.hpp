@@ -8,6 +8,8 @@ namespace sqrp
 {
 	class Device;
 
+	enum class MemoryCategory;
+
 	class Buffer
 	{
 	private:
@@ -20,25 +22,39 @@ namespace sqrp
 		VmaAllocationInfo allocationInfo_;
 		VmaMemoryUsage memoryUsage_;
 		VmaAllocationCreateFlags allocationFlags_;
+		bool isHostCoherent_ = false;
+		MemoryCategory memoryCategory_;
 
 	public:
+		// Persistently mapped if allocationFlags has VMA_ALLOCATION_CREATE_MAPPED_BIT
 		Buffer(const Device& device, std::string name, int size, vk::BufferUsageFlags usage, VmaAllocationCreateFlags allocationFlags, VmaMemoryUsage memoryUsage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE);
 		~Buffer();
 		
+		// Returns the persistent pointer without mapping if the buffer is persistently mapped
 		void* Map();
 		void Unmap();
 		void Copy();
 		template<typename T>
 		void Write(const T& data)
 		{
-			void* rawPtr = Map();
-			*static_cast<T*>(rawPtr) = data;
-
-			Unmap();
+			Write(0, &data, sizeof(T));
 		}
 		void Write(const void* src, size_t size);
+		// Write a partial range, flushed if the memory is not host coherent
+		void Write(vk::DeviceSize offset, const void* src, size_t size);
+		// Read a partial range written by the device, invalidated if the memory is not host coherent
+		void Read(vk::DeviceSize offset, void* dst, size_t size);
+		// Required after host writes through Map / GetMappedData if the memory is not host coherent
+		void Flush(vk::DeviceSize offset = 0, vk::DeviceSize size = VK_WHOLE_SIZE);
+		// Required before host reads of device writes if the memory is not host coherent
+		void Invalidate(vk::DeviceSize offset = 0, vk::DeviceSize size = VK_WHOLE_SIZE);
 
 		vk::Buffer GetBuffer() const;
+		// Stable for the buffer lifetime, nullptr unless persistently mapped
+		void* GetMappedData() const;
+		bool IsPersistentlyMapped() const;
+		bool IsHostCoherent() const;
 		vk::DeviceSize GetSize() const;
+		MemoryCategory GetMemoryCategory() const;
 	};
 }
\ No newline at end of file
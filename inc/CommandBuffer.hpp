@@ -4,6 +4,7 @@
 
 #include "Alias.hpp"
 
+#include "Barrier.hpp"
 #include "Device.hpp"
 
 namespace sqrp
@@ -20,35 +21,81 @@ namespace sqrp
 	class Swapchain;
 	struct QueueContext;
 
+	// Attachment of dynamic rendering
+	struct RenderingAttachment
+	{
+		ImageHandle pImage = nullptr;
+		vk::AttachmentLoadOp loadOp = vk::AttachmentLoadOp::eClear;
+		vk::AttachmentStoreOp storeOp = vk::AttachmentStoreOp::eStore;
+		// NOTE : Set depthStencil to { 1.0f, 0 } for depth attachments with eLess / eLessOrEqual
+		vk::ClearValue clearValue = {};
+		// Multisampled attachments are resolved into it, average for color and sample zero for depth
+		ImageHandle pResolveImage = nullptr;
+	};
+
 	class CommandBuffer
 	{
 	private:
 		const Device* pDevice_ = nullptr;
 		QueueContextType queueType_ = QueueContextType::General;
+		vk::QueueFlags queueFlags_;
+		vk::CommandBufferLevel level_ = vk::CommandBufferLevel::ePrimary;
 		vk::UniqueCommandBuffer commandBuffer_;
+		BarrierBatcher barrierBatcher_;
+		ProfilerHandle pProfiler_;
+		// Open GPU scopes, innermost last
+		std::vector<uint32_t> profileScopes_;
+		PipelineStatisticsHandle pPipelineStatistics_;
+		// Only one pipeline statistics query can be active, nested scopes are counted by the outermost
+		uint32_t statisticsScope_ = UINT32_MAX;
+		uint32_t statisticsScopeDepth_ = 0;
 
 	public:
 		CommandBuffer(const Device& device, std::string name, QueueContextType queueType = QueueContextType::General);
+		// Allocates from the given pool, which must outlive this command buffer
+		CommandBuffer(const Device& device, std::string name, vk::CommandPool commandPool, vk::CommandBufferLevel level, QueueContextType queueType = QueueContextType::General);
 		~CommandBuffer() = default;
 
 		void Begin();
 		void Begin(vk::CommandBufferUsageFlags flag);
+		// Secondary command buffer executed inside the subpass of the render pass
+		// NOTE : Dynamic states (viewport, scissor) are not inherited, set them again
+		void BeginSecondary(RenderPassHandle pRenderPass, uint32_t subpass, FrameBufferHandle pFrameBuffer = nullptr, uint32_t inflightIndex = 0);
 		void End();
 		void BeginRender(SwapchainHandle pSwapchain);
 		void EndRender(SwapchainHandle pSwapchain);
-		void BeginRenderPass(RenderPassHandle pRenderPass, FrameBufferHandle pFrameBuffer, uint32_t inflightIndex);
+		// Use eSecondaryCommandBuffers to record the subpass with ExecuteCommands
+		void BeginRenderPass(RenderPassHandle pRenderPass, FrameBufferHandle pFrameBuffer, uint32_t inflightIndex, vk::SubpassContents contents = vk::SubpassContents::eInline);
+		void NextSubpass(vk::SubpassContents contents = vk::SubpassContents::eInline);
 		void EndRenderPass();
+		// Dynamic rendering, attachments are transitioned to the attachment layouts
+		// The render area is the extent of the first attachment
+		void BeginRendering(const std::vector<RenderingAttachment>& colorAttachments, const std::optional<RenderingAttachment>& depthAttachment = std::nullopt, vk::RenderingFlags flags = {});
+		// For attachments which are not Image (e.g. swapchain images), layouts are up to the caller
+		void BeginRendering(const vk::RenderingInfo& renderingInfo);
+		void EndRendering();
+		// Waits if the pipeline is still being built
 		void BindPipeline(PipelineHandle pPipeline, vk::PipelineBindPoint pipelineBindPoint);
+		// Returns false without binding if the pipeline is still being built
+		bool TryBindPipeline(PipelineHandle pPipeline, vk::PipelineBindPoint pipelineBindPoint);
 		void BindMeshBuffer(MeshBaseHandle pMesh);
 		void BindMeshBuffer(MeshBaseHandle pMesh, int vertexByteOffset, int indexByteOffset);
 		void BindDescriptorSet(PipelineHandle pPipeline, DescriptorSetHandle pDescriptorSet, vk::PipelineBindPoint pipelineBindPoint);
+		// dynamicOffsets are in binding order of the dynamic descriptors
+		void BindDescriptorSet(PipelineHandle pPipeline, DescriptorSetHandle pDescriptorSet, vk::PipelineBindPoint pipelineBindPoint, const std::vector<uint32_t>& dynamicOffsets);
 		void PushConstants(PipelineHandle pPipeline, vk::ShaderStageFlags stageFlags, uint32_t size, const void* pValues);
 		void CopyBuffer(BufferHandle srcBuffer, BufferHandle dstBuffer);
 		void CopyBufferRegion(BufferHandle srcBuffer, vk::DeviceSize srcOffset, BufferHandle dstBuffer, vk::DeviceSize dstOffset, vk::DeviceSize size);
-		void CopyBufferToImage(BufferHandle srcBuffer, ImageHandle dstImage);
+		void CopyBufferToImage(BufferHandle srcBuffer, ImageHandle dstImage, vk::DeviceSize srcOffset = 0);
+		// srcImage must be in eTransferSrcOptimal, rows are tightly packed in dstBuffer
+		void CopyImageToBuffer(ImageHandle srcImage, BufferHandle dstBuffer, vk::DeviceSize dstOffset = 0);
 		void SetScissor(uint32_t width, uint32_t height);
 		void SetViewport(uint32_t width, uint32_t height);
+		// Barriers are batched and recorded before the next draw, dispatch, copy, render pass or End
+		// Stage and access masks are derived from the layouts
 		void TransitionLayout(ImageHandle pImage, vk::ImageLayout oldLayout, vk::ImageLayout newLayout);
+		// Transitions from the layout tracked by the image
+		void TransitionLayout(ImageHandle pImage, vk::ImageLayout newLayout);
 		void TransitionLayout(vk::Image image, vk::ImageLayout oldLayout, vk::ImageLayout newLayout);
 		void ImageBarrier(
 			ImageHandle pImage,
@@ -59,13 +106,41 @@ namespace sqrp
 			vk::AccessFlags srcAccessMask = {},
 			vk::AccessFlags dstAccessMask = {}
 		);
+		void BufferBarrier(
+			BufferHandle pBuffer,
+			vk::PipelineStageFlags2 srcStageMask, vk::AccessFlags2 srcAccessMask,
+			vk::PipelineStageFlags2 dstStageMask, vk::AccessFlags2 dstAccessMask,
+			vk::DeviceSize offset = 0, vk::DeviceSize size = VK_WHOLE_SIZE
+		);
+		void GlobalBarrier(
+			vk::PipelineStageFlags2 srcStageMask, vk::AccessFlags2 srcAccessMask,
+			vk::PipelineStageFlags2 dstStageMask, vk::AccessFlags2 dstAccessMask
+		);
+		// Records pending barriers with one vkCmdPipelineBarrier2
+		// NOTE : Call this before recording raw commands to GetCommandBuffer()
+		void FlushBarriers();
+
+		// Render passes, dynamic rendering, dispatches and copies are measured as GPU scopes while the profiler is set
+		// RenderGraph passes are measured by both the profiler and the pipeline statistics
+		void SetProfiler(ProfilerHandle pProfiler);
+		// Scopes nest and must be closed in the same command buffer, no-op without profiler
+		void BeginProfileScope(const std::string& name);
+		void EndProfileScope();
+		void SetPipelineStatistics(PipelineStatisticsHandle pPipelineStatistics);
+		// Both ends must be inside the same render pass instance or both outside, no-op without pipeline statistics
+		// No-op on queues without graphics support, ExecuteCommands in a scope requires inheritedQueries
+		void BeginStatisticsScope(const std::string& name);
+		void EndStatisticsScope();
 
 		void DrawMesh(MeshBaseHandle pMesh, int numIndices);
 		void Draw(uint32_t vertexCount, uint32_t instanceCount);
 		void Dispatch(uint32_t groupCountX, uint32_t groupCountY, uint32_t groupCountZ);
 
 		void DrawGui(GUI& gui);
+		void ExecuteCommands(const std::vector<CommandBufferHandle>& pSecondaryCommandBuffers);
 
 		vk::CommandBuffer GetCommandBuffer() const;
+		vk::QueueFlags GetQueueFlags() const { return queueFlags_; }
+		bool IsSecondary() const;
 	};
 }
\ No newline at end of file
@@ -12,17 +12,39 @@ namespace sqrp
 
 	class Shader;
 
+	struct ShaderCompileJob
+	{
+		std::string fileName;
+		ShaderType shaderType;
+		// "NAME" or "NAME=VALUE"
+		std::vector<std::string> defines = {};
+	};
+
 	class Compiler
 	{
 	private:
 		const Device* pDevice_ = nullptr;
 
+		// SPIR-V cache is disabled if empty
+		std::filesystem::path cacheDirectory_;
+		mutable std::atomic<uint32_t> cacheHitCount_ = 0;
+		mutable std::atomic<uint32_t> cacheMissCount_ = 0;
+
 		TBuiltInResource DefaultTBuiltInResource() const;
+		uint64_t ComputeCacheKey(const std::string& glslSource, const std::string& preamble, ShaderType shaderType) const;
+		bool LoadCachedSPIRV(uint64_t key, std::vector<uint32_t>& spirv) const;
+		void StoreCachedSPIRV(uint64_t key, const std::vector<uint32_t>& spirv) const;
 
 	public:
-		Compiler();
+		Compiler(std::string cacheDirectory = "");
 		~Compiler();
 
-		std::vector<uint32_t> CompileGLSLToSPIRV(const std::string& fileName, ShaderType shaderType) const;
+		std::vector<uint32_t> CompileGLSLToSPIRV(const std::string& fileName, ShaderType shaderType, const std::vector<std::string>& defines = {}) const;
+		// Compile jobs in parallel, results are in the same order as jobs
+		// threadCount == 0 uses min(jobs, hardware threads)
+		std::vector<std::vector<uint32_t>> CompileBatch(const std::vector<ShaderCompileJob>& jobs, uint32_t threadCount = 0) const;
+
+		uint32_t GetCacheHitCount() const;
+		uint32_t GetCacheMissCount() const;
 	};
 }
\ No newline at end of file
@@ -17,6 +17,9 @@ namespace sqrp
 		vk::ShaderStageFlags shaderStageFlags;
 		//int binding = -1; // Optional: If -1, it will be set automatically based on the order in the vector
 		int mipLevel = -1;
+		// Buffer range visible to the shader, whole buffer if 0
+		// Set the element size for eUniformBufferDynamic / eStorageBufferDynamic
+		vk::DeviceSize range = 0;
 	};
 
 	class DescriptorSet
@@ -28,6 +31,7 @@ namespace sqrp
 		vk::UniqueDescriptorPool descriptorPool_;
 		vk::UniqueDescriptorSetLayout descriptorSetLayout_;
 		vk::UniqueDescriptorSet descriptorSets_;
+		uint64_t layoutHash_ = 0;
 
 	public:
 		DescriptorSet(const Device& device, std::string name, std::vector<DescriptorSetCreateInfo> descriptorSetCreateInfos);
@@ -35,5 +39,7 @@ namespace sqrp
 
 		vk::DescriptorSet GetDescriptorSet() const;
 		vk::DescriptorSetLayout GetDescriptorSetLayout() const;
+		// Sets with the same hash have identically defined (compatible) layouts
+		uint64_t GetLayoutHash() const;
 	};
 }
\ No newline at end of file
@@ -9,7 +9,9 @@
 #include "DescriptorSet.hpp"
 #include "FrameBuffer.hpp"
 #include "Mesh.hpp"
+#include "Pipeline.hpp"
 #include "RenderPass.hpp"
+#include "ThreadPool.hpp"
 
 namespace sqrp
 {
@@ -18,12 +20,17 @@ namespace sqrp
 	class CommandBuffer;
 	class DescriptorSet;
 	class Fence;
+	class FrameCommandAllocator;
 	class Image;
+	class ParallelRecorder;
 	class GraphicsPipeline;
 	class ComputePipeline;
 	class Semaphore;
 	class Shader;
+	class SubmitBatch;
 	class Swapchain;
+	class TimelineSemaphore;
+	class UploadManager;
 
 	struct Vertex;
 
@@ -32,11 +39,57 @@ namespace sqrp
 		General, Graphics, Compute, Transfer, Present
 	};
 
+	// Allocations are tracked per category for GetMemoryStats, inferred from the usage of buffers and images
+	enum class MemoryCategory
+	{
+		Mesh, Texture, Uniform, Attachment, Staging, Other, Count
+	};
+
+	const char* GetMemoryCategoryName(MemoryCategory category);
+
+	struct MemoryHeapStats
+	{
+		vk::MemoryHeapFlags flags;
+		// Bytes used by the process and bytes available before allocations start to fail or slow down
+		// Estimated by VMA if the memory budget extension is not supported
+		vk::DeviceSize usage = 0;
+		vk::DeviceSize budget = 0;
+		// Bytes of VkDeviceMemory blocks allocated by VMA and bytes of allocations in them
+		vk::DeviceSize blockBytes = 0;
+		vk::DeviceSize allocationBytes = 0;
+		uint32_t allocationCount = 0;
+	};
+
+	struct MemoryStats
+	{
+		std::vector<MemoryHeapStats> heaps;
+		// Indexed by MemoryCategory
+		std::array<vk::DeviceSize, static_cast<size_t>(MemoryCategory::Count)> categoryBytes{};
+		std::array<vk::DeviceSize, static_cast<size_t>(MemoryCategory::Count)> categoryPeakBytes{};
+		vk::DeviceSize totalBytes = 0;
+		vk::DeviceSize peakBytes = 0;
+		uint32_t allocationCount = 0;
+		bool isBudgetSupported = false;
+	};
+
+	// Semaphore to wait / signal in Submit, value is ignored for binary semaphores
+	struct SubmitSemaphore
+	{
+		vk::Semaphore semaphore;
+		uint64_t value = 0;
+		// Stages that wait, ignored for signal
+		vk::PipelineStageFlags stageMask = vk::PipelineStageFlagBits::eAllCommands;
+	};
+
 	struct QueueContext {
 		uint32_t queueFamilyIndex = -1;
 		vk::Queue queue;
 		uint32_t queueIndex = -1;
 		vk::UniqueCommandPool commandPool;
+		// Capabilities of the queue family, barrier stages are masked by them
+		vk::QueueFlags queueFlags;
+		// Shared by the contexts of the same VkQueue
+		std::shared_ptr<std::mutex> pQueueMutex;
 	};
 
 	class Device
@@ -47,21 +100,69 @@ namespace sqrp
 		std::vector<const char*> requestInstanceExtensions_ = {};
 		std::vector<const char*> requestDeviceExtensions_ = {};
 		bool isSupportRayTracing_ = false;
+		bool isHeadless_ = false;
+		bool isSupportMemoryBudget_ = false;
 		vk::PhysicalDevice physicalDevice_;
+		vk::PhysicalDeviceFeatures enabledFeatures_;
+		vk::PhysicalDeviceVulkan12Features enabledVulkan12Features_;
+		vk::PhysicalDeviceVulkan13Features enabledVulkan13Features_;
 		vk::UniqueDevice device_;
 		vk::UniqueDebugUtilsMessengerEXT debugMessenger_;
 		vk::UniqueSurfaceKHR surface_;
 		std::map<QueueContextType, QueueContext> queueContexts_;
 		VmaAllocator allocator_;
+		// Pipeline cache is kept in memory only if the path is empty
+		std::filesystem::path pipelineCachePath_;
+		vk::UniquePipelineCache pipelineCache_;
+		bool isPipelineCacheWarm_ = false;
+		// Pipelines are deduplicated by the hash of their create state and shared while they are referenced
+		// The name is not part of the state, a hit keeps the name of the first pipeline
+		template<typename T>
+		struct PipelineRegistryEntry
+		{
+			// Compared on a hit, a different key with the same hash is not shared
+			PipelineKey key;
+			std::weak_ptr<T> wpPipeline;
+		};
+		mutable std::mutex pipelineRegistryMutex_;
+		mutable std::unordered_map<uint64_t, PipelineRegistryEntry<GraphicsPipeline>> graphicsPipelineRegistry_;
+		mutable std::unordered_map<uint64_t, PipelineRegistryEntry<ComputePipeline>> computePipelineRegistry_;
+		// Worker threads for asynchronous pipeline builds
+		std::unique_ptr<ThreadPool> pipelineThreadPool_;
+		// Batched staging uploads on the transfer queue, acquired by Submit on the rendering queue
+		std::unique_ptr<UploadManager> uploadManager_;
+		// CPU time of Submit is measured if set
+		ProfilerHandle pProfiler_;
+		// Bytes of live allocations per MemoryCategory, updated by TrackAllocation / UntrackAllocation
+		mutable std::mutex memoryStatsMutex_;
+		mutable std::array<vk::DeviceSize, static_cast<size_t>(MemoryCategory::Count)> categoryBytes_{};
+		mutable std::array<vk::DeviceSize, static_cast<size_t>(MemoryCategory::Count)> categoryPeakBytes_{};
+		mutable vk::DeviceSize totalBytes_ = 0;
+		mutable vk::DeviceSize peakBytes_ = 0;
+		mutable uint32_t allocationCount_ = 0;
 
 		bool isDeviceExtensionSupport(vk::PhysicalDevice physDev);
 		bool isDeviceSuitable(vk::PhysicalDevice physDev);
 		bool isDeviceRayTracingSupport(vk::PhysicalDevice physDev);
+		// pWindow == nullptr initializes without surface and swapchain
+		bool InitInternal(const std::string& appName, GLFWwindow* pWindow);
+		std::vector<uint8_t> LoadPipelineCacheData() const;
+		template<typename T>
+		std::shared_ptr<T> FindPipeline(const std::unordered_map<uint64_t, PipelineRegistryEntry<T>>& registry, const PipelineKey& stateKey) const;
+		template<typename T>
+		// Expired entries are erased here
+		std::shared_ptr<T> RegisterPipeline(std::unordered_map<uint64_t, PipelineRegistryEntry<T>>& registry, const PipelineKey& stateKey, std::shared_ptr<T> pPipeline) const;
+		void BuildPipelineAsync(PipelineHandle pPipeline) const;
 
 	public:
 		Device();
 		~Device();
+		// Call before Init to load / save VkPipelineCache from the file
+		void SetPipelineCachePath(const std::string& path);
 		bool Init(Application application);
+		// No window, surface and swapchain, render into offscreen images and read them back with ReadbackImage
+		// Devices without present support (e.g. lavapipe) can be selected
+		bool InitHeadless(std::string appName = "Headless");
 		BufferHandle CreateBuffer(
 			std::string name,
 			int size,
@@ -74,6 +175,10 @@ namespace sqrp
 		FenceHandle CreateFence(std::string name, bool signal = true) const;
 		FrameBufferHandle CreateFrameBuffer(std::string name, RenderPassHandle pRenderPass, SwapchainHandle pSwapchain, std::vector<ImageHandle> depthImages = {}) const;
 		FrameBufferHandle CreateFrameBuffer(std::string name, RenderPassHandle pRenderPass, std::vector<std::vector<ImageHandle>> attachmentImages, uint32_t width, uint32_t height, int inflightCount, SwapchainHandle pSwapchain = nullptr) const;
+		// slotCount is the number of captures in flight
+		FrameCaptureHandle CreateFrameCapture(std::string name, uint32_t slotCount = 3) const;
+		// One pool per inflight frame reset by BeginFrame
+		FrameCommandAllocatorHandle CreateFrameCommandAllocator(std::string name, uint32_t inflightCount, QueueContextType queueType = QueueContextType::General) const;
 		GUIHandle CreateGUI(GLFWwindow* window, SwapchainHandle pSwapchain, RenderPassHandle pRenderPass) const;
 		ImageHandle CreateImage(
 			std::string name = "Image",
@@ -108,16 +213,79 @@ namespace sqrp
 			bool enableDepthWrite = true,
 			bool needVertexBuffer = true
 		) const;
+		// Pipelines with different desc are cached as separate variants
+		// NOTE : Creating the same state again returns the existing pipeline, name is ignored and its debug name stays unchanged
+		GraphicsPipelineHandle CreateGraphicsPipeline(
+			std::string name,
+			RenderPassHandle pRenderPass,
+			ShaderHandle pVertexShader,
+			ShaderHandle pPixelShader,
+			DescriptorSetHandle pDescriptorSet,
+			const GraphicsPipelineDesc& desc,
+			vk::PushConstantRange pushConstantRange = vk::PushConstantRange{}
+		) const;
+		// For dynamic rendering, independent of render passes
+		GraphicsPipelineHandle CreateGraphicsPipeline(
+			std::string name,
+			const RenderingFormats& renderingFormats,
+			ShaderHandle pVertexShader,
+			ShaderHandle pPixelShader,
+			DescriptorSetHandle pDescriptorSet,
+			const GraphicsPipelineDesc& desc = GraphicsPipelineDesc{},
+			vk::PushConstantRange pushConstantRange = vk::PushConstantRange{}
+		) const;
 		ComputePipelineHandle CreateComputePipeline(
 			std::string name,
 			ShaderHandle pComputeShader,
 			DescriptorSetHandle pDescriptorSet,
 			vk::PushConstantRange pushConstantRange = vk::PushConstantRange{}
 		) const;
+		// Returns immediately and builds the pipeline on a worker thread
+		// Check IsReady() before binding to skip the draw, otherwise binding waits for the build
+		// Deduplicated with the synchronous variants, a hit may return a pipeline which is already built
+		GraphicsPipelineHandle CreateGraphicsPipelineAsync(
+			std::string name,
+			RenderPassHandle pRenderPass,
+			ShaderHandle pVertexShader,
+			ShaderHandle pPixelShader,
+			DescriptorSetHandle pDescriptorSet,
+			const GraphicsPipelineDesc& desc = GraphicsPipelineDesc{},
+			vk::PushConstantRange pushConstantRange = vk::PushConstantRange{}
+		) const;
+		GraphicsPipelineHandle CreateGraphicsPipelineAsync(
+			std::string name,
+			const RenderingFormats& renderingFormats,
+			ShaderHandle pVertexShader,
+			ShaderHandle pPixelShader,
+			DescriptorSetHandle pDescriptorSet,
+			const GraphicsPipelineDesc& desc = GraphicsPipelineDesc{},
+			vk::PushConstantRange pushConstantRange = vk::PushConstantRange{}
+		) const;
+		ComputePipelineHandle CreateComputePipelineAsync(
+			std::string name,
+			ShaderHandle pComputeShader,
+			DescriptorSetHandle pDescriptorSet,
+			vk::PushConstantRange pushConstantRange = vk::PushConstantRange{}
+		) const;
+		// threadCount == 0 uses the number of hardware threads
+		ParallelRecorderHandle CreateParallelRecorder(std::string name, uint32_t inflightCount, uint32_t threadCount = 0, QueueContextType queueType = QueueContextType::General) const;
+		// maxScopeCount is the number of scopes per inflight frame
+		PipelineStatisticsHandle CreatePipelineStatistics(std::string name, uint32_t inflightCount, uint32_t maxScopeCount = 64) const;
+		// maxScopeCount is the number of GPU scopes per inflight frame
+		ProfilerHandle CreateProfiler(std::string name, uint32_t inflightCount, uint32_t maxScopeCount = 256) const;
+		RenderGraphHandle CreateRenderGraph(std::string name) const;
 		RenderPassHandle CreateRenderPass(std::string name, SwapchainHandle pSwapchain, bool depth = true) const;
-		RenderPassHandle CreateRenderPass(std::string name, std::vector<SubPassInfo> subPassInfos, std::map<std::string, AttachmentInfo> attachmentNameToInfo) const;
+		RenderPassHandle CreateRenderPass(std::string name, std::vector<SubPassInfo> subPassInfos, std::map<std::string, AttachmentInfo> attachmentNameToInfo, std::vector<std::string> attachmentOrder = {}) const;
+		// frameSize is the capacity per inflight frame
+		RingBufferHandle CreateRingBuffer(std::string name, vk::DeviceSize frameSize, uint32_t inflightCount, vk::BufferUsageFlags usage = vk::BufferUsageFlagBits::eUniformBuffer) const;
 		SemaphoreHandle CreateSemaphore(std::string name = "Semaphore") const;
+		// Accumulates submits to one queue and flushes them with one vkQueueSubmit2
+		SubmitBatchHandle CreateSubmitBatch(QueueContextType type = QueueContextType::General) const;
+		TimelineSemaphoreHandle CreateTimelineSemaphore(std::string name = "TimelineSemaphore", uint64_t initialValue = 0) const;
 		ShaderHandle CreateShader(const Compiler& compiler, const std::string& fileName, ShaderType shaderType) const;
+		ShaderHandle CreateShader(const std::vector<uint32_t>& spirv, ShaderType shaderType) const;
+		// Compile all jobs in parallel with Compiler::CompileBatch, results are in the same order as jobs
+		std::vector<ShaderHandle> CreateShaders(const Compiler& compiler, const std::vector<ShaderCompileJob>& jobs) const;
 		SwapchainHandle CreateSwapchain(uint32_t width, uint32_t height) const;
 
 		void Submit(
@@ -136,9 +304,31 @@ namespace sqrp
 			vk::Semaphore signalSemaphore = nullptr,
 			FenceHandle pFence = nullptr
 		) const;
+		// Waits / signals timeline semaphores at exact values, binary semaphores can be mixed in
+		void Submit(
+			QueueContextType type,
+			const std::vector<CommandBufferHandle>& pCommandBuffers,
+			const std::vector<SubmitSemaphore>& waitSemaphores,
+			const std::vector<SubmitSemaphore>& signalSemaphores,
+			FenceHandle pFence = nullptr
+		) const;
 		void WaitIdle(QueueContextType type) const;
+		// Submits and waits for the queue to be idle, prefer GetUploadManager() for uploads
 		void OneTimeSubmit(std::function<void(CommandBufferHandle pCommandBuffer)>&& command) const;
+		// Copies mip 0 / layer 0 into host memory with tightly packed rows, waits for the queue to be idle
+		// The image is left in eTransferSrcOptimal
+		std::vector<uint8_t> ReadbackImage(ImageHandle pImage) const;
+		// Submit and Swapchain::WaitFrame are measured as CPU scopes of the profiler, nullptr disables it
+		void SetProfiler(ProfilerHandle pProfiler);
 		void SetObjectName(uint64_t object, vk::ObjectType objectType, const std::string& name) const;
+		bool SavePipelineCache() const;
+		// Called by the owners of VMA allocations, sizes are the allocation sizes
+		void TrackAllocation(MemoryCategory category, vk::DeviceSize size) const;
+		void UntrackAllocation(MemoryCategory category, vk::DeviceSize size) const;
+		// Budgets are refreshed by VMA on Swapchain::WaitFrame
+		MemoryStats GetMemoryStats() const;
+		// JSON built by vmaBuildStatsString, detailed adds every allocation with its name
+		std::string GetMemoryStatsJson(bool detailed = false) const;
 
 		VmaAllocator GetAllocator() const;
 		vk::PhysicalDevice GetPhysicalDevice() const;
@@ -147,5 +337,18 @@ namespace sqrp
 		vk::SurfaceKHR GetSurface() const;
 		const std::map<QueueContextType, QueueContext>& GetQueueContexts() const;
 		vk::Queue GetQueue(QueueContextType type) const;
+		// NOTE : vkQueueSubmit, vkQueuePresentKHR and vkQueueWaitIdle require external synchronization of the queue
+		//        Hold this lock while calling them on GetQueue(), submits of Device already take it
+		std::unique_lock<std::mutex> LockQueue(QueueContextType type) const;
+		const vk::PhysicalDeviceFeatures& GetEnabledFeatures() const;
+		const vk::PhysicalDeviceVulkan12Features& GetEnabledVulkan12Features() const;
+		const vk::PhysicalDeviceVulkan13Features& GetEnabledVulkan13Features() const;
+		ProfilerHandle GetProfiler() const;
+		UploadManager& GetUploadManager() const;
+		vk::PipelineCache GetPipelineCache() const;
+		// True if the pipeline cache was initialized with valid data from the file
+		bool IsPipelineCacheWarm() const;
+		bool IsHeadless() const;
+		bool IsMemoryBudgetSupported() const;
 	};
 }
\ No newline at end of file
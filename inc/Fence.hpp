@@ -19,6 +19,8 @@ namespace sqrp
 		Fence(const Device& device, std::string name, bool signal = true);
 		~Fence() = default;
 		void Finished();
+		// Returns without waiting
+		bool IsSignaled() const;
 		void Reset();
 		void Wait();
 
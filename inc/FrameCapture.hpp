@@ -0,0 +1,71 @@
+#pragma once
+
+#include "pch.hpp"
+
+#include "Alias.hpp"
+
+namespace sqrp
+{
+	class Device;
+
+	struct CaptureResult
+	{
+		// Returned by Capture, increasing in capture order
+		uint64_t captureId = 0;
+		uint32_t width = 0;
+		uint32_t height = 0;
+		vk::Format format = vk::Format::eUndefined;
+		// Tightly packed rows of mip 0 / layer 0
+		std::vector<uint8_t> pixels;
+	};
+
+	// 8bit RGBA / BGRA formats only, BGRA is swizzled to RGBA
+	// Returns false if the format is not supported or the file can't be written
+	bool WriteCapturePNG(const CaptureResult& result, const std::string& path);
+
+	// Copies images into host visible readback buffers without idling the queue
+	// A capture is complete when the timeline semaphore reaches the value signaled by the submit of the command buffer
+	class FrameCapture
+	{
+	private:
+		struct Slot
+		{
+			BufferHandle pBuffer;
+			TimelineSemaphoreHandle pTimeline;
+			uint64_t completeValue = 0;
+			uint64_t captureId = 0;
+			uint32_t width = 0;
+			uint32_t height = 0;
+			vk::Format format = vk::Format::eUndefined;
+			bool isPending = false;
+		};
+
+		const Device* pDevice_ = nullptr;
+		std::string name_;
+		std::vector<Slot> slots_;
+		uint64_t lastCaptureId_ = 0;
+
+		// Returns nullptr if all slots are pending
+		Slot* AcquireSlot(vk::DeviceSize size);
+		CaptureResult ReadSlot(Slot& slot);
+
+	public:
+		// slotCount is the number of captures in flight, usually the inflight count
+		FrameCapture(const Device& device, std::string name, uint32_t slotCount = 3);
+		~FrameCapture() = default;
+
+		// Records the copy of pImage into pCommandBuffer, the image is left in eTransferSrcOptimal
+		// pTimeline must be signaled to completeValue by the submit of pCommandBuffer
+		// Returns 0 without recording if all slots are pending, the frame is dropped
+		uint64_t Capture(CommandBufferHandle pCommandBuffer, ImageHandle pImage, TimelineSemaphoreHandle pTimeline, uint64_t completeValue);
+		// Current swapchain image, record after the rendering of the frame (in ePresentSrcKHR) and before End
+		// Tracked by the frame timeline of the swapchain
+		uint64_t Capture(CommandBufferHandle pCommandBuffer, SwapchainHandle pSwapchain);
+		// Returns completed captures in capture order without waiting
+		std::vector<CaptureResult> Poll();
+		// Waits for all pending captures
+		std::vector<CaptureResult> WaitAll();
+
+		uint32_t GetPendingCount() const;
+	};
+}
\ No newline at end of file
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "pch.hpp"
+
+#include "Alias.hpp"
+
+#include "Device.hpp"
+
+namespace sqrp
+{
+	class CommandBuffer;
+
+	// Hands out transient command buffers from one pool per inflight frame
+	// BeginFrame resets the whole pool with vkResetCommandPool instead of resetting each command buffer
+	// NOTE : Not thread safe, use one allocator per recording thread
+	class FrameCommandAllocator
+	{
+	private:
+		struct Frame
+		{
+			vk::UniqueCommandPool commandPool;
+			// Destroyed before the pool, reused after the pool is reset
+			std::vector<CommandBufferHandle> pPrimaryCommandBuffers;
+			std::vector<CommandBufferHandle> pSecondaryCommandBuffers;
+			uint32_t usedPrimaryCount = 0;
+			uint32_t usedSecondaryCount = 0;
+		};
+
+		const Device* pDevice_ = nullptr;
+		std::string name_;
+		QueueContextType queueType_ = QueueContextType::General;
+		std::vector<Frame> frames_;
+		uint32_t inflightIndex_ = 0;
+
+	public:
+		FrameCommandAllocator(const Device& device, std::string name, uint32_t inflightCount, QueueContextType queueType = QueueContextType::General);
+		~FrameCommandAllocator() = default;
+
+		// Resets the pool of the inflight frame, the GPU must have finished the frame
+		void BeginFrame(uint32_t inflightIndex);
+		// Valid until BeginFrame of the same inflight index, Begin it before recording
+		CommandBufferHandle Allocate(vk::CommandBufferLevel level = vk::CommandBufferLevel::ePrimary);
+
+		uint32_t GetInflightCount() const;
+		uint32_t GetCurrentInflightIndex() const;
+		// Number of command buffers allocated in the current frame
+		uint32_t GetAllocatedCount() const;
+		QueueContextType GetQueueType() const;
+	};
+}
\ No newline at end of file
@@ -7,6 +7,7 @@
 namespace sqrp
 {
 	class Device;
+	struct MemoryStats;
 	class RenderPass;
 	class Swapchain;
 
@@ -23,6 +24,10 @@ namespace sqrp
 		GUI(const Device& device, GLFWwindow* window, SwapchainHandle pSwapchain, RenderPassHandle pRenderPass);
 		~GUI();
 		void NewFrame();
+		// Window with the rolling stats of each scope, call between NewFrame and DrawGui
+		void DrawProfiler(const Profiler& profiler);
+		// Window with the usage / budget of each heap and the bytes of each category
+		void DrawMemoryStats(const MemoryStats& stats);
 		vk::DescriptorPool GetImguiDescPool() const;
 	};
 }
\ No newline at end of file
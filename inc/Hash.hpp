@@ -0,0 +1,33 @@
+#pragma once
+
+#include "pch.hpp"
+
+namespace sqrp
+{
+	// FNV-1a (64bit), used as the key of content addressed caches
+	constexpr uint64_t HashSeed = 14695981039346656037ull;
+
+	inline uint64_t HashBytes(const void* data, size_t size, uint64_t hash = HashSeed)
+	{
+		const uint8_t* bytes = static_cast<const uint8_t*>(data);
+		for (size_t i = 0; i < size; i++) {
+			hash ^= bytes[i];
+			hash *= 1099511628211ull;
+		}
+		return hash;
+	}
+
+	// NOTE : Only for types without padding, padding bytes are not guaranteed to be zero
+	template<typename T>
+	inline uint64_t HashValue(const T& value, uint64_t hash = HashSeed)
+	{
+		static_assert(std::is_trivially_copyable_v<T>, "HashValue requires trivially copyable type");
+		return HashBytes(&value, sizeof(T), hash);
+	}
+
+	inline uint64_t HashString(const std::string& str, uint64_t hash = HashSeed)
+	{
+		hash = HashValue(static_cast<uint64_t>(str.size()), hash);
+		return HashBytes(str.data(), str.size(), hash);
+	}
+}
\ No newline at end of file
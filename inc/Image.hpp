@@ -8,6 +8,21 @@ namespace sqrp
 {
 	class Device;
 
+	enum class MemoryCategory;
+
+	enum class ImageMemoryType
+	{
+		// Own VMA allocation
+		Dedicated,
+		// For transient attachments, falls on tile memory on tiled GPUs
+		LazilyAllocated,
+		// Created without memory, bound to a shared allocation with BindMemory
+		Aliased
+	};
+
+	// Bytes per texel of formats that can be read back, throws for others
+	uint32_t GetFormatTexelSize(vk::Format format);
+
 	class Image
 	{
 	private:
@@ -22,8 +37,12 @@ namespace sqrp
 
 		vk::ImageAspectFlags aspectFlags_;
 		vk::ImageLayout imageLayout_;
-		VmaAllocation allocation_;
+		ImageMemoryType memoryType_ = ImageMemoryType::Dedicated;
+		bool isMemoryBound_ = false;
+		VmaAllocation allocation_ = nullptr;
 		VmaAllocationInfo allocationInfo_;
+		// Attachment or Texture, aliased memory is tracked by the owner of the allocation
+		MemoryCategory memoryCategory_;
 		vk::Image image_;
 
 		vk::ImageViewCreateInfo imageViewCreateInfo_;
@@ -33,6 +52,10 @@ namespace sqrp
 		vk::SamplerCreateInfo samplerCreateInfo_;
 		vk::Sampler sampler_;
 
+		void CreateImage();
+		void CreateViews();
+		void TrackAllocation();
+
 	public:
 		Image(
 			const Device& device,
@@ -54,12 +77,16 @@ namespace sqrp
 			std::string name = "Image",
 			vk::ImageCreateInfo imageCreateInfo = {},
 			vk::ImageAspectFlags aspectFlags = vk::ImageAspectFlagBits::eColor,
-			vk::SamplerCreateInfo samplerCreateInfo = {}
+			vk::SamplerCreateInfo samplerCreateInfo = {},
+			ImageMemoryType memoryType = ImageMemoryType::Dedicated
 		);
 		~Image();
 
 		void Destroy();
+		// Aliased images are unbound again after Recreate
 		void Recreate(uint32_t width, uint32_t height);
+		// Only for aliased images, creates the views
+		void BindMemory(VmaAllocation allocation, vk::DeviceSize offset);
 
 		vk::Image GetImage() const;
 		vk::ImageView GetImageView() const;
@@ -74,6 +101,10 @@ namespace sqrp
 		vk::ImageUsageFlags GetUsage() const;
 		vk::ImageView GetMipImageView(uint32_t mipLevel) const;
 		std::string GetName() const;
+		vk::MemoryRequirements GetMemoryRequirements() const;
+		ImageMemoryType GetMemoryType() const;
+		MemoryCategory GetMemoryCategory() const;
+		bool IsMemoryBound() const;
 
 		void SetImageLayout(vk::ImageLayout imageLayout);
 
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "pch.hpp"
+
+#include "Alias.hpp"
+
+#include "Device.hpp"
+#include "FrameCommandAllocator.hpp"
+#include "ThreadPool.hpp"
+
+namespace sqrp
+{
+	class CommandBuffer;
+	class FrameBuffer;
+	class RenderPass;
+
+	// Records draw ranges of a subpass into secondary command buffers on worker threads
+	// Each thread slot has its own FrameCommandAllocator, so no pool is shared between threads
+	// Usage : BeginFrame after the frame is waited, BeginRenderPass with eSecondaryCommandBuffers, Record, ExecuteCommands
+	class ParallelRecorder
+	{
+	public:
+		// Records draws [begin, end), called concurrently with different ranges
+		using RecordFunction = std::function<void(CommandBufferHandle pCommandBuffer, uint32_t begin, uint32_t end)>;
+
+	private:
+		const Device* pDevice_ = nullptr;
+		std::string name_;
+		QueueContextType queueType_ = QueueContextType::General;
+		uint32_t threadCount_ = 1;
+		uint32_t inflightIndex_ = 0;
+		// One per thread slot
+		std::vector<FrameCommandAllocatorHandle> pCommandAllocators_;
+		// The calling thread records the first range, so threadCount_ - 1 workers
+		std::unique_ptr<ThreadPool> threadPool_;
+
+	public:
+		// threadCount == 0 uses the number of hardware threads
+		ParallelRecorder(const Device& device, std::string name, uint32_t inflightCount, uint32_t threadCount = 0, QueueContextType queueType = QueueContextType::General);
+		~ParallelRecorder();
+
+		// Resets the pools of the inflight frame, the GPU must have finished the frame
+		void BeginFrame(uint32_t inflightIndex);
+		// Splits [0, drawCount) into contiguous ranges of at least minDrawsPerThread and records them in parallel
+		// Returned command buffers are in range order and valid until BeginFrame of the same inflight index
+		std::vector<CommandBufferHandle> Record(
+			RenderPassHandle pRenderPass,
+			uint32_t subpass,
+			FrameBufferHandle pFrameBuffer,
+			uint32_t drawCount,
+			const RecordFunction& recordFunction,
+			uint32_t minDrawsPerThread = 1
+		);
+
+		uint32_t GetThreadCount() const;
+	};
+}
\ No newline at end of file
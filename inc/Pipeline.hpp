@@ -12,53 +12,196 @@ namespace sqrp
 	class Shader;
 	class Swapchain;
 
+	// Fixed function state of a graphics pipeline, viewport and scissor are always dynamic
+	struct GraphicsPipelineDesc
+	{
+		vk::PrimitiveTopology topology = vk::PrimitiveTopology::eTriangleList;
+		// eLine / ePoint require fillModeNonSolid, falls back to eFill if not supported
+		vk::PolygonMode polygonMode = vk::PolygonMode::eFill;
+		vk::CullModeFlags cullMode = vk::CullModeFlagBits::eBack;
+		vk::FrontFace frontFace = vk::FrontFace::eCounterClockwise;
+		// Values other than 1.0 require wideLines
+		float lineWidth = 1.0f;
+		bool enableDepthTest = true;
+		bool enableDepthWrite = true;
+		vk::CompareOp depthCompareOp = vk::CompareOp::eLessOrEqual;
+		// Must match the samples of the subpass attachments
+		vk::SampleCountFlagBits sampleCount = vk::SampleCountFlagBits::e1;
+		// One per color attachment of the subpass
+		// If empty, opaque state is used for all color attachments (color writes are masked if enableColorWrite is false)
+		std::vector<vk::PipelineColorBlendAttachmentState> colorBlendAttachments = {};
+		bool enableColorWrite = true;
+		// Added to viewport and scissor
+		std::vector<vk::DynamicState> dynamicStates = {};
+		bool needVertexBuffer = true;
+		uint32_t subpass = 0;
+
+		uint64_t Hash() const;
+
+		// Depth prepass, the pixel shader can be nullptr
+		static GraphicsPipelineDesc DepthOnly();
+		// Shading after a depth prepass, only the visible fragment passes the depth test
+		// NOTE : Vertex shaders of both passes must output the same position (use invariant gl_Position)
+		static GraphicsPipelineDesc DepthEqual(uint32_t subpass = 1);
+		// Triangle edges of the mesh for debug views
+		static GraphicsPipelineDesc Wireframe();
+		// Line list vertices for debug views
+		static GraphicsPipelineDesc Lines();
+
+		static vk::PipelineColorBlendAttachmentState OpaqueBlend();
+		static vk::PipelineColorBlendAttachmentState AlphaBlend();
+		static vk::PipelineColorBlendAttachmentState AdditiveBlend();
+	};
+
+	// Attachment formats of dynamic rendering, used instead of a render pass
+	// Pipelines with the same formats can be used in any BeginRendering with those formats
+	struct RenderingFormats
+	{
+		std::vector<vk::Format> colorFormats = {};
+		vk::Format depthFormat = vk::Format::eUndefined;
+		vk::Format stencilFormat = vk::Format::eUndefined;
+
+		uint64_t Hash() const;
+	};
+
+	// Create state of a pipeline, compared on a hit of the Device registry since the hash alone may collide
+	struct PipelineKey
+	{
+		vk::PipelineBindPoint bindPoint = vk::PipelineBindPoint::eGraphics;
+		// Vertex or compute shader
+		uint64_t shaderHash = 0;
+		// 0 for depth only and compute pipelines
+		uint64_t pixelShaderHash = 0;
+		// Render pass compatibility or rendering formats, 0 for compute pipelines
+		uint64_t targetHash = 0;
+		uint64_t layoutHash = 0;
+		uint64_t descHash = 0;
+		vk::PushConstantRange pushConstantRange = {};
+
+		uint64_t Hash() const;
+		bool operator==(const PipelineKey& other) const = default;
+	};
+
 	class Pipeline
 	{
+		// Device launches asynchronous builds
+		friend class Device;
+
 	protected:
 		const Device* pDevice_ = nullptr;
 
 		vk::UniquePipeline pipeline_;
 		vk::UniquePipelineLayout pipelineLayout_;
+		uint64_t stateHash_ = 0;
+		// Valid only if the pipeline is built on a worker thread
+		std::shared_future<void> buildFuture_;
 
+		// Create vk::Pipeline, pipeline layout is created in the constructor
+		virtual void Build() = 0;
 
 	public:
 		Pipeline(
 			const Device& device
 		);
-		~Pipeline() = default;
+		virtual ~Pipeline() = default;
 
+		// Waits for the build if it is not finished
 		vk::Pipeline GetPipeline() const;
+		// Available immediately even if the build is pending
 		vk::PipelineLayout GetPipelineLayout() const;
+		uint64_t GetStateHash() const;
+		// True if the build has finished (or failed, Wait rethrows the error)
+		bool IsReady() const;
+		void Wait() const;
 	};
 
 	class GraphicsPipeline : public Pipeline
 	{
+	private:
+		std::string name_;
+		// nullptr for dynamic rendering
+		RenderPassHandle pRenderPass_ = nullptr;
+		RenderingFormats renderingFormats_;
+		ShaderHandle pVertexShader_ = nullptr;
+		ShaderHandle pPixelShader_ = nullptr;
+		GraphicsPipelineDesc desc_;
+
+		void CreatePipelineLayout(DescriptorSetHandle pDescriptorSet, vk::PushConstantRange pushConstantRange);
+
+	protected:
+		void Build() override;
+
 	public:
 		GraphicsPipeline(
 			const Device& device,
 			std::string name,
 			RenderPassHandle pRenderPass,
-			SwapchainHandle pSwapchain,
 			ShaderHandle pVertexShader,
+			// nullptr for depth only pipelines
 			ShaderHandle pPixelShader,
 			DescriptorSetHandle pDescriptorSet,
+			const GraphicsPipelineDesc& desc = GraphicsPipelineDesc{},
 			vk::PushConstantRange pushConstantRange = vk::PushConstantRange{},
-			bool enableDepthWrite = true,
-			bool needVertexBuffer = true
+			// Build is left to the caller (Device::CreateGraphicsPipelineAsync)
+			bool deferBuild = false
+		);
+		// For dynamic rendering, desc.subpass is ignored
+		GraphicsPipeline(
+			const Device& device,
+			std::string name,
+			const RenderingFormats& renderingFormats,
+			ShaderHandle pVertexShader,
+			ShaderHandle pPixelShader,
+			DescriptorSetHandle pDescriptorSet,
+			const GraphicsPipelineDesc& desc = GraphicsPipelineDesc{},
+			vk::PushConstantRange pushConstantRange = vk::PushConstantRange{},
+			bool deferBuild = false
 		);
 		~GraphicsPipeline() = default;
+
+		// Complete create state, pipelines with the same key are interchangeable
+		static PipelineKey ComputeStateKey(
+			RenderPassHandle pRenderPass,
+			ShaderHandle pVertexShader,
+			ShaderHandle pPixelShader,
+			DescriptorSetHandle pDescriptorSet,
+			const GraphicsPipelineDesc& desc,
+			vk::PushConstantRange pushConstantRange
+		);
+		static PipelineKey ComputeStateKey(
+			const RenderingFormats& renderingFormats,
+			ShaderHandle pVertexShader,
+			ShaderHandle pPixelShader,
+			DescriptorSetHandle pDescriptorSet,
+			const GraphicsPipelineDesc& desc,
+			vk::PushConstantRange pushConstantRange
+		);
 	};
 
 	class ComputePipeline : public Pipeline
 	{
+	private:
+		std::string name_;
+		ShaderHandle pComputeShader_ = nullptr;
+
+	protected:
+		void Build() override;
+
 	public:
 		ComputePipeline(
 			const Device& device,
 			std::string name,
 			ShaderHandle pComputeShader,
 			DescriptorSetHandle pDescriptorSet,
-			vk::PushConstantRange pushConstantRange = vk::PushConstantRange{}
+			vk::PushConstantRange pushConstantRange = vk::PushConstantRange{},
+			bool deferBuild = false
 		);
 		~ComputePipeline() = default;
+
+		static PipelineKey ComputeStateKey(
+			ShaderHandle pComputeShader,
+			DescriptorSetHandle pDescriptorSet,
+			vk::PushConstantRange pushConstantRange
+		);
 	};
 }
\ No newline at end of file
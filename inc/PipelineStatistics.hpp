@@ -0,0 +1,86 @@
+#pragma once
+
+#include "pch.hpp"
+
+#include "Alias.hpp"
+
+namespace sqrp
+{
+	class Device;
+
+	enum class QueueContextType;
+
+	// Counters of one scope name summed over the last resolved frame
+	struct PipelineStatisticsResult
+	{
+		std::string name;
+		uint64_t inputAssemblyVertices = 0;
+		uint64_t inputAssemblyPrimitives = 0;
+		uint64_t vertexShaderInvocations = 0;
+		uint64_t clippingInvocations = 0;
+		uint64_t clippingPrimitives = 0;
+		uint64_t fragmentShaderInvocations = 0;
+		uint64_t computeShaderInvocations = 0;
+	};
+
+	// Pipeline statistics queries resolved when the inflight index is reused, so nothing stalls
+	// NOTE : Counters are implementation dependent (e.g. fragment invocations with early depth test), compare them on the same device
+	class PipelineStatistics
+	{
+	private:
+		struct Scope
+		{
+			std::string name;
+			uint32_t query = 0;
+			bool isEnded = false;
+		};
+
+		struct FrameQueries
+		{
+			vk::UniqueQueryPool queryPool;
+			std::vector<Scope> scopes;
+		};
+
+		const Device* pDevice_ = nullptr;
+		std::string name_;
+		uint32_t maxScopeCount_ = 0;
+		bool isEnabled_ = false;
+		bool isOverflowWarned_ = false;
+		// Graphics counters can only be queried on queues with graphics support
+		std::set<QueueContextType> graphicsQueues_;
+
+		mutable std::mutex mutex_;
+		std::vector<FrameQueries> frames_;
+		uint32_t inflightIndex_ = 0;
+		// In the order of the first scope, which keeps the output stable
+		std::vector<PipelineStatisticsResult> results_;
+
+	public:
+		// Counters in the order of the results of a query
+		static constexpr vk::QueryPipelineStatisticFlags QueryFlags =
+			vk::QueryPipelineStatisticFlagBits::eInputAssemblyVertices |
+			vk::QueryPipelineStatisticFlagBits::eInputAssemblyPrimitives |
+			vk::QueryPipelineStatisticFlagBits::eVertexShaderInvocations |
+			vk::QueryPipelineStatisticFlagBits::eClippingInvocations |
+			vk::QueryPipelineStatisticFlagBits::eClippingPrimitives |
+			vk::QueryPipelineStatisticFlagBits::eFragmentShaderInvocations |
+			vk::QueryPipelineStatisticFlagBits::eComputeShaderInvocations;
+		static constexpr uint32_t CounterCount = 7;
+		static constexpr uint32_t InvalidScope = UINT32_MAX;
+
+		// maxScopeCount is per inflight frame, requires pipelineStatisticsQuery and hostQueryReset
+		PipelineStatistics(const Device& device, std::string name, uint32_t inflightCount, uint32_t maxScopeCount = 64);
+		~PipelineStatistics() = default;
+
+		// Resolves the scopes of the frame which used this inflight index and resets its queries
+		// Call after the frame is waited, e.g. after Swapchain::WaitFrame
+		void BeginFrame(uint32_t inflightIndex);
+		// Begins the query, returns InvalidScope if the scope is not recorded or the queue has no graphics support
+		uint32_t BeginScope(vk::CommandBuffer commandBuffer, QueueContextType queueType, const std::string& name);
+		void EndScope(vk::CommandBuffer commandBuffer, uint32_t scope);
+
+		// Scopes with the same name in one frame are summed
+		std::vector<PipelineStatisticsResult> GetResults() const;
+		bool IsEnabled() const;
+	};
+}
\ No newline at end of file
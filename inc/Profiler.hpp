@@ -0,0 +1,113 @@
+#pragma once
+
+#include "pch.hpp"
+
+#include "Alias.hpp"
+
+namespace sqrp
+{
+	class Device;
+	enum class QueueContextType;
+
+	// Rolling statistics of one scope name over the last historySize frames
+	struct ProfileStats
+	{
+		std::string name;
+		bool isGpu = false;
+		double lastMs = 0.0;
+		double minMs = 0.0;
+		double avgMs = 0.0;
+		double p99Ms = 0.0;
+		uint32_t sampleCount = 0;
+	};
+
+	// GPU scopes are timestamp query pairs resolved when the inflight index is reused, so nothing stalls
+	// CPU scopes are measured immediately
+	// Both are also added to TraceRecorder while it is enabled
+	// Scopes with the same name in one frame are summed into one sample
+	class Profiler
+	{
+	private:
+		struct GpuScope
+		{
+			std::string name;
+			uint32_t beginQuery = 0;
+			uint32_t endQuery = 0;
+			uint64_t validMask = 0;
+			QueueContextType queueType;
+		};
+
+		struct FrameQueries
+		{
+			vk::UniqueQueryPool queryPool;
+			std::vector<GpuScope> scopes;
+			uint32_t queryCount = 0;
+		};
+
+		struct History
+		{
+			std::string name;
+			bool isGpu = false;
+			std::deque<double> samples;
+		};
+
+		const Device* pDevice_ = nullptr;
+		std::string name_;
+		uint32_t maxQueryCount_ = 0;
+		uint32_t historySize_ = 240;
+		// Nanoseconds per tick
+		float timestampPeriod_ = 1.0f;
+		// Timestamps are not written on queues without valid bits
+		std::map<QueueContextType, uint64_t> validMasks_;
+		bool isGpuEnabled_ = false;
+		bool isOverflowWarned_ = false;
+		// GPU timestamp in microseconds + offset = TraceRecorder::NowUs, measured once by Calibrate
+		double gpuToCpuOffsetUs_ = 0.0;
+
+		mutable std::mutex mutex_;
+		std::vector<FrameQueries> frames_;
+		uint32_t inflightIndex_ = 0;
+		// In the order of the first sample, which keeps the panel stable
+		std::vector<History> histories_;
+		std::unordered_map<std::string, uint32_t> historyIndices_;
+
+		void AddSampleLocked(const std::string& name, bool isGpu, double ms);
+		// NOTE : Clock drift is not corrected, GPU events of long traces may shift slightly
+		void Calibrate();
+
+	public:
+		static constexpr uint32_t InvalidScope = UINT32_MAX;
+
+		// maxScopeCount is per inflight frame, GPU scopes require hostQueryReset
+		Profiler(const Device& device, std::string name, uint32_t inflightCount, uint32_t maxScopeCount = 256, uint32_t historySize = 240);
+		~Profiler() = default;
+
+		// Resolves the GPU scopes of the frame which used this inflight index and resets its queries
+		// Call after the frame is waited, e.g. after Swapchain::WaitFrame
+		void BeginFrame(uint32_t inflightIndex);
+		// Writes the begin timestamp, returns InvalidScope if the scope is not recorded
+		uint32_t BeginGpuScope(vk::CommandBuffer commandBuffer, QueueContextType queueType, const std::string& name);
+		void EndGpuScope(vk::CommandBuffer commandBuffer, uint32_t scope);
+		void AddCpuSample(const std::string& name, double ms);
+
+		std::vector<ProfileStats> GetStats() const;
+		bool IsGpuEnabled() const;
+	};
+
+	// Measures the CPU time until the end of the scope
+	// Does nothing if pProfiler is nullptr and TraceRecorder is disabled
+	class CpuProfileScope
+	{
+	private:
+		Profiler* pProfiler_ = nullptr;
+		const char* name_ = nullptr;
+		bool isTraced_ = false;
+		double beginUs_ = 0.0;
+
+	public:
+		CpuProfileScope(Profiler* pProfiler, const char* name);
+		~CpuProfileScope();
+		CpuProfileScope(const CpuProfileScope&) = delete;
+		CpuProfileScope& operator=(const CpuProfileScope&) = delete;
+	};
+}
\ No newline at end of file
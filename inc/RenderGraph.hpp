@@ -0,0 +1,172 @@
+#pragma once
+
+#include "pch.hpp"
+
+#include "Alias.hpp"
+
+#include "Barrier.hpp"
+
+namespace sqrp
+{
+	class Buffer;
+	class CommandBuffer;
+	class Device;
+	class Image;
+
+	// Passes declare the images and buffers they read and write, the graph derives the barriers,
+	// culls passes whose results are not used and orders the rest
+	// Build once and Execute every frame, or Reset and rebuild each frame
+	// Transient images created by the graph share memory if their lifetimes don't overlap
+	// NOTE : Swapchain images are not tracked, mark the presenting pass with SetSideEffect
+	class RenderGraph
+	{
+	public:
+		using ExecuteFunction = std::function<void(CommandBufferHandle pCommandBuffer)>;
+
+		class PassBuilder
+		{
+		private:
+			RenderGraph* pRenderGraph_ = nullptr;
+			uint32_t passIndex_ = 0;
+
+		public:
+			PassBuilder(RenderGraph& renderGraph, uint32_t passIndex);
+
+			// stageMask == eNone derives the stages from the layout
+			PassBuilder& ReadImage(ImageHandle pImage, vk::ImageLayout layout = vk::ImageLayout::eShaderReadOnlyOptimal, vk::PipelineStageFlags2 stageMask = vk::PipelineStageFlagBits2::eNone);
+			// Previous contents are discarded, use ReadWriteImage for loaded attachments or partial writes
+			// finalLayout is the layout after the pass if its render pass transitions the image, eUndefined if unchanged
+			PassBuilder& WriteImage(ImageHandle pImage, vk::ImageLayout layout = vk::ImageLayout::eColorAttachmentOptimal, vk::ImageLayout finalLayout = vk::ImageLayout::eUndefined, vk::PipelineStageFlags2 stageMask = vk::PipelineStageFlagBits2::eNone);
+			PassBuilder& ReadWriteImage(ImageHandle pImage, vk::ImageLayout layout = vk::ImageLayout::eGeneral, vk::ImageLayout finalLayout = vk::ImageLayout::eUndefined, vk::PipelineStageFlags2 stageMask = vk::PipelineStageFlagBits2::eNone);
+			PassBuilder& ReadBuffer(BufferHandle pBuffer, vk::PipelineStageFlags2 stageMask, vk::AccessFlags2 accessMask = vk::AccessFlagBits2::eShaderRead);
+			PassBuilder& WriteBuffer(BufferHandle pBuffer, vk::PipelineStageFlags2 stageMask, vk::AccessFlags2 accessMask = vk::AccessFlagBits2::eShaderWrite);
+			PassBuilder& ReadWriteBuffer(BufferHandle pBuffer, vk::PipelineStageFlags2 stageMask, vk::AccessFlags2 accessMask = vk::AccessFlagBits2::eShaderRead | vk::AccessFlagBits2::eShaderWrite);
+			// Never culled, e.g. presents or reads back on the host
+			PassBuilder& SetSideEffect();
+			// The pass executes secondary command buffers, its pipeline statistics are skipped without inheritedQueries
+			PassBuilder& SetSecondaryCommandBuffers(bool isSecondary = true);
+		};
+
+	private:
+		struct ImageAccess
+		{
+			ImageHandle pImage = nullptr;
+			vk::ImageLayout layout = vk::ImageLayout::eUndefined;
+			vk::ImageLayout finalLayout = vk::ImageLayout::eUndefined;
+			vk::PipelineStageFlags2 stageMask;
+			vk::AccessFlags2 accessMask;
+			bool isRead = false;
+			bool isWrite = false;
+		};
+
+		struct BufferAccess
+		{
+			BufferHandle pBuffer = nullptr;
+			vk::PipelineStageFlags2 stageMask;
+			vk::AccessFlags2 accessMask;
+			bool isRead = false;
+			bool isWrite = false;
+		};
+
+		struct Pass
+		{
+			std::string name;
+			ExecuteFunction execute;
+			std::vector<ImageAccess> imageAccesses;
+			std::vector<BufferAccess> bufferAccesses;
+			bool hasSideEffect = false;
+			bool isSecondaryCommandBuffers = false;
+			// Filled by Compile
+			std::vector<uint32_t> producers;
+			std::vector<uint32_t> predecessors;
+			bool isCulled = false;
+		};
+
+		struct TransientImage
+		{
+			ImageHandle pImage = nullptr;
+			// Index of transientMemories_, -1 if not bound yet or lazily allocated
+			int memoryIndex = -1;
+			vk::DeviceSize offset = 0;
+			vk::DeviceSize size = 0;
+			// Positions in the execution order, -1 if unused
+			int firstUse = -1;
+			int lastUse = -1;
+		};
+
+		// Last use of a resource by the graph, carried over to the next Execute
+		struct ResourceState
+		{
+			vk::PipelineStageFlags2 stageMask;
+			vk::AccessFlags2 accessMask;
+			vk::ImageLayout layout = vk::ImageLayout::eUndefined;
+			bool isWrite = false;
+		};
+
+		const Device* pDevice_ = nullptr;
+		std::string name_;
+		std::vector<Pass> passes_;
+		std::vector<const void*> outputs_;
+		std::vector<uint32_t> executionOrder_;
+		bool isCompiled_ = false;
+		std::unordered_map<const void*, ResourceState> resourceStates_;
+		BarrierBatcher barrierBatcher_;
+
+		std::vector<TransientImage> transientImages_;
+		std::unordered_map<const void*, uint32_t> transientImageIndices_;
+		std::vector<VmaAllocation> transientMemories_;
+		std::vector<vk::DeviceSize> transientMemorySizes_;
+
+		// Called by Compile, and by Execute without re-planning
+		void CompileInternal(bool isReplanAllowed);
+		// Lifetimes from the execution order, binds unbound aliased images to new shared allocations
+		// If the previous plan doesn't fit, isReplanAllowed frees and rebinds all of them after waiting for the device idle
+		// Otherwise unbound images get extra allocations and overlapping aliased images throw
+		void PlanTransientMemory(bool isReplanAllowed);
+		bool IsAliased(const TransientImage& lhs, const TransientImage& rhs) const;
+		// pAliasSrc is the last use of the memory if this is the first use of an aliased image in Execute
+		void AddImageBarrier(const ImageAccess& imageAccess, const LayoutSyncInfo* pAliasSrc = nullptr);
+		void AddBufferBarrier(const BufferAccess& bufferAccess);
+		void UpdateImageState(const ImageAccess& imageAccess);
+		void UpdateBufferState(const BufferAccess& bufferAccess);
+
+	public:
+		RenderGraph(const Device& device, std::string name);
+		~RenderGraph();
+
+		PassBuilder AddPass(std::string name, ExecuteFunction execute);
+		// Used only inside the graph, contents are undefined at the first use of each Execute
+		// eTransientAttachment images use lazily allocated memory where supported, others are aliased
+		// NOTE : Views of aliased images are created by the first Compile using them, create framebuffers after it
+		// NOTE : Only an explicit Compile() re-plans memory which doesn't fit the new lifetimes
+		//        It waits for the device idle and recreates the aliased images and their views, framebuffers must be created again
+		ImageHandle CreateTransientImage(
+			std::string name,
+			vk::ImageCreateInfo imageCreateInfo,
+			vk::ImageAspectFlags aspectFlags = vk::ImageAspectFlagBits::eColor,
+			vk::SamplerCreateInfo samplerCreateInfo = {}
+		);
+		// Frees the shared memory and unbinds the transient images, e.g. after resizing them
+		// NOTE : The GPU must not use the transient images
+		void ReleaseTransientMemory();
+		// Passes writing outputs last are kept with the passes they depend on
+		void MarkOutput(ImageHandle pImage);
+		void MarkOutput(BufferHandle pBuffer);
+		// Called by Execute if the graph was changed, call it outside of the frame after changing the graph or resizing transient images
+		void Compile();
+		// Records the passes in execution order with the barriers between them
+		void Execute(CommandBufferHandle pCommandBuffer);
+		// Removes the passes and outputs, resource states are kept
+		void Reset();
+
+		// Pass indices in execution order, culled passes are excluded
+		const std::vector<uint32_t>& GetExecutionOrder() const;
+		uint32_t GetPassCount() const;
+		uint32_t GetCulledPassCount() const;
+		bool IsCulled(uint32_t passIndex) const;
+		std::string GetPassName(uint32_t passIndex) const;
+		// Allocated size of the shared memory and the size it would take without aliasing
+		vk::DeviceSize GetTransientMemorySize() const;
+		vk::DeviceSize GetTransientRequiredSize() const;
+	};
+}
\ No newline at end of file
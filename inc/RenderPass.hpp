@@ -30,6 +30,8 @@ namespace sqrp
 		std::vector<AttachmentInfo> attachmentInfos_;
 		int numColorAttachments_ = 0;
 		int numDepthAttachments_ = 0;
+		std::vector<int> subpassColorAttachmentCounts_;
+		uint64_t compatibilityHash_ = 0;
 
 
 	public:
@@ -43,13 +45,18 @@ namespace sqrp
 			const Device& device,
 			std::string name,
 			std::vector<SubPassInfo> subPassInfos,
-			std::map<std::string, AttachmentInfo> attachmentNameToInfo
+			std::map<std::string, AttachmentInfo> attachmentNameToInfo,
+			// Attachment index order (= FrameBuffer attachment order), order of first use if empty
+			std::vector<std::string> attachmentOrder = {}
 		);
 		~RenderPass() = default;
 
 		vk::RenderPass GetRenderPass() const;
 		int GetNumColorAttachments() const;
+		int GetNumSubpassColorAttachments(uint32_t subpass) const;
 		int GetNumAttachments() const;
 		std::vector<AttachmentInfo> GetAttachmentInfos() const;
+		// Render passes with the same hash are compatible (layouts and load / store ops are ignored)
+		uint64_t GetCompatibilityHash() const;
 	};
 }
\ No newline at end of file
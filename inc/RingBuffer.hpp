@@ -0,0 +1,60 @@
+#pragma once
+
+#include "pch.hpp"
+
+#include "Alias.hpp"
+
+namespace sqrp
+{
+	class Buffer;
+	class Device;
+
+	struct RingAllocation
+	{
+		// Offset from the beginning of the buffer, used as the dynamic offset
+		uint32_t offset = 0;
+		vk::DeviceSize size = 0;
+		void* pData = nullptr;
+	};
+
+	// Persistently mapped buffer divided into one region per inflight frame
+	// NOTE : The region of a frame is reused after Swapchain::WaitFrame, so the GPU never reads memory being written
+	class RingBuffer
+	{
+	private:
+		const Device* pDevice_ = nullptr;
+
+		BufferHandle pBuffer_ = nullptr;
+		uint8_t* pMappedData_ = nullptr;
+		vk::DeviceSize alignment_ = 0;
+		vk::DeviceSize frameSize_ = 0;
+		uint32_t inflightCount_ = 0;
+		uint32_t inflightIndex_ = 0;
+		// Offset inside the region of the current frame
+		vk::DeviceSize head_ = 0;
+
+	public:
+		RingBuffer(const Device& device, std::string name, vk::DeviceSize frameSize, uint32_t inflightCount, vk::BufferUsageFlags usage = vk::BufferUsageFlagBits::eUniformBuffer);
+		~RingBuffer() = default;
+
+		// Reset the region of the inflight frame, call after waiting for the frame
+		void BeginFrame(uint32_t inflightIndex);
+		// Aligned to minUniformBufferOffsetAlignment (minStorageBufferOffsetAlignment for storage buffers)
+		RingAllocation Allocate(vk::DeviceSize size);
+		template<typename T>
+		uint32_t Push(const T& data)
+		{
+			RingAllocation allocation = Allocate(sizeof(T));
+			std::memcpy(allocation.pData, &data, sizeof(T));
+			return allocation.offset;
+		}
+		// Make the writes of the current frame visible to the device (no-op for host coherent memory)
+		void Flush();
+
+		BufferHandle GetBuffer() const;
+		vk::DeviceSize GetAlignment() const;
+		vk::DeviceSize GetFrameSize() const;
+		// Bytes allocated in the current frame
+		vk::DeviceSize GetUsedSize() const;
+	};
+}
\ No newline at end of file
@@ -18,12 +18,19 @@ namespace sqrp
 
 		vk::UniqueShaderModule shaderModule_;
 		vk::ShaderStageFlagBits shaderStage_;
+		// Hash of SPIR-V and stage, identifies the module in pipeline state hash
+		uint64_t hash_ = 0;
+
+		void CreateShaderModule(const std::vector<uint32_t>& spirv);
 
 	public:
 		Shader(const Device& device, const Compiler& compiler, const std::string& fileName, ShaderType shaderType);
+		// For precompiled SPIR-V (e.g. Compiler::CompileBatch)
+		Shader(const Device& device, const std::vector<uint32_t>& spirv, ShaderType shaderType);
 		~Shader() = default;
 
 		vk::ShaderModule GetShaderModule() const;
 		vk::ShaderStageFlagBits GetShaderStage() const;
+		uint64_t GetHash() const;
 	};
 }
\ No newline at end of file
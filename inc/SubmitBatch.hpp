@@ -0,0 +1,61 @@
+#pragma once
+
+#include "pch.hpp"
+
+#include "Alias.hpp"
+
+#include "Device.hpp"
+
+namespace sqrp
+{
+	class CommandBuffer;
+	class Fence;
+
+	// Accumulates command buffers, waits and signals for one queue and flushes them with one vkQueueSubmit2
+	// Reuse one instance per queue per frame, Flush keeps the capacity
+	class SubmitBatch
+	{
+	private:
+		// Ranges in the flat arrays, resolved to pointers at Flush since the arrays may grow
+		struct Entry
+		{
+			uint32_t waitOffset = 0;
+			uint32_t waitCount = 0;
+			uint32_t commandBufferOffset = 0;
+			uint32_t commandBufferCount = 0;
+			uint32_t signalOffset = 0;
+			uint32_t signalCount = 0;
+		};
+
+		const Device* pDevice_ = nullptr;
+		QueueContextType queueType_ = QueueContextType::General;
+
+		std::vector<Entry> entries_;
+		std::vector<vk::SemaphoreSubmitInfo> waitInfos_;
+		std::vector<vk::CommandBufferSubmitInfo> commandBufferInfos_;
+		std::vector<vk::SemaphoreSubmitInfo> signalInfos_;
+		std::vector<vk::SubmitInfo2> submitInfos_;
+
+	public:
+		SubmitBatch(const Device& device, QueueContextType queueType = QueueContextType::General);
+		~SubmitBatch() = default;
+
+		// Waits apply to this command buffer and later ones in the same entry, signals happen after it
+		// Merged into the previous entry if it doesn't change the dependencies
+		SubmitBatch& Add(
+			CommandBufferHandle pCommandBuffer,
+			const std::vector<SubmitSemaphore>& waitSemaphores = {},
+			const std::vector<SubmitSemaphore>& signalSemaphores = {}
+		);
+		// Semaphore only entries, e.g. to signal a timeline value without a command buffer
+		SubmitBatch& Wait(const SubmitSemaphore& waitSemaphore);
+		SubmitBatch& Signal(const SubmitSemaphore& signalSemaphore);
+		// Submits all entries in one call and clears the batch, does nothing if empty
+		void Flush(FenceHandle pFence = nullptr);
+
+		bool IsEmpty() const;
+		uint32_t GetCommandBufferCount() const;
+		uint32_t GetEntryCount() const;
+		QueueContextType GetQueueType() const;
+	};
+}
\ No newline at end of file
@@ -8,8 +8,8 @@ namespace sqrp
 {
 	class CommandBuffer;
 	class Device;
-	class Fence;
 	class Semaphore;
+	class TimelineSemaphore;
 
 	class Swapchain
 	{
@@ -24,6 +24,7 @@ namespace sqrp
 
 		vk::SurfaceCapabilitiesKHR capabilities_;
 		vk::SurfaceFormatKHR surfaceFormat_;
+		vk::ImageUsageFlags imageUsage_;
 		vk::PresentModeKHR presentMode_;
 		uint32_t width_;
 		uint32_t height_;
@@ -32,10 +33,13 @@ namespace sqrp
 		// Swapchain images are managed by the swapchain itself
 		// so are not managed by user and you should not use vk::UniqueImage
 		std::vector<vk::Image> swapchainImages_;
+		FrameCommandAllocatorHandle graphicsCommandAllocator_;
 		std::vector<CommandBufferHandle> graphicsCommandBuffers_;
-		std::vector<FenceHandle> graphicsFences_;
 		std::vector<CommandBufferHandle> computeCommandBuffers_;
-		std::vector<FenceHandle> computeFences_;
+		// Signaled by the submit of each frame, kept across Recreate so that values keep increasing
+		TimelineSemaphoreHandle frameTimeline_;
+		// Value signaled by the last frame which used each inflight index
+		std::vector<uint64_t> inflightFrameValues_;
 		std::vector<SemaphoreHandle> imageAcquireSemaphores_;
 		std::vector<SemaphoreHandle> renderCompleteSemaphores_;
 
@@ -44,6 +48,7 @@ namespace sqrp
 		~Swapchain() = default;
 
 		void Recreate(uint32_t width, uint32_t height);
+		// Valid after WaitFrame until WaitFrame of the same inflight index
 		CommandBufferHandle& GetCurrentCommandBuffer();
 		void WaitFrame();
 		void Present();
@@ -60,6 +65,12 @@ namespace sqrp
 		uint32_t GetMinImageCount() const;
 		SemaphoreHandle GetImageAcquireSemaphore() const;
 		SemaphoreHandle GetRenderCompleteSemaphore() const;
-		FenceHandle GetCurrentFence() const;
+		// Has eTransferSrc if the surface supports capturing swapchain images
+		vk::ImageUsageFlags GetImageUsage() const;
+		// Allocates additional command buffers of the current frame, reset by WaitFrame
+		FrameCommandAllocatorHandle GetGraphicsCommandAllocator() const;
+		TimelineSemaphoreHandle GetFrameTimeline() const;
+		// Value to signal on the frame timeline by the submit of the current frame
+		uint64_t GetCurrentFrameValue() const;
 	};
 }
\ No newline at end of file
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "pch.hpp"
+
+namespace sqrp
+{
+	class ThreadPool
+	{
+	private:
+		std::vector<std::thread> workers_;
+		std::queue<std::function<void()>> tasks_;
+		std::mutex mutex_;
+		std::condition_variable condition_;
+		bool isStopping_ = false;
+
+		void WorkerLoop();
+
+	public:
+		// threadCount == 0 uses the number of hardware threads
+		ThreadPool(uint32_t threadCount = 0);
+		~ThreadPool();
+
+		template<typename F>
+		auto Enqueue(F&& func) -> std::future<std::invoke_result_t<F>>
+		{
+			using ReturnType = std::invoke_result_t<F>;
+
+			// std::function requires a copyable callable, so packaged_task is shared
+			auto task = std::make_shared<std::packaged_task<ReturnType()>>(std::forward<F>(func));
+			std::future<ReturnType> future = task->get_future();
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				if (isStopping_) {
+					throw std::runtime_error("Enqueue on stopped ThreadPool");
+				}
+				tasks_.push([task]() { (*task)(); });
+			}
+			condition_.notify_one();
+
+			return future;
+		}
+
+		uint32_t GetThreadCount() const;
+	};
+}
\ No newline at end of file
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "pch.hpp"
+
+#include "Alias.hpp"
+
+namespace sqrp
+{
+	class Device;
+
+	// Vulkan 1.2 timeline semaphore, the payload is a monotonically increasing counter
+	// GPU work signals / waits exact values, CPU can poll or wait without fences
+	class TimelineSemaphore
+	{
+	private:
+		const Device* pDevice_ = nullptr;
+
+		std::string name_ = "TimelineSemaphore";
+		vk::UniqueSemaphore semaphore_;
+		// Last value handed out by NextValue
+		std::atomic<uint64_t> lastValue_ = 0;
+
+	public:
+		TimelineSemaphore(const Device& device, std::string name = "TimelineSemaphore", uint64_t initialValue = 0);
+		~TimelineSemaphore() = default;
+
+		// Reserves the next value to signal, values must be signaled in increasing order
+		uint64_t NextValue();
+		uint64_t GetLastValue() const;
+		// Current value of the payload on the GPU
+		uint64_t GetCompletedValue() const;
+		bool IsCompleted(uint64_t value) const;
+		// Returns false on timeout
+		bool Wait(uint64_t value, uint64_t timeout = UINT64_MAX) const;
+		// Signals from the CPU
+		void Signal(uint64_t value);
+
+		vk::Semaphore GetSemaphore() const;
+	};
+}
\ No newline at end of file
@@ -0,0 +1,95 @@
+#pragma once
+
+#include "pch.hpp"
+
+namespace sqrp
+{
+	// Chrome trace (chrome://tracing, Perfetto) recorder of CPU scopes per thread and resolved GPU scopes
+	// Each thread appends to its own buffer without locks, the mutex is taken only once per thread and session,
+	// and by WriteChromeTrace to copy the events
+	class TraceRecorder
+	{
+	private:
+		struct Event
+		{
+			// Truncated, names are copied so that dynamic names are safe
+			char name[64] = {};
+			const char* category = "";
+			// Process 0 is CPU, 1 is GPU
+			uint32_t processId = 0;
+			// GPU events use the track instead of the thread
+			uint32_t trackId = 0;
+			double beginUs = 0.0;
+			double durationUs = 0.0;
+		};
+
+		// Written by the owner thread only, published to readers with count
+		struct Chunk
+		{
+			static constexpr uint32_t Capacity = 1024;
+			std::array<Event, Capacity> events;
+			std::atomic<uint32_t> count = 0;
+			std::atomic<Chunk*> pNext = nullptr;
+		};
+
+		struct ThreadBuffer
+		{
+			uint32_t threadId = 0;
+			std::string threadName;
+			// Allocated by the first event, threads which only set the name don't allocate chunks
+			std::atomic<Chunk*> pHead = nullptr;
+			// Owner thread only
+			Chunk* pTail = nullptr;
+			// Chunks of an older session are freed by the owner thread on its next event
+			std::atomic<uint64_t> sessionId = 0;
+
+			~ThreadBuffer();
+		};
+
+		static std::atomic<bool> isEnabled_;
+		// Incremented by Clear
+		static std::atomic<uint64_t> sessionId_;
+		static std::mutex registryMutex_;
+		// Kept after the thread exits so that its events can still be written
+		static std::vector<std::unique_ptr<ThreadBuffer>> threadBuffers_;
+		static std::map<uint32_t, std::string> gpuTrackNames_;
+
+		static ThreadBuffer& GetThreadBuffer();
+		static void FreeChunks(Chunk* pChunk);
+		static void Append(const Event& event);
+
+	public:
+		static void SetEnabled(bool isEnabled);
+		static bool IsEnabled();
+		// Microseconds on the steady clock since the first call in the process
+		static double NowUs();
+
+		// Shown instead of the thread id
+		static void SetThreadName(const std::string& name);
+		static void SetGpuTrackName(uint32_t trackId, const std::string& name);
+		static void AddCpuEvent(std::string_view name, const char* category, double beginUs, double durationUs);
+		// beginUs must be converted to the CPU clock of NowUs
+		static void AddGpuEvent(std::string_view name, uint32_t trackId, double beginUs, double durationUs);
+
+		// Drops the events recorded so far, e.g. when a new recording starts
+		// Events being added by other threads at the same time may be dropped as well
+		static void Clear();
+		// Writes all events recorded since the last Clear, can be called while other threads are recording
+		static bool WriteChromeTrace(const std::string& path);
+	};
+
+	// Adds a CPU event for the scope while the recorder is enabled
+	class TraceScope
+	{
+	private:
+		const char* name_ = nullptr;
+		const char* category_ = nullptr;
+		double beginUs_ = -1.0;
+
+	public:
+		TraceScope(const char* name, const char* category = "cpu");
+		~TraceScope();
+		TraceScope(const TraceScope&) = delete;
+		TraceScope& operator=(const TraceScope&) = delete;
+	};
+}
\ No newline at end of file
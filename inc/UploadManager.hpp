@@ -0,0 +1,107 @@
+#pragma once
+
+#include "pch.hpp"
+
+#include "Alias.hpp"
+
+#include "Device.hpp"
+
+namespace sqrp
+{
+	class Buffer;
+	class CommandBuffer;
+	class Image;
+	class TimelineSemaphore;
+
+	// Records buffer / image uploads into one command buffer per batch through a reusable staging ring
+	// Copies run on the upload queue (a transfer-only queue if available) and are made usable on the destination queue
+	// If the queue families differ, ownership is released by the copy batch and acquired by a small batch on the destination queue
+	// A ticket is the value of GetTimeline() signaled when the batch is usable on the destination queue
+	// Thread safe, submits take Device::LockQueue so uploads and waits can run beside the render thread
+	class UploadManager
+	{
+	private:
+		struct Batch
+		{
+			uint64_t ticket = 0;
+			CommandBufferHandle pCommandBuffer = nullptr;
+			// Only used if the queue families differ
+			CommandBufferHandle pAcquireCommandBuffer = nullptr;
+			bool isAcquired = false;
+			// Staging ring position after the last allocation of this batch
+			uint64_t stagingEnd = 0;
+			// Kept alive until the copies complete
+			std::vector<BufferHandle> pBuffers;
+			std::vector<ImageHandle> pImages;
+			// Barriers recorded at the end of the batch, also used as acquire barriers if the queue families differ
+			std::vector<vk::BufferMemoryBarrier2> bufferBarriers;
+			std::vector<vk::ImageMemoryBarrier2> imageBarriers;
+		};
+
+		const Device* pDevice_ = nullptr;
+		QueueContextType queueType_ = QueueContextType::General;
+		QueueContextType dstQueueType_ = QueueContextType::General;
+		uint32_t queueFamilyIndex_ = VK_QUEUE_FAMILY_IGNORED;
+		uint32_t dstQueueFamilyIndex_ = VK_QUEUE_FAMILY_IGNORED;
+
+		BufferHandle pStagingBuffer_ = nullptr;
+		uint8_t* pStagingData_ = nullptr;
+		vk::DeviceSize stagingSize_ = 0;
+		// Monotonic positions, the offset in the ring is position % stagingSize_
+		uint64_t stagingHead_ = 0;
+		uint64_t stagingTail_ = 0;
+
+		std::optional<Batch> recordingBatch_ = std::nullopt;
+		std::deque<Batch> submittedBatches_;
+		// Command buffers of retired batches are reused
+		std::vector<Batch> freeBatches_;
+		// Signaled with the ticket when the batch is usable on the destination queue
+		TimelineSemaphoreHandle timeline_;
+		// Signaled with the ticket when the copies complete, only used if the queue families differ
+		TimelineSemaphoreHandle copyTimeline_;
+		uint64_t nextTicket_ = 1;
+		uint64_t completedTicket_ = 0;
+		std::mutex mutex_;
+
+		// NOTE : Following functions require mutex_ to be locked
+		bool IsOwnershipTransferRequired() const;
+		Batch& GetRecordingBatch();
+		// Returns the offset in the staging ring, submits or waits batches if the ring is full
+		vk::DeviceSize AllocateStaging(vk::DeviceSize size);
+		void AddBufferBarrier(Batch& batch, BufferHandle pBuffer, vk::DeviceSize offset, vk::DeviceSize size);
+		void AddImageBarrier(Batch& batch, ImageHandle pImage, vk::ImageLayout finalLayout);
+		void SubmitRecordingBatch();
+		void SubmitAcquire(Batch& batch);
+		bool RetireBatch(bool wait);
+
+	public:
+		// stagingSize is the capacity of the ring, larger uploads use a dedicated staging buffer
+		UploadManager(
+			const Device& device,
+			vk::DeviceSize stagingSize = 64 * 1024 * 1024,
+			QueueContextType queueType = QueueContextType::General,
+			QueueContextType dstQueueType = QueueContextType::General
+		);
+		~UploadManager();
+
+		// Returns the ticket of the batch that contains the upload
+		// NOTE : Contents outside of the uploaded range are not preserved if ownership is transferred
+		uint64_t UploadBuffer(BufferHandle pDstBuffer, const void* data, vk::DeviceSize size, vk::DeviceSize dstOffset = 0);
+		// Uploads mip 0 / layer 0 and transitions the whole image to finalLayout
+		uint64_t UploadImage(ImageHandle pDstImage, const void* data, vk::DeviceSize size, vk::ImageLayout finalLayout = vk::ImageLayout::eShaderReadOnlyOptimal);
+		// Starts the copies of the recording batch on the upload queue without acquiring them
+		// Call early in the frame so that the copies overlap rendering and the next Flush does not wait on the GPU
+		uint64_t SubmitCopies();
+		// Submits the copies and acquires all submitted batches on the destination queue, called by Device::Submit on it
+		// Returns the ticket of the last submitted batch
+		uint64_t Flush();
+		bool IsComplete(uint64_t ticket);
+		void Wait(uint64_t ticket);
+		void WaitAll();
+
+		QueueContextType GetQueueType() const;
+		QueueContextType GetDstQueueType() const;
+		// Submits on other queues can wait on this at a ticket instead of waiting on the CPU
+		TimelineSemaphoreHandle GetTimeline() const;
+	};
+}
\ No newline at end of file
@@ -34,18 +34,29 @@
 
 #include <algorithm>
 #include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <cstdint>
 #include <cstdlib>
+#include <cstring>
+#include <deque>
 #include <filesystem>
 #include <fstream>
 #include <functional>
+#include <future>
 #include <initializer_list>
+#include <iomanip>
 #include <iostream>
 #include <map>
+#include <mutex>
 #include <optional>
+#include <queue>
 #include <set>
 #include <sstream>
 #include <string>
+#include <thread>
+#include <type_traits>
 #include <unordered_map>
 #include <variant>
 #include <vector>
\ No newline at end of file
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <Application.hpp>
+#include <Barrier.hpp>
 #include <Buffer.hpp>
 #include <Camera.hpp>
 #include <CommandBuffer.hpp>
@@ -9,12 +10,25 @@
 #include <DescriptorSet.hpp>
 #include <Fence.hpp>
 #include <FrameBuffer.hpp>
+#include <FrameCapture.hpp>
+#include <FrameCommandAllocator.hpp>
 #include <Gui.hpp>
+#include <Hash.hpp>
 #include <Image.hpp>
 #include <Mesh.hpp>
 #include <Object.hpp>
+#include <ParallelRecorder.hpp>
 #include <Pipeline.hpp>
+#include <PipelineStatistics.hpp>
+#include <Profiler.hpp>
+#include <RenderGraph.hpp>
 #include <RenderPass.hpp>
+#include <RingBuffer.hpp>
 #include <Shader.hpp>
 #include <Semaphore.hpp>
-#include <Swapchain.hpp>
\ No newline at end of file
+#include <SubmitBatch.hpp>
+#include <Swapchain.hpp>
+#include <ThreadPool.hpp>
+#include <TimelineSemaphore.hpp>
+#include <TraceRecorder.hpp>
+#include <UploadManager.hpp>
\ No newline at end of file
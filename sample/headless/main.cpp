@@ -0,0 +1,364 @@
+#include <sqrap.hpp>
+
+using namespace std;
+using namespace sqrp;
+
+namespace
+{
+	constexpr uint32_t Width = 512;
+	constexpr uint32_t Height = 512;
+	constexpr vk::Format ColorFormat = vk::Format::eR8G8B8A8Srgb;
+	constexpr vk::Format DepthFormat = vk::Format::eD32Sfloat;
+	constexpr vk::SampleCountFlagBits MsaaSampleCount = vk::SampleCountFlagBits::e4;
+
+	struct Light
+	{
+		glm::vec4 pos;
+		glm::vec4 color;
+	};
+
+	struct Options
+	{
+		string outputPath = "headless.png";
+		// Compared with the capture if not empty
+		string goldenPath;
+		// Overwrites the golden with the capture instead of comparing
+		bool updateGolden = false;
+		// Max difference per channel (0 - 255) to count a pixel as equal, absorbs rasterization differences between drivers
+		int tolerance = 2;
+		// Fraction of pixels allowed to exceed the tolerance
+		double maxErrorRatio = 0.001;
+		// Renders a front and a side view with transient multisampled targets aliased by the render graph
+		// The side view is written to <output>.side.png
+		bool isMsaa = false;
+	};
+
+	Options ParseOptions(int argc, char** argv)
+	{
+		Options options;
+		for (int i = 1; i < argc; i++) {
+			string arg = argv[i];
+			bool hasValue = i + 1 < argc;
+			if (arg == "--golden" && hasValue) {
+				options.goldenPath = argv[++i];
+			}
+			else if (arg == "--update-golden") {
+				options.updateGolden = true;
+			}
+			else if (arg == "--tolerance" && hasValue) {
+				options.tolerance = stoi(argv[++i]);
+			}
+			else if (arg == "--max-error-ratio" && hasValue) {
+				options.maxErrorRatio = stod(argv[++i]);
+			}
+			else if (arg == "--msaa") {
+				options.isMsaa = true;
+			}
+			else if (arg.rfind("--", 0) == 0) {
+				throw std::runtime_error("Unknown option " + arg);
+			}
+			else {
+				options.outputPath = arg;
+			}
+		}
+		return options;
+	}
+
+	// Returns false if the capture differs from the golden, the difference is written next to the output
+	bool CompareWithGolden(const CaptureResult& capture, const Options& options)
+	{
+		int width = 0;
+		int height = 0;
+		int channels = 0;
+		uint8_t* golden = stbi_load(options.goldenPath.c_str(), &width, &height, &channels, 4);
+		if (!golden) {
+			cerr << "Failed to load golden " << options.goldenPath << ", run with --update-golden to create it" << endl;
+			return false;
+		}
+		if (width != static_cast<int>(capture.width) || height != static_cast<int>(capture.height)) {
+			cerr << "Golden size " << width << "x" << height << " differs from the capture " << capture.width << "x" << capture.height << endl;
+			stbi_image_free(golden);
+			return false;
+		}
+
+		uint32_t errorPixelCount = 0;
+		int maxDiff = 0;
+		CaptureResult diff = capture;
+		for (size_t i = 0; i < capture.pixels.size(); i += 4) {
+			int pixelDiff = 0;
+			for (size_t c = 0; c < 3; c++) {
+				pixelDiff = std::max(pixelDiff, std::abs(static_cast<int>(capture.pixels[i + c]) - static_cast<int>(golden[i + c])));
+			}
+			maxDiff = std::max(maxDiff, pixelDiff);
+			if (pixelDiff > options.tolerance) {
+				errorPixelCount++;
+			}
+			// Red where the pixel exceeds the tolerance, gray scale of the difference otherwise
+			uint8_t value = static_cast<uint8_t>(std::min(255, pixelDiff * 8));
+			diff.pixels[i + 0] = pixelDiff > options.tolerance ? 255 : value;
+			diff.pixels[i + 1] = pixelDiff > options.tolerance ? 0 : value;
+			diff.pixels[i + 2] = pixelDiff > options.tolerance ? 0 : value;
+			diff.pixels[i + 3] = 255;
+		}
+		stbi_image_free(golden);
+
+		double errorRatio = static_cast<double>(errorPixelCount) / (static_cast<double>(capture.width) * capture.height);
+		cout << "Golden compare : " << errorPixelCount << " pixels over tolerance " << options.tolerance
+			<< " (ratio " << errorRatio << ", max " << options.maxErrorRatio << "), max channel diff " << maxDiff << endl;
+		if (errorRatio > options.maxErrorRatio) {
+			string diffPath = options.outputPath + ".diff.png";
+			WriteCapturePNG(diff, diffPath);
+			cerr << "Golden mismatch, see " << diffPath << endl;
+			return false;
+		}
+		return true;
+	}
+}
+
+// Renders one frame without a window and writes it to a PNG, runs on servers without a display (e.g. lavapipe)
+// Usage : sqrap-vk-sample-headless [output.png] [--golden golden.png [--update-golden] [--tolerance 2] [--max-error-ratio 0.001]] [--msaa]
+// Exits with 1 if the capture doesn't match the golden, so it can gate CI
+int main(int argc, char** argv)
+{
+	try {
+		Options options = ParseOptions(argc, argv);
+
+		Device device;
+		device.SetPipelineCachePath(PIPELINE_CACHE_PATH);
+		if (!device.InitHeadless("sqrap-vk-sample-headless")) {
+			throw std::runtime_error("Failed to initialize device.");
+		}
+		// Golden images may differ between devices
+		cout << "Device : " << device.GetPhysicalDevice().getProperties().deviceName.data() << endl;
+		Compiler compiler(SHADER_CACHE_DIR);
+
+		ImageHandle colorImage = device.CreateImage(
+			"Color",
+			vk::Extent3D{ Width, Height, 1 },
+			vk::ImageType::e2D,
+			vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eTransferSrc,
+			ColorFormat
+		);
+		ImageHandle depthImage = device.CreateImage(
+			"Depth",
+			vk::Extent3D{ Width, Height, 1 },
+			vk::ImageType::e2D,
+			vk::ImageUsageFlagBits::eDepthStencilAttachment,
+			DepthFormat,
+			vk::ImageLayout::eUndefined,
+			vk::ImageAspectFlagBits::eDepth
+		);
+
+		MeshHandle mesh = device.CreateMesh(string(MODEL_DIR) + "Suzanne.gltf");
+
+		Camera camera;
+		camera.Init((float)Width / (float)Height, glm::vec3(0.0f, 0.0f, 5.0f));
+		TransformMatrix object = {};
+		Light light = { glm::vec4(10.0f, 10.0f, -5.0f, 1.0f), glm::vec4(1.0f, 1.0f, 1.0f, 1.0f) };
+		glm::vec4 baseColor = glm::vec4(1.0f, 0.0f, 0.0f, 1.0f);
+
+		RingBufferHandle uniformRing = device.CreateRingBuffer("uniform", 8 * 256, 1);
+		auto uniformBuffer = uniformRing->GetBuffer();
+		DescriptorSetHandle descriptorSet = device.CreateDescriptorSet(
+			"",
+			{
+			{ uniformBuffer, vk::DescriptorType::eUniformBufferDynamic, vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment, -1, sizeof(CameraMatrix) },
+			{ uniformBuffer, vk::DescriptorType::eUniformBufferDynamic, vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment, -1, sizeof(TransformMatrix) },
+			{ uniformBuffer, vk::DescriptorType::eUniformBufferDynamic, vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment, -1, sizeof(Light) },
+			{ uniformBuffer, vk::DescriptorType::eUniformBufferDynamic, vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment, -1, sizeof(glm::vec4) }
+			}
+		);
+
+		uniformRing->BeginFrame(0);
+		std::vector<uint32_t> dynamicOffsets = {
+			uniformRing->Push(CameraMatrix{ camera.GetView(), camera.GetProj() }),
+			uniformRing->Push(object),
+			uniformRing->Push(light),
+			uniformRing->Push(baseColor)
+		};
+		// Same scene seen from the right for the side view
+		Camera sideCamera;
+		sideCamera.Init((float)Width / (float)Height, glm::vec3(5.0f, 0.0f, 0.0f), glm::quat(glm::vec3(0.0f, glm::radians(90.0f), 0.0f)));
+		std::vector<uint32_t> sideDynamicOffsets = dynamicOffsets;
+		sideDynamicOffsets[0] = uniformRing->Push(CameraMatrix{ sideCamera.GetView(), sideCamera.GetProj() });
+		uniformRing->Flush();
+
+		auto shaders = device.CreateShaders(
+			compiler,
+			{
+			{ string(SHADER_DIR) + "Lambert.shader", sqrp::ShaderType::Vertex },
+			{ string(SHADER_DIR) + "Lambert.shader", sqrp::ShaderType::Pixel }
+			}
+		);
+		vk::PushConstantRange instanceRange = vk::PushConstantRange{}
+			.setStageFlags(vk::ShaderStageFlagBits::eVertex)
+			.setOffset(0)
+			.setSize(sizeof(glm::vec4));
+		GraphicsPipelineHandle pipeline = device.CreateGraphicsPipeline(
+			"Headless",
+			RenderingFormats{ { ColorFormat }, DepthFormat },
+			shaders[0],
+			shaders[1],
+			descriptorSet,
+			GraphicsPipelineDesc{},
+			instanceRange
+		);
+
+		vk::ClearColorValue clearColor = vk::ClearColorValue{ std::array<float, 4>{ 0.0f, 0.0f, 0.0f, 1.0f } };
+		auto drawScene = [&](CommandBufferHandle pCommandBuffer, GraphicsPipelineHandle pPipeline, const std::vector<uint32_t>& offsets) {
+			pCommandBuffer->SetViewport(Width, Height);
+			pCommandBuffer->SetScissor(Width, Height);
+			pCommandBuffer->BindPipeline(pPipeline, vk::PipelineBindPoint::eGraphics);
+			pCommandBuffer->BindDescriptorSet(pPipeline, descriptorSet, vk::PipelineBindPoint::eGraphics, offsets);
+			pCommandBuffer->BindMeshBuffer(mesh);
+			glm::vec4 offset = glm::vec4(0.0f);
+			pCommandBuffer->PushConstants(pPipeline, vk::ShaderStageFlagBits::eVertex, sizeof(glm::vec4), &offset);
+			pCommandBuffer->DrawMesh(mesh, mesh->GetNumIndices());
+		};
+
+		// Each view has its own multisampled targets, the graph places those of the side view on the memory of the front view
+		RenderGraphHandle renderGraph;
+		ImageHandle sideImage;
+		std::vector<ImageHandle> transientImages;
+		if (options.isMsaa) {
+			vk::PhysicalDeviceLimits limits = device.GetPhysicalDevice().getProperties().limits;
+			if (!(limits.framebufferColorSampleCounts & limits.framebufferDepthSampleCounts & MsaaSampleCount)) {
+				throw std::runtime_error("4x MSAA is not supported");
+			}
+			GraphicsPipelineDesc msaaDesc{};
+			msaaDesc.sampleCount = MsaaSampleCount;
+			GraphicsPipelineHandle msaaPipeline = device.CreateGraphicsPipeline(
+				"HeadlessMsaa",
+				RenderingFormats{ { ColorFormat }, DepthFormat },
+				shaders[0],
+				shaders[1],
+				descriptorSet,
+				msaaDesc,
+				instanceRange
+			);
+			sideImage = device.CreateImage(
+				"Side",
+				vk::Extent3D{ Width, Height, 1 },
+				vk::ImageType::e2D,
+				vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eTransferSrc,
+				ColorFormat
+			);
+
+			renderGraph = device.CreateRenderGraph("Headless");
+			auto createTarget = [&](const string& name, vk::Format format, vk::ImageUsageFlags usage, vk::ImageAspectFlags aspectFlags) {
+				// eTransientAttachment uses lazily allocated memory on tiled GPUs, aliased memory elsewhere
+				ImageHandle pImage = renderGraph->CreateTransientImage(
+					name,
+					vk::ImageCreateInfo()
+					.setImageType(vk::ImageType::e2D)
+					.setFormat(format)
+					.setExtent(vk::Extent3D{ Width, Height, 1 })
+					.setMipLevels(1)
+					.setArrayLayers(1)
+					.setSamples(MsaaSampleCount)
+					.setTiling(vk::ImageTiling::eOptimal)
+					.setUsage(usage | vk::ImageUsageFlagBits::eTransientAttachment)
+					.setInitialLayout(vk::ImageLayout::eUndefined),
+					aspectFlags
+				);
+				transientImages.push_back(pImage);
+				return pImage;
+			};
+			struct View
+			{
+				string name;
+				ImageHandle pResolveImage;
+				std::vector<uint32_t> dynamicOffsets;
+			};
+			for (const auto& view : { View{ "Front", colorImage, dynamicOffsets }, View{ "Side", sideImage, sideDynamicOffsets } }) {
+				ImageHandle msaaColor = createTarget(view.name + "MsaaColor", ColorFormat, vk::ImageUsageFlagBits::eColorAttachment, vk::ImageAspectFlagBits::eColor);
+				ImageHandle msaaDepth = createTarget(view.name + "MsaaDepth", DepthFormat, vk::ImageUsageFlagBits::eDepthStencilAttachment, vk::ImageAspectFlagBits::eDepth);
+				renderGraph->AddPass(view.name, [=, &drawScene](CommandBufferHandle pCommandBuffer) {
+					// Only the resolved image is stored
+					pCommandBuffer->BeginRendering(
+						{ RenderingAttachment{ msaaColor, vk::AttachmentLoadOp::eClear, vk::AttachmentStoreOp::eDontCare, clearColor, view.pResolveImage } },
+						RenderingAttachment{ msaaDepth, vk::AttachmentLoadOp::eClear, vk::AttachmentStoreOp::eDontCare, vk::ClearDepthStencilValue{ 1.0f, 0 } }
+					);
+					drawScene(pCommandBuffer, msaaPipeline, view.dynamicOffsets);
+					pCommandBuffer->EndRendering();
+				})
+					.WriteImage(msaaColor)
+					.WriteImage(msaaDepth, vk::ImageLayout::eDepthStencilAttachmentOptimal)
+					.WriteImage(view.pResolveImage);
+				renderGraph->MarkOutput(view.pResolveImage);
+			}
+			// Transient memory is planned before recording
+			renderGraph->Compile();
+		}
+
+		// The capture is tracked by the timeline value instead of idling the queue
+		TimelineSemaphoreHandle timeline = device.CreateTimelineSemaphore("Headless");
+		FrameCaptureHandle frameCapture = device.CreateFrameCapture("Headless", 2);
+		CommandBufferHandle commandBuffer = device.CreateCommandBuffer("Headless");
+		uint64_t completeValue = timeline->NextValue();
+
+		commandBuffer->Begin(vk::CommandBufferUsageFlagBits::eOneTimeSubmit);
+		if (renderGraph) {
+			renderGraph->Execute(commandBuffer);
+		}
+		else {
+			commandBuffer->BeginRendering(
+				{ RenderingAttachment{ colorImage, vk::AttachmentLoadOp::eClear, vk::AttachmentStoreOp::eStore, clearColor } },
+				RenderingAttachment{ depthImage, vk::AttachmentLoadOp::eClear, vk::AttachmentStoreOp::eDontCare, vk::ClearDepthStencilValue{ 1.0f, 0 } }
+			);
+			drawScene(commandBuffer, pipeline, dynamicOffsets);
+			commandBuffer->EndRendering();
+		}
+		uint64_t captureId = frameCapture->Capture(commandBuffer, colorImage, timeline, completeValue);
+		uint64_t sideCaptureId = sideImage ? frameCapture->Capture(commandBuffer, sideImage, timeline, completeValue) : 0;
+		commandBuffer->End();
+		device.Submit(QueueContextType::General, std::vector<CommandBufferHandle>{ commandBuffer }, {}, { SubmitSemaphore{ timeline->GetSemaphore(), completeValue } });
+
+		if (renderGraph) {
+			// Lazily allocated images are not backed by the shared memory
+			uint32_t lazyCount = 0;
+			for (const auto& pImage : transientImages) {
+				lazyCount += pImage->GetMemoryType() == ImageMemoryType::LazilyAllocated ? 1 : 0;
+			}
+			cout << "Transient memory : " << renderGraph->GetTransientMemorySize() / 1024 << " KiB allocated, "
+				<< renderGraph->GetTransientRequiredSize() / 1024 << " KiB without aliasing, "
+				<< lazyCount << " / " << transientImages.size() << " images lazily allocated" << endl;
+		}
+
+		CaptureResult capture;
+		for (auto& result : frameCapture->WaitAll()) {
+			if (result.captureId == captureId) {
+				capture = std::move(result);
+			}
+			else if (result.captureId == sideCaptureId) {
+				string sidePath = options.outputPath + ".side.png";
+				if (!WriteCapturePNG(result, sidePath)) {
+					throw std::runtime_error("Failed to write " + sidePath);
+				}
+				cout << "Wrote " << sidePath << endl;
+			}
+		}
+		if (!WriteCapturePNG(capture, options.outputPath)) {
+			throw std::runtime_error("Failed to write " + options.outputPath);
+		}
+		cout << "Wrote " << options.outputPath << endl;
+
+		if (!options.goldenPath.empty()) {
+			if (options.updateGolden) {
+				if (!WriteCapturePNG(capture, options.goldenPath)) {
+					throw std::runtime_error("Failed to write " + options.goldenPath);
+				}
+				cout << "Updated golden " << options.goldenPath << endl;
+			}
+			else if (!CompareWithGolden(capture, options)) {
+				return 1;
+			}
+		}
+	}
+	catch (const std::exception& e) {
+		std::cerr << "Error: " << e.what() << std::endl;
+		return 1;
+	}
+
+	return 0;
+}
\ No newline at end of file
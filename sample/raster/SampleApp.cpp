@@ -3,17 +3,100 @@
 using namespace std;
 using namespace sqrp;
 
+namespace
+{
+	// Copies of the mesh stacked along the view direction and drawn back to front, the worst case of overdraw
+	constexpr int OverdrawLayerCount = 32;
+	constexpr float OverdrawLayerSpacing = 0.2f;
+	constexpr uint32_t FrameTimeSampleCount = 240;
+
+	// True only in the frame the key is pushed
+	bool IsKeyTriggered(int key, bool& isKeyDown)
+	{
+		bool isDown = Input::IsPushKey(key);
+		bool isTriggered = isDown && !isKeyDown;
+		isKeyDown = isDown;
+		return isTriggered;
+	}
+
+	constexpr uint32_t BenchmarkFrameCount = 200;
+
+	// Average CPU time of record + reset per frame in microseconds, nothing is submitted
+	// Each command buffer is reset individually by Begin (pool with eResetCommandBuffer)
+	double MeasureIndividualReset(const Device& device, uint32_t commandBufferCount)
+	{
+		std::vector<CommandBufferHandle> commandBuffers(commandBufferCount);
+		for (auto& commandBuffer : commandBuffers) {
+			commandBuffer = device.CreateCommandBuffer("benchmark");
+		}
+		auto recordFrame = [&]() {
+			for (auto& commandBuffer : commandBuffers) {
+				commandBuffer->Begin(vk::CommandBufferUsageFlagBits::eOneTimeSubmit);
+				commandBuffer->SetViewport(1, 1);
+				commandBuffer->End();
+			}
+		};
+		recordFrame();
+		auto start = chrono::steady_clock::now();
+		for (uint32_t i = 0; i < BenchmarkFrameCount; i++) {
+			recordFrame();
+		}
+		return chrono::duration<double, micro>(chrono::steady_clock::now() - start).count() / BenchmarkFrameCount;
+	}
+
+	// The whole pool is reset once per frame by FrameCommandAllocator
+	double MeasurePoolReset(const Device& device, uint32_t commandBufferCount)
+	{
+		FrameCommandAllocatorHandle commandAllocator = device.CreateFrameCommandAllocator("benchmark", 1);
+		auto recordFrame = [&]() {
+			commandAllocator->BeginFrame(0);
+			for (uint32_t i = 0; i < commandBufferCount; i++) {
+				auto commandBuffer = commandAllocator->Allocate();
+				commandBuffer->Begin(vk::CommandBufferUsageFlagBits::eOneTimeSubmit);
+				commandBuffer->SetViewport(1, 1);
+				commandBuffer->End();
+			}
+		};
+		// The first frame allocates the command buffers
+		recordFrame();
+		auto start = chrono::steady_clock::now();
+		for (uint32_t i = 0; i < BenchmarkFrameCount; i++) {
+			recordFrame();
+		}
+		return chrono::duration<double, micro>(chrono::steady_clock::now() - start).count() / BenchmarkFrameCount;
+	}
+
+	void RunCommandAllocatorBenchmark(const Device& device)
+	{
+		cout << "Command buffer record + reset per frame (" << BenchmarkFrameCount << " frames)" << endl;
+		for (uint32_t commandBufferCount : { 1u, 16u, 256u }) {
+			double individualReset = MeasureIndividualReset(device, commandBufferCount);
+			double poolReset = MeasurePoolReset(device, commandBufferCount);
+			cout << "  " << commandBufferCount << " command buffers : individual reset " << individualReset << " us, pool reset " << poolReset << " us" << endl;
+		}
+	}
+}
+
 SampleApp::SampleApp(std::string appName, unsigned int windowWidth, unsigned int windowHeight)
-	: Application(appName, windowWidth, windowHeight)
+	: Application(appName, windowWidth, windowHeight), compiler_(SHADER_CACHE_DIR)
 {
 
 }
 
 void SampleApp::OnStart()
 {
+	device_.SetPipelineCachePath(PIPELINE_CACHE_PATH);
 	device_.Init(*this);
 
 	swapchain_ = device_.CreateSwapchain(windowWidth_, windowHeight_);
+	frameSubmit_ = device_.CreateSubmitBatch(QueueContextType::General);
+	frameGraph_ = device_.CreateRenderGraph("Frame");
+	parallelRecorder_ = device_.CreateParallelRecorder("scene", swapchain_->GetInflightCount());
+	frameCapture_ = device_.CreateFrameCapture("Frame", swapchain_->GetInflightCount());
+	profiler_ = device_.CreateProfiler("Frame", swapchain_->GetInflightCount());
+	device_.SetProfiler(profiler_);
+	SetProfiler(profiler_.get());
+	pipelineStatistics_ = device_.CreatePipelineStatistics("Frame", swapchain_->GetInflightCount());
 
 	renderPass_ = device_.CreateRenderPass("", swapchain_);
 
@@ -55,6 +138,40 @@ void SampleApp::OnStart()
 
 	frameBuffer_ = device_.CreateFrameBuffer("", renderPass_, swapchain_, depthImages_);
 
+	// Z-prepass : subpass 0 writes depth only, subpass 1 shades the visible fragments with depth compare Equal
+	vk::AttachmentDescription prepassColorDesc = vk::AttachmentDescription{}
+		.setFormat(swapchain_->GetSurfaceFormat())
+		.setSamples(vk::SampleCountFlagBits::e1)
+		.setLoadOp(vk::AttachmentLoadOp::eClear)
+		.setStoreOp(vk::AttachmentStoreOp::eStore)
+		.setStencilLoadOp(vk::AttachmentLoadOp::eDontCare)
+		.setStencilStoreOp(vk::AttachmentStoreOp::eDontCare)
+		.setInitialLayout(vk::ImageLayout::eUndefined)
+		.setFinalLayout(vk::ImageLayout::ePresentSrcKHR);
+	vk::AttachmentDescription prepassDepthDesc = vk::AttachmentDescription{}
+		.setFormat(vk::Format::eD32Sfloat)
+		.setSamples(vk::SampleCountFlagBits::e1)
+		.setLoadOp(vk::AttachmentLoadOp::eClear)
+		.setStoreOp(vk::AttachmentStoreOp::eDontCare)
+		.setStencilLoadOp(vk::AttachmentLoadOp::eDontCare)
+		.setStencilStoreOp(vk::AttachmentStoreOp::eDontCare)
+		.setInitialLayout(vk::ImageLayout::eUndefined)
+		.setFinalLayout(vk::ImageLayout::eDepthStencilAttachmentOptimal);
+	prepassRenderPass_ = device_.CreateRenderPass(
+		"Prepass",
+		{
+		SubPassInfo{ { "depth" } },
+		SubPassInfo{ { "color", "depth" } }
+		},
+		{
+		{ "color", AttachmentInfo{ prepassColorDesc, vk::ImageLayout::eColorAttachmentOptimal } },
+		{ "depth", AttachmentInfo{ prepassDepthDesc, vk::ImageLayout::eDepthStencilAttachmentOptimal } }
+		},
+		// Swapchain image is the first attachment of FrameBuffer
+		{ "color", "depth" }
+	);
+	prepassFrameBuffer_ = device_.CreateFrameBuffer("Prepass", prepassRenderPass_, { depthImages_ }, swapchain_->GetWidth(), swapchain_->GetHeight(), swapchain_->GetInflightCount(), swapchain_);
+
 	mesh_ = device_.CreateMesh(string(MODEL_DIR) + "Suzanne.gltf");
 
 	// Camera
@@ -70,66 +187,265 @@ void SampleApp::OnStart()
 	sphere0_.model = modelMat;
 	sphere0_.invTransModel = XMMatrixTranspose(XMMatrixInverse(nullptr, sphere0_.model));*/
 
-	cameraBuffer_ = device_.CreateBuffer("camera", sizeof(CameraMatrix), vk::BufferUsageFlagBits::eUniformBuffer, VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT, VMA_MEMORY_USAGE_AUTO_PREFER_HOST);
-	cameraBuffer_->Write(CameraMatrix{ camera_.GetView(), camera_.GetProj() });
-	
-	objectBuffer_ = device_.CreateBuffer("object", sizeof(TransformMatrix), vk::BufferUsageFlagBits::eUniformBuffer, VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT, VMA_MEMORY_USAGE_AUTO_PREFER_HOST);
-	objectBuffer_->Write(object_);
+	baseColor_ = glm::vec4(1.0f, 0.0f, 0.0f, 1.0f);
 
-	lightBuffer_ = device_.CreateBuffer("light", sizeof(Light), vk::BufferUsageFlagBits::eUniformBuffer, VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT, VMA_MEMORY_USAGE_AUTO_PREFER_HOST);
-	lightBuffer_->Write(light0_);
-
-	colorBuffer_ = device_.CreateBuffer("color", sizeof(glm::vec4), vk::BufferUsageFlagBits::eUniformBuffer, VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT, VMA_MEMORY_USAGE_AUTO_PREFER_HOST);
-	colorBuffer_->Write(glm::vec4(1.0f, 0.0f, 0.0f, 1.0f));
+	// 4 uniforms per frame, enough for the largest minUniformBufferOffsetAlignment (256)
+	uniformRing_ = device_.CreateRingBuffer("uniform", 4 * 256, swapchain_->GetInflightCount());
 
+	auto uniformBuffer = uniformRing_->GetBuffer();
 	descriptorSet_ = device_.CreateDescriptorSet(
 		"",
 		{
-		{ cameraBuffer_, vk::DescriptorType::eUniformBuffer, vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment },
-		{ objectBuffer_, vk::DescriptorType::eUniformBuffer, vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment },
-		{ lightBuffer_, vk::DescriptorType::eUniformBuffer, vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment },
-		{ colorBuffer_, vk::DescriptorType::eUniformBuffer, vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment }
+		{ uniformBuffer, vk::DescriptorType::eUniformBufferDynamic, vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment, -1, sizeof(CameraMatrix) },
+		{ uniformBuffer, vk::DescriptorType::eUniformBufferDynamic, vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment, -1, sizeof(TransformMatrix) },
+		{ uniformBuffer, vk::DescriptorType::eUniformBufferDynamic, vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment, -1, sizeof(Light) },
+		{ uniformBuffer, vk::DescriptorType::eUniformBufferDynamic, vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment, -1, sizeof(glm::vec4) }
 		}
 	);
 
-	vertShader_ = device_.CreateShader(compiler_, string(SHADER_DIR) + "Lambert.shader", sqrp::ShaderType::Vertex);
-	pixelShader_ = device_.CreateShader(compiler_, string(SHADER_DIR) + "Lambert.shader", sqrp::ShaderType::Pixel);
+	// NOTE : First launch compiles with glslang (cold), following launches load SPIR-V from the cache (warm)
+	auto shaderStart = chrono::high_resolution_clock::now();
+	auto shaders = device_.CreateShaders(
+		compiler_,
+		{
+		{ string(SHADER_DIR) + "Lambert.shader", sqrp::ShaderType::Vertex },
+		{ string(SHADER_DIR) + "Lambert.shader", sqrp::ShaderType::Pixel }
+		}
+	);
+	vertShader_ = shaders[0];
+	pixelShader_ = shaders[1];
+	auto shaderEnd = chrono::high_resolution_clock::now();
+	cout << "CreateShaders : " << chrono::duration<double, milli>(shaderEnd - shaderStart).count() << " ms"
+		<< " (SPIR-V cache hit " << compiler_.GetCacheHitCount() << ", miss " << compiler_.GetCacheMissCount() << ")" << endl;
+
+	vk::PushConstantRange instanceRange = vk::PushConstantRange{}
+		.setStageFlags(vk::ShaderStageFlagBits::eVertex)
+		.setOffset(0)
+		.setSize(sizeof(glm::vec4));
+
+	// NOTE : Pipeline cache is saved when the device is destroyed, so following launches are warm
+	auto pipelineStart = chrono::high_resolution_clock::now();
+	pipeline_ = device_.CreateGraphicsPipeline("Forward", renderPass_, vertShader_, pixelShader_, descriptorSet_, GraphicsPipelineDesc{}, instanceRange);
+	auto pipelineEnd = chrono::high_resolution_clock::now();
+	cout << "CreateGraphicsPipeline : " << chrono::duration<double, milli>(pipelineEnd - pipelineStart).count() << " ms"
+		<< " (pipeline cache " << (device_.IsPipelineCacheWarm() ? "warm" : "cold") << ")" << endl;
+
+	// Not used in the first frames, so it is built in the background
+	wireframePipeline_ = device_.CreateGraphicsPipelineAsync("Wireframe", renderPass_, vertShader_, pixelShader_, descriptorSet_, GraphicsPipelineDesc::Wireframe(), instanceRange);
+
+	// No pixel shader in the depth prepass
+	depthPrepassPipeline_ = device_.CreateGraphicsPipeline("DepthPrepass", prepassRenderPass_, vertShader_, nullptr, descriptorSet_, GraphicsPipelineDesc::DepthOnly(), instanceRange);
+	depthEqualPipeline_ = device_.CreateGraphicsPipeline("DepthEqual", prepassRenderPass_, vertShader_, pixelShader_, descriptorSet_, GraphicsPipelineDesc::DepthEqual(1), instanceRange);
+}
 
-	pipeline_ = device_.CreateGraphicsPipeline("", renderPass_, swapchain_, vertShader_, pixelShader_, descriptorSet_);
+void SampleApp::DrawScene(CommandBufferHandle pCommandBuffer, GraphicsPipelineHandle pPipeline, uint32_t begin, uint32_t end)
+{
+	pCommandBuffer->BindMeshBuffer(mesh_);
+	for (int i = static_cast<int>(begin); i < static_cast<int>(end); i++) {
+		glm::vec4 offset = glm::vec4(0.0f, 0.0f, -OverdrawLayerSpacing * (OverdrawLayerCount - 1 - i), 0.0f);
+		pCommandBuffer->PushConstants(pPipeline, vk::ShaderStageFlagBits::eVertex, sizeof(glm::vec4), &offset);
+		pCommandBuffer->DrawMesh(mesh_, mesh_->GetNumIndices());
+	}
+}
+
+void SampleApp::RecordSubpass(
+	CommandBufferHandle pCommandBuffer,
+	RenderPassHandle pRenderPass,
+	uint32_t subpass,
+	FrameBufferHandle pFrameBuffer,
+	GraphicsPipelineHandle pPipeline,
+	const std::vector<uint32_t>& dynamicOffsets
+)
+{
+	// Secondary command buffers don't inherit any state, so every command buffer sets all of them
+	auto recordRange = [&](CommandBufferHandle pRangeCommandBuffer, uint32_t begin, uint32_t end) {
+		pRangeCommandBuffer->SetViewport(swapchain_->GetWidth(), swapchain_->GetHeight());
+		pRangeCommandBuffer->SetScissor(swapchain_->GetWidth(), swapchain_->GetHeight());
+		pRangeCommandBuffer->BindPipeline(pPipeline, vk::PipelineBindPoint::eGraphics);
+		pRangeCommandBuffer->BindDescriptorSet(pPipeline, descriptorSet_, vk::PipelineBindPoint::eGraphics, dynamicOffsets);
+		DrawScene(pRangeCommandBuffer, pPipeline, begin, end);
+	};
+
+	if (isParallel_) {
+		pCommandBuffer->ExecuteCommands(
+			parallelRecorder_->Record(pRenderPass, subpass, pFrameBuffer, OverdrawLayerCount, recordRange)
+		);
+	}
+	else {
+		recordRange(pCommandBuffer, 0, OverdrawLayerCount);
+	}
 }
 
 void SampleApp::OnUpdate()
 {
 	camera_.Update(windowWidth_, windowHeight_);
-	cameraBuffer_->Write(CameraMatrix{ camera_.GetView(), camera_.GetProj() });
+
+	if (IsKeyTriggered(GLFW_KEY_F, isWireframeKeyDown_)) {
+		isWireframe_ = !isWireframe_;
+	}
+	if (IsKeyTriggered(GLFW_KEY_P, isPrepassKeyDown_)) {
+		isPrepass_ = !isPrepass_;
+		frameTimeSum_ = 0.0;
+		frameTimeCount_ = 0;
+	}
+	if (IsKeyTriggered(GLFW_KEY_M, isParallelKeyDown_)) {
+		isParallel_ = !isParallel_;
+		frameTimeSum_ = 0.0;
+		frameTimeCount_ = 0;
+	}
+	if (IsKeyTriggered(GLFW_KEY_T, isProfilerKeyDown_)) {
+		cout << "Profiler (last " << FrameTimeSampleCount << " frames)" << endl;
+		for (const auto& stat : profiler_->GetStats()) {
+			cout << "  " << (stat.isGpu ? "GPU " : "CPU ") << stat.name << " : min " << stat.minMs << " ms, avg " << stat.avgMs << " ms, p99 " << stat.p99Ms << " ms" << endl;
+		}
+		// Fragment invocations per pixel, 1.0 is no overdraw
+		double pixelCount = static_cast<double>(swapchain_->GetWidth()) * swapchain_->GetHeight();
+		for (const auto& result : pipelineStatistics_->GetResults()) {
+			cout << "  " << result.name << " : vertices " << result.inputAssemblyVertices << ", primitives " << result.inputAssemblyPrimitives
+				<< ", VS " << result.vertexShaderInvocations << ", clipped primitives " << result.clippingPrimitives << "/" << result.clippingInvocations
+				<< ", FS " << result.fragmentShaderInvocations << " (" << result.fragmentShaderInvocations / pixelCount << " per pixel)" << endl;
+		}
+	}
+	if (IsKeyTriggered(GLFW_KEY_V, isMemoryKeyDown_)) {
+		constexpr double MiB = 1024.0 * 1024.0;
+		MemoryStats stats = device_.GetMemoryStats();
+		cout << "Memory" << (stats.isBudgetSupported ? "" : " (estimated budget)") << endl;
+		for (size_t i = 0; i < stats.heaps.size(); i++) {
+			const auto& heap = stats.heaps[i];
+			cout << "  Heap " << i << ((heap.flags & vk::MemoryHeapFlagBits::eDeviceLocal) ? " (device)" : " (host)")
+				<< " : usage " << heap.usage / MiB << " MiB / budget " << heap.budget / MiB << " MiB" << endl;
+		}
+		for (size_t i = 0; i < stats.categoryBytes.size(); i++) {
+			cout << "  " << GetMemoryCategoryName(static_cast<MemoryCategory>(i)) << " : " << stats.categoryBytes[i] / MiB << " MiB, peak " << stats.categoryPeakBytes[i] / MiB << " MiB" << endl;
+		}
+		cout << "  Total : " << stats.totalBytes / MiB << " MiB, peak " << stats.peakBytes / MiB << " MiB, " << stats.allocationCount << " allocations" << endl;
+		ofstream file("memory_stats.json");
+		file << device_.GetMemoryStatsJson(true);
+	}
+	if (IsKeyTriggered(GLFW_KEY_R, isTraceKeyDown_)) {
+		if (TraceRecorder::IsEnabled()) {
+			TraceRecorder::WriteChromeTrace("trace.json");
+			TraceRecorder::SetEnabled(false);
+		}
+		else {
+			cout << "Trace recording started" << endl;
+			TraceRecorder::Clear();
+			TraceRecorder::SetEnabled(true);
+		}
+	}
+	if (IsKeyTriggered(GLFW_KEY_B, isBenchmarkKeyDown_)) {
+		RunCommandAllocatorBenchmark(device_);
+		// The benchmark stalls this frame
+		frameTimeSum_ = 0.0;
+		frameTimeCount_ = 0;
+		prevFrameTime_ = {};
+	}
+
+	// NOTE : Frame time includes CPU recording and waiting for the GPU of the previous frames
+	auto frameTime = chrono::steady_clock::now();
+	if (prevFrameTime_.time_since_epoch().count() != 0) {
+		frameTimeSum_ += chrono::duration<double, milli>(frameTime - prevFrameTime_).count();
+		frameTimeCount_++;
+		if (frameTimeCount_ == FrameTimeSampleCount) {
+			cout << (isPrepass_ ? "Z-prepass" : "Forward") << (isParallel_ ? " (multi-thread)" : "") << " : " << frameTimeSum_ / frameTimeCount_ << " ms/frame"
+				<< " (" << OverdrawLayerCount << " overdraw layers)" << endl;
+			frameTimeSum_ = 0.0;
+			frameTimeCount_ = 0;
+		}
+	}
+	prevFrameTime_ = frameTime;
 
 	swapchain_->WaitFrame();
 
 	auto& commandBuffer = swapchain_->GetCurrentCommandBuffer();
 	uint32_t infligtIndex = swapchain_->GetCurrentInflightIndex();
 
+	// Timestamps of this inflight frame are complete after WaitFrame
+	profiler_->BeginFrame(infligtIndex);
+	pipelineStatistics_->BeginFrame(infligtIndex);
+	commandBuffer->SetProfiler(profiler_);
+	commandBuffer->SetPipelineStatistics(pipelineStatistics_);
+
+	// The region of this inflight frame is no longer read by the GPU after WaitFrame
+	uniformRing_->BeginFrame(infligtIndex);
+	std::vector<uint32_t> dynamicOffsets = {
+		uniformRing_->Push(CameraMatrix{ camera_.GetView(), camera_.GetProj() }),
+		uniformRing_->Push(object_),
+		uniformRing_->Push(light0_),
+		uniformRing_->Push(baseColor_)
+	};
+	uniformRing_->Flush();
+
+	// Secondary command buffers of this inflight frame are no longer used by the GPU either
+	parallelRecorder_->BeginFrame(infligtIndex);
+	vk::SubpassContents subpassContents = isParallel_ ? vk::SubpassContents::eSecondaryCommandBuffers : vk::SubpassContents::eInline;
+
 	commandBuffer->Begin();
 
+	// Both paths present the swapchain image, which the graph doesn't track
+	frameGraph_->Reset();
+	if (isPrepass_ && !isWireframe_) {
+		frameGraph_->AddPass("ZPrepass", [&](CommandBufferHandle pCommandBuffer) {
+			pCommandBuffer->BeginRenderPass(prepassRenderPass_, prepassFrameBuffer_, infligtIndex, subpassContents);
 
-	commandBuffer->BeginRenderPass(renderPass_, frameBuffer_, infligtIndex);
+			// Depth only, no fragment shading
+			RecordSubpass(pCommandBuffer, prepassRenderPass_, 0, prepassFrameBuffer_, depthPrepassPipeline_, dynamicOffsets);
 
-	commandBuffer->SetViewport(swapchain_->GetWidth(), swapchain_->GetHeight());
-	commandBuffer->SetScissor(swapchain_->GetWidth(), swapchain_->GetHeight());
-	commandBuffer->BindPipeline(pipeline_, vk::PipelineBindPoint::eGraphics);
-	commandBuffer->BindDescriptorSet(pipeline_, descriptorSet_, vk::PipelineBindPoint::eGraphics);
-	commandBuffer->BindMeshBuffer(mesh_);
-	commandBuffer->DrawMesh(mesh_, mesh_->GetNumIndices());
+			// Each pixel is shaded once
+			pCommandBuffer->NextSubpass(subpassContents);
+			RecordSubpass(pCommandBuffer, prepassRenderPass_, 1, prepassFrameBuffer_, depthEqualPipeline_, dynamicOffsets);
 
-	commandBuffer->EndRenderPass();
+			pCommandBuffer->EndRenderPass();
+		})
+			.WriteImage(depthImages_[infligtIndex], vk::ImageLayout::eDepthStencilAttachmentOptimal)
+			.SetSideEffect()
+			.SetSecondaryCommandBuffers(isParallel_);
+	}
+	else {
+		frameGraph_->AddPass("Forward", [&](CommandBufferHandle pCommandBuffer) {
+			pCommandBuffer->BeginRenderPass(renderPass_, frameBuffer_, infligtIndex, subpassContents);
+
+			// Falls back to the solid pipeline until the wireframe pipeline is built
+			GraphicsPipelineHandle pipeline = pipeline_;
+			if (isWireframe_ && wireframePipeline_->IsReady()) {
+				pipeline = wireframePipeline_;
+			}
+			RecordSubpass(pCommandBuffer, renderPass_, 0, frameBuffer_, pipeline, dynamicOffsets);
+
+			pCommandBuffer->EndRenderPass();
+		})
+			.WriteImage(depthImages_[infligtIndex], vk::ImageLayout::eDepthStencilAttachmentOptimal)
+			.SetSideEffect()
+			.SetSecondaryCommandBuffers(isParallel_);
+	}
+	frameGraph_->Execute(commandBuffer);
+
+	if (IsKeyTriggered(GLFW_KEY_C, isCaptureKeyDown_)) {
+		frameCapture_->Capture(commandBuffer, swapchain_);
+	}
 
 	commandBuffer->End();
 
-	device_.Submit(
-		QueueContextType::General, commandBuffer, vk::PipelineStageFlagBits::eColorAttachmentOutput,
-		swapchain_->GetImageAcquireSemaphore()->GetSemaphore(), swapchain_->GetRenderCompleteSemaphore()->GetSemaphore(), swapchain_->GetCurrentFence()
+	// The frame timeline value is waited by WaitFrame when this inflight index is reused
+	frameSubmit_->Add(
+		commandBuffer,
+		{ { swapchain_->GetImageAcquireSemaphore()->GetSemaphore(), 0, vk::PipelineStageFlagBits::eColorAttachmentOutput } },
+		{
+			{ swapchain_->GetRenderCompleteSemaphore()->GetSemaphore() },
+			{ swapchain_->GetFrameTimeline()->GetSemaphore(), swapchain_->GetCurrentFrameValue() }
+		}
 	);
+	frameSubmit_->Flush();
 
 	swapchain_->Present();
+
+	// Read back without stalling, captures complete a few frames later
+	for (const auto& capture : frameCapture_->Poll()) {
+		string path = "capture" + to_string(capture.captureId) + ".png";
+		if (WriteCapturePNG(capture, path)) {
+			cout << "Captured " << path << endl;
+		}
+	}
 }
 
 void SampleApp::OnResize(unsigned int width, unsigned int height)
@@ -138,9 +454,17 @@ void SampleApp::OnResize(unsigned int width, unsigned int height)
 	device_.WaitIdle(QueueContextType::General);
 	swapchain_->Recreate(width, height);
 	frameBuffer_->Recreate(width, height);
+	prepassFrameBuffer_->Recreate(width, height);
 }
 
 void SampleApp::OnTerminate()
 {
 	device_.WaitIdle(QueueContextType::General);
+	for (const auto& capture : frameCapture_->WaitAll()) {
+		WriteCapturePNG(capture, "capture" + to_string(capture.captureId) + ".png");
+	}
+	// Query pools of the profiler are destroyed while the device is alive
+	SetProfiler(nullptr);
+	device_.SetProfiler(nullptr);
+	profiler_.reset();
 }
\ No newline at end of file
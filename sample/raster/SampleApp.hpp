@@ -15,6 +15,10 @@ private:
 	sqrp::Device device_;
 	sqrp::Compiler compiler_;
 	sqrp::SwapchainHandle swapchain_;
+	// All submits of a frame are flushed with one vkQueueSubmit2
+	sqrp::SubmitBatchHandle frameSubmit_;
+	// Passes of a frame, rebuilt every frame since the path can be toggled
+	sqrp::RenderGraphHandle frameGraph_;
 	std::vector<sqrp::ImageHandle> depthImages_;
 	sqrp::RenderPassHandle renderPass_;
 	sqrp::FrameBufferHandle	frameBuffer_;
@@ -24,16 +28,69 @@ private:
 	Light light0_;
 	sqrp::TransformMatrix object_;
 
-	sqrp::BufferHandle cameraBuffer_;
-	sqrp::BufferHandle objectBuffer_;
-	sqrp::BufferHandle lightBuffer_;
-	sqrp::BufferHandle colorBuffer_;
+	glm::vec4 baseColor_;
+
+	// Camera, object, light and color of each frame are sub-allocated and bound with dynamic offsets
+	sqrp::RingBufferHandle uniformRing_;
 
 	sqrp::ShaderHandle vertShader_;
 	sqrp::ShaderHandle pixelShader_;
 
 	sqrp::DescriptorSetHandle descriptorSet_;
 	sqrp::GraphicsPipelineHandle pipeline_;
+	// Debug view toggled with F
+	sqrp::GraphicsPipelineHandle wireframePipeline_;
+	bool isWireframe_ = false;
+	bool isWireframeKeyDown_ = false;
+
+	// Z-prepass path toggled with P
+	sqrp::RenderPassHandle prepassRenderPass_;
+	sqrp::FrameBufferHandle prepassFrameBuffer_;
+	sqrp::GraphicsPipelineHandle depthPrepassPipeline_;
+	sqrp::GraphicsPipelineHandle depthEqualPipeline_;
+	bool isPrepass_ = false;
+	bool isPrepassKeyDown_ = false;
+
+	// Draws are recorded into secondary command buffers on worker threads, toggled with M
+	sqrp::ParallelRecorderHandle parallelRecorder_;
+	bool isParallel_ = false;
+	bool isParallelKeyDown_ = false;
+
+	// Command buffer allocator benchmark triggered with B
+	bool isBenchmarkKeyDown_ = false;
+
+	// Swapchain image is captured with C and written to PNG when the frame is complete
+	sqrp::FrameCaptureHandle frameCapture_;
+	bool isCaptureKeyDown_ = false;
+
+	// GPU scopes of the frame graph and CPU scopes of the frame loop, printed with T
+	sqrp::ProfilerHandle profiler_;
+	// Vertex / fragment counts of each pass to quantify the overdraw, printed with T
+	sqrp::PipelineStatisticsHandle pipelineStatistics_;
+	bool isProfilerKeyDown_ = false;
+
+	// Memory usage per heap / category printed with V, VMA stats written to memory_stats.json
+	bool isMemoryKeyDown_ = false;
+
+	// Chrome trace recording started with R and written to trace.json with the next R
+	bool isTraceKeyDown_ = false;
+
+	// Average frame time of the current path
+	std::chrono::steady_clock::time_point prevFrameTime_;
+	double frameTimeSum_ = 0.0;
+	uint32_t frameTimeCount_ = 0;
+
+	// Draws layers [begin, end)
+	void DrawScene(sqrp::CommandBufferHandle pCommandBuffer, sqrp::GraphicsPipelineHandle pPipeline, uint32_t begin, uint32_t end);
+	// Inline or with the parallel recorder, the render pass must be begun with the matching subpass contents
+	void RecordSubpass(
+		sqrp::CommandBufferHandle pCommandBuffer,
+		sqrp::RenderPassHandle pRenderPass,
+		uint32_t subpass,
+		sqrp::FrameBufferHandle pFrameBuffer,
+		sqrp::GraphicsPipelineHandle pPipeline,
+		const std::vector<uint32_t>& dynamicOffsets
+	);
 
 
 public:
@@ -4,6 +4,11 @@
 
 int main()
 {
+	// Set SQRAP_TRACE to include the startup (shader compile, mesh load) in trace.json
+	if (std::getenv("SQRAP_TRACE")) {
+		sqrp::TraceRecorder::SetEnabled(true);
+	}
+
 	SampleApp sampleApp;
 
 	try {
@@ -11,6 +16,9 @@ int main()
 			throw std::runtime_error("Failed to initialize application.");
 		}
 		sampleApp.Run();
+		if (sqrp::TraceRecorder::IsEnabled()) {
+			sqrp::TraceRecorder::WriteChromeTrace("trace.json");
+		}
 	}
 	catch (const std::exception& e) {
 		std::cerr << "Error: " << e.what() << std::endl;
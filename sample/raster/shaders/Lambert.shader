@@ -35,9 +35,18 @@ layout(location = 1) out vec4 fNormal;
 layout(location = 2) out vec4 fTangent;
 layout(location = 3) out vec2 fUV;
 
+// Per draw offset to build the overdraw scene
+layout(push_constant) uniform Instance
+{
+	vec4 offset;
+} instance;
+
+// Depth prepass and shading pass must produce the same depth
+invariant gl_Position;
+
 void main()
 {
-	fWorldPosition = vPosition;
+	fWorldPosition = vPosition + vec4(instance.offset.xyz, 0.0);
 	fNormal = normalize(object.ITModel * vNormal);
 	fTangent = normalize(object.ITModel * vTangent);
 	fUV = vUV;
@@ -1,5 +1,8 @@
 #include "Application.hpp"
 
+#include "Profiler.hpp"
+#include "TraceRecorder.hpp"
+
 using namespace std;
 
 namespace sqrp
@@ -189,6 +192,7 @@ namespace sqrp
 
 	void Application::Run()
 	{
+		TraceRecorder::SetThreadName("Main");
 		while (!glfwWindowShouldClose(pWindow_)) {
 			glfwPollEvents();
 
@@ -196,6 +200,7 @@ namespace sqrp
 			glfwGetCursorPos(pWindow_, &x, &y);
 
 			Input::Update(x, y);
+			CpuProfileScope profileScope(pProfiler_, "Frame");
 			OnUpdate();
 		}
 
@@ -253,4 +258,9 @@ namespace sqrp
 	{
 		windowHeight_ = height;
 	}
+
+	void Application::SetProfiler(Profiler* pProfiler)
+	{
+		pProfiler_ = pProfiler;
+	}
 }
\ No newline at end of file
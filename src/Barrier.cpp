@@ -0,0 +1,261 @@
+#include "Barrier.hpp"
+
+#include "Buffer.hpp"
+#include "Image.hpp"
+
+using namespace std;
+
+namespace sqrp
+{
+	vk::PipelineStageFlags2 GetSupportedStageMask(vk::PipelineStageFlags2 stageMask, vk::QueueFlags queueFlags)
+	{
+		using Stage = vk::PipelineStageFlagBits2;
+		if (!(queueFlags & vk::QueueFlagBits::eGraphics)) {
+			stageMask &= ~(Stage::eVertexInput | Stage::eIndexInput | Stage::eVertexAttributeInput | Stage::eVertexShader
+				| Stage::eTessellationControlShader | Stage::eTessellationEvaluationShader | Stage::eGeometryShader | Stage::ePreRasterizationShaders
+				| Stage::eFragmentShader | Stage::eEarlyFragmentTests | Stage::eLateFragmentTests | Stage::eColorAttachmentOutput | Stage::eAllGraphics);
+			// Indirect commands are also read by vkCmdDispatchIndirect
+			if (!(queueFlags & vk::QueueFlagBits::eCompute)) {
+				stageMask &= ~(Stage::eComputeShader | Stage::eDrawIndirect);
+			}
+		}
+		return stageMask;
+	}
+
+	namespace
+	{
+		// An access is only valid with the stages which perform it
+		void MaskStageAndAccess(vk::PipelineStageFlags2& stageMask, vk::AccessFlags2& accessMask, vk::QueueFlags queueFlags)
+		{
+			stageMask = GetSupportedStageMask(stageMask, queueFlags);
+			if (!stageMask) {
+				accessMask = vk::AccessFlagBits2::eNone;
+			}
+		}
+
+		LayoutSyncInfo GetAllLayoutSyncInfo(vk::ImageLayout layout)
+		{
+			using Stage = vk::PipelineStageFlagBits2;
+			using Access = vk::AccessFlagBits2;
+			switch (layout) {
+			case vk::ImageLayout::eUndefined:
+				// Contents are discarded, nothing to wait for
+				return { Stage::eNone, Access::eNone };
+			case vk::ImageLayout::ePreinitialized:
+				return { Stage::eHost, Access::eHostWrite };
+			case vk::ImageLayout::eColorAttachmentOptimal:
+				return { Stage::eColorAttachmentOutput, Access::eColorAttachmentRead | Access::eColorAttachmentWrite };
+			case vk::ImageLayout::eDepthStencilAttachmentOptimal:
+			case vk::ImageLayout::eDepthAttachmentOptimal:
+			case vk::ImageLayout::eStencilAttachmentOptimal:
+			case vk::ImageLayout::eDepthAttachmentStencilReadOnlyOptimal:
+			case vk::ImageLayout::eDepthReadOnlyStencilAttachmentOptimal:
+				return { Stage::eEarlyFragmentTests | Stage::eLateFragmentTests, Access::eDepthStencilAttachmentRead | Access::eDepthStencilAttachmentWrite };
+			case vk::ImageLayout::eDepthStencilReadOnlyOptimal:
+			case vk::ImageLayout::eDepthReadOnlyOptimal:
+			case vk::ImageLayout::eStencilReadOnlyOptimal:
+				return { Stage::eEarlyFragmentTests | Stage::eLateFragmentTests | Stage::eFragmentShader, Access::eDepthStencilAttachmentRead | Access::eShaderRead };
+			case vk::ImageLayout::eShaderReadOnlyOptimal:
+				return { Stage::eVertexShader | Stage::eFragmentShader | Stage::eComputeShader, Access::eShaderRead };
+			case vk::ImageLayout::eTransferSrcOptimal:
+				return { Stage::eAllTransfer, Access::eTransferRead };
+			case vk::ImageLayout::eTransferDstOptimal:
+				return { Stage::eAllTransfer, Access::eTransferWrite };
+			case vk::ImageLayout::ePresentSrcKHR:
+				// Presentation is synchronized with semaphores, the stage chains with the acquire semaphore wait
+				return { Stage::eColorAttachmentOutput, Access::eNone };
+			default:
+				// eGeneral and unknown layouts may be used by anything
+				return { Stage::eAllCommands, Access::eMemoryRead | Access::eMemoryWrite };
+			}
+		}
+	}
+
+	LayoutSyncInfo GetLayoutSyncInfo(vk::ImageLayout layout, vk::QueueFlags queueFlags)
+	{
+		LayoutSyncInfo info = GetAllLayoutSyncInfo(layout);
+		MaskStageAndAccess(info.stageMask, info.accessMask, queueFlags);
+		return info;
+	}
+
+	BarrierBatcher::BarrierBatcher(vk::QueueFlags queueFlags)
+		: queueFlags_(queueFlags)
+	{
+	}
+
+	void BarrierBatcher::Transition(ImageHandle pImage, vk::ImageLayout oldLayout, vk::ImageLayout newLayout)
+	{
+		if (oldLayout == newLayout) {
+			return;
+		}
+		LayoutSyncInfo src = GetLayoutSyncInfo(oldLayout, queueFlags_);
+		LayoutSyncInfo dst = GetLayoutSyncInfo(newLayout, queueFlags_);
+		AddImageBarrier(
+			vk::ImageMemoryBarrier2()
+			.setSrcStageMask(src.stageMask)
+			.setSrcAccessMask(src.accessMask)
+			.setDstStageMask(dst.stageMask)
+			.setDstAccessMask(dst.accessMask)
+			.setOldLayout(oldLayout)
+			.setNewLayout(newLayout)
+			.setSrcQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+			.setDstQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+			.setImage(pImage->GetImage())
+			.setSubresourceRange(
+				vk::ImageSubresourceRange()
+				.setAspectMask(pImage->GetAspectFlags())
+				.setBaseMipLevel(0)
+				.setLevelCount(pImage->GetMipLevels())
+				.setBaseArrayLayer(0)
+				.setLayerCount(pImage->GetArrayLayers())
+			)
+		);
+		pImage->SetImageLayout(newLayout);
+	}
+
+	void BarrierBatcher::Transition(ImageHandle pImage, vk::ImageLayout newLayout)
+	{
+		Transition(pImage, pImage->GetImageLayout(), newLayout);
+	}
+
+	void BarrierBatcher::Discard(ImageHandle pImage, vk::ImageLayout newLayout)
+	{
+		LayoutSyncInfo src = GetLayoutSyncInfo(pImage->GetImageLayout(), queueFlags_);
+		LayoutSyncInfo dst = GetLayoutSyncInfo(newLayout, queueFlags_);
+		// Only writes have to be made available
+		src.accessMask &= vk::AccessFlagBits2::eShaderWrite | vk::AccessFlagBits2::eColorAttachmentWrite | vk::AccessFlagBits2::eDepthStencilAttachmentWrite
+			| vk::AccessFlagBits2::eTransferWrite | vk::AccessFlagBits2::eHostWrite | vk::AccessFlagBits2::eMemoryWrite;
+		AddImageBarrier(
+			vk::ImageMemoryBarrier2()
+			.setSrcStageMask(src.stageMask)
+			.setSrcAccessMask(src.accessMask)
+			.setDstStageMask(dst.stageMask)
+			.setDstAccessMask(dst.accessMask)
+			.setOldLayout(vk::ImageLayout::eUndefined)
+			.setNewLayout(newLayout)
+			.setSrcQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+			.setDstQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+			.setImage(pImage->GetImage())
+			.setSubresourceRange(
+				vk::ImageSubresourceRange()
+				.setAspectMask(pImage->GetAspectFlags())
+				.setBaseMipLevel(0)
+				.setLevelCount(pImage->GetMipLevels())
+				.setBaseArrayLayer(0)
+				.setLayerCount(pImage->GetArrayLayers())
+			)
+		);
+		pImage->SetImageLayout(newLayout);
+	}
+
+	void BarrierBatcher::AddImageBarrier(const vk::ImageMemoryBarrier2& imageBarrier)
+	{
+		vk::ImageMemoryBarrier2 barrier = imageBarrier;
+		MaskStageAndAccess(barrier.srcStageMask, barrier.srcAccessMask, queueFlags_);
+		MaskStageAndAccess(barrier.dstStageMask, barrier.dstAccessMask, queueFlags_);
+		for (auto& pendingBarrier : imageBarriers_) {
+			bool isSameRange = pendingBarrier.image == barrier.image
+				&& pendingBarrier.subresourceRange == barrier.subresourceRange
+				&& pendingBarrier.newLayout == barrier.oldLayout
+				&& pendingBarrier.srcQueueFamilyIndex == barrier.srcQueueFamilyIndex
+				&& pendingBarrier.dstQueueFamilyIndex == barrier.dstQueueFamilyIndex;
+			if (isSameRange) {
+				// A -> B and B -> C become A -> C
+				pendingBarrier.setNewLayout(barrier.newLayout);
+				pendingBarrier.setDstStageMask(barrier.dstStageMask);
+				pendingBarrier.setDstAccessMask(barrier.dstAccessMask);
+				return;
+			}
+		}
+		imageBarriers_.push_back(barrier);
+	}
+
+	void BarrierBatcher::AddBufferBarrier(
+		BufferHandle pBuffer,
+		vk::PipelineStageFlags2 srcStageMask, vk::AccessFlags2 srcAccessMask,
+		vk::PipelineStageFlags2 dstStageMask, vk::AccessFlags2 dstAccessMask,
+		vk::DeviceSize offset, vk::DeviceSize size
+	)
+	{
+		AddBufferBarrier(
+			vk::BufferMemoryBarrier2()
+			.setSrcStageMask(srcStageMask)
+			.setSrcAccessMask(srcAccessMask)
+			.setDstStageMask(dstStageMask)
+			.setDstAccessMask(dstAccessMask)
+			.setSrcQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+			.setDstQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+			.setBuffer(pBuffer->GetBuffer())
+			.setOffset(offset)
+			.setSize(size)
+		);
+	}
+
+	void BarrierBatcher::AddBufferBarrier(const vk::BufferMemoryBarrier2& bufferBarrier)
+	{
+		vk::BufferMemoryBarrier2 barrier = bufferBarrier;
+		MaskStageAndAccess(barrier.srcStageMask, barrier.srcAccessMask, queueFlags_);
+		MaskStageAndAccess(barrier.dstStageMask, barrier.dstAccessMask, queueFlags_);
+		for (auto& pendingBarrier : bufferBarriers_) {
+			bool isSameRange = pendingBarrier.buffer == barrier.buffer
+				&& pendingBarrier.offset == barrier.offset
+				&& pendingBarrier.size == barrier.size
+				&& pendingBarrier.srcQueueFamilyIndex == barrier.srcQueueFamilyIndex
+				&& pendingBarrier.dstQueueFamilyIndex == barrier.dstQueueFamilyIndex;
+			if (isSameRange) {
+				pendingBarrier.setSrcStageMask(pendingBarrier.srcStageMask | barrier.srcStageMask);
+				pendingBarrier.setSrcAccessMask(pendingBarrier.srcAccessMask | barrier.srcAccessMask);
+				pendingBarrier.setDstStageMask(pendingBarrier.dstStageMask | barrier.dstStageMask);
+				pendingBarrier.setDstAccessMask(pendingBarrier.dstAccessMask | barrier.dstAccessMask);
+				return;
+			}
+		}
+		bufferBarriers_.push_back(barrier);
+	}
+
+	void BarrierBatcher::AddMemoryBarrier(
+		vk::PipelineStageFlags2 srcStageMask, vk::AccessFlags2 srcAccessMask,
+		vk::PipelineStageFlags2 dstStageMask, vk::AccessFlags2 dstAccessMask
+	)
+	{
+		MaskStageAndAccess(srcStageMask, srcAccessMask, queueFlags_);
+		MaskStageAndAccess(dstStageMask, dstAccessMask, queueFlags_);
+		// Global barriers are merged into one
+		if (!memoryBarriers_.empty()) {
+			auto& pendingBarrier = memoryBarriers_.front();
+			pendingBarrier.setSrcStageMask(pendingBarrier.srcStageMask | srcStageMask);
+			pendingBarrier.setSrcAccessMask(pendingBarrier.srcAccessMask | srcAccessMask);
+			pendingBarrier.setDstStageMask(pendingBarrier.dstStageMask | dstStageMask);
+			pendingBarrier.setDstAccessMask(pendingBarrier.dstAccessMask | dstAccessMask);
+			return;
+		}
+		memoryBarriers_.push_back(
+			vk::MemoryBarrier2()
+			.setSrcStageMask(srcStageMask)
+			.setSrcAccessMask(srcAccessMask)
+			.setDstStageMask(dstStageMask)
+			.setDstAccessMask(dstAccessMask)
+		);
+	}
+
+	void BarrierBatcher::Flush(vk::CommandBuffer commandBuffer)
+	{
+		if (IsEmpty()) {
+			return;
+		}
+		commandBuffer.pipelineBarrier2(
+			vk::DependencyInfo()
+			.setMemoryBarriers(memoryBarriers_)
+			.setBufferMemoryBarriers(bufferBarriers_)
+			.setImageMemoryBarriers(imageBarriers_)
+		);
+		memoryBarriers_.clear();
+		bufferBarriers_.clear();
+		imageBarriers_.clear();
+	}
+
+	bool BarrierBatcher::IsEmpty() const
+	{
+		return memoryBarriers_.empty() && bufferBarriers_.empty() && imageBarriers_.empty();
+	}
+}
\ No newline at end of file
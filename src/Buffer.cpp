@@ -4,6 +4,25 @@
 
 using namespace std;
 
+namespace
+{
+	sqrp::MemoryCategory GetBufferMemoryCategory(vk::BufferUsageFlags usage, VmaAllocationCreateFlags allocationFlags)
+	{
+		if (usage & (vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eIndexBuffer)) {
+			return sqrp::MemoryCategory::Mesh;
+		}
+		if (usage & vk::BufferUsageFlagBits::eUniformBuffer) {
+			return sqrp::MemoryCategory::Uniform;
+		}
+		// Host visible source of copies
+		bool isHostAccess = (allocationFlags & (VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT)) != 0;
+		if (isHostAccess && (usage & vk::BufferUsageFlagBits::eTransferSrc)) {
+			return sqrp::MemoryCategory::Staging;
+		}
+		return sqrp::MemoryCategory::Other;
+	}
+}
+
 namespace sqrp
 {
 	Buffer::Buffer(const Device& device, std::string name, int size, vk::BufferUsageFlags usage, VmaAllocationCreateFlags allocationFlags, VmaMemoryUsage memoryUsage)
@@ -25,16 +44,29 @@ namespace sqrp
 			throw std::runtime_error("Failed to create buffer!");
 		}
 		buffer_ = vk::Buffer(buffer);
+
+		VkMemoryPropertyFlags memoryProperties = 0;
+		vmaGetAllocationMemoryProperties(pDevice_->GetAllocator(), allocation_, &memoryProperties);
+		isHostCoherent_ = (memoryProperties & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+
+		memoryCategory_ = GetBufferMemoryCategory(usage_, allocationFlags_);
+		pDevice_->TrackAllocation(memoryCategory_, allocationInfo_.size);
+		vmaSetAllocationName(pDevice_->GetAllocator(), allocation_, (name + "_Buffer").c_str());
+
 		pDevice_->SetObjectName(reinterpret_cast<uint64_t>(static_cast<VkBuffer>(buffer_)), vk::ObjectType::eBuffer, name + "_Buffer");
 	}
 
 	Buffer::~Buffer()
 	{
+		pDevice_->UntrackAllocation(memoryCategory_, allocationInfo_.size);
 		vmaDestroyBuffer(pDevice_->GetAllocator(), buffer_, allocation_);
 	}
 
 	void* Buffer::Map()
 	{
+		if (IsPersistentlyMapped()) {
+			return allocationInfo_.pMappedData;
+		}
 		void* data = nullptr;
 		if (vmaMapMemory(pDevice_->GetAllocator(), allocation_, &data) != VK_SUCCESS) {
 			return nullptr;
@@ -44,24 +76,91 @@ namespace sqrp
 
 	void Buffer::Unmap()
 	{
+		if (IsPersistentlyMapped()) {
+			return;
+		}
 		vmaUnmapMemory(pDevice_->GetAllocator(), allocation_);
 	}
 
 	void Buffer::Write(const void* src, size_t size)
 	{
-		void* rawPtr = Map();
-		std::memcpy(rawPtr, src, size);
+		Write(0, src, size);
+	}
+
+	void Buffer::Write(vk::DeviceSize offset, const void* src, size_t size)
+	{
+		if (offset + size > size_) {
+			throw std::runtime_error("Buffer write is out of range");
+		}
+		uint8_t* rawPtr = static_cast<uint8_t*>(Map());
+		if (!rawPtr) {
+			throw std::runtime_error("Failed to map buffer");
+		}
+		std::memcpy(rawPtr + offset, src, size);
+		if (!isHostCoherent_) {
+			Flush(offset, size);
+		}
 		Unmap();
 	}
 
+	void Buffer::Read(vk::DeviceSize offset, void* dst, size_t size)
+	{
+		if (offset + size > size_) {
+			throw std::runtime_error("Buffer read is out of range");
+		}
+		uint8_t* rawPtr = static_cast<uint8_t*>(Map());
+		if (!rawPtr) {
+			throw std::runtime_error("Failed to map buffer");
+		}
+		if (!isHostCoherent_) {
+			Invalidate(offset, size);
+		}
+		std::memcpy(dst, rawPtr + offset, size);
+		Unmap();
+	}
+
+	void Buffer::Flush(vk::DeviceSize offset, vk::DeviceSize size)
+	{
+		if (vmaFlushAllocation(pDevice_->GetAllocator(), allocation_, offset, size) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to flush buffer");
+		}
+	}
+
+	void Buffer::Invalidate(vk::DeviceSize offset, vk::DeviceSize size)
+	{
+		if (vmaInvalidateAllocation(pDevice_->GetAllocator(), allocation_, offset, size) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to invalidate buffer");
+		}
+	}
+
 	vk::Buffer Buffer::GetBuffer() const
 	{
 		return buffer_;
 	}
 
+	void* Buffer::GetMappedData() const
+	{
+		return allocationInfo_.pMappedData;
+	}
+
+	bool Buffer::IsPersistentlyMapped() const
+	{
+		return allocationInfo_.pMappedData != nullptr;
+	}
+
+	bool Buffer::IsHostCoherent() const
+	{
+		return isHostCoherent_;
+	}
+
 	vk::DeviceSize Buffer::GetSize() const
 	{
 		return size_;
 	}
 
+	MemoryCategory Buffer::GetMemoryCategory() const
+	{
+		return memoryCategory_;
+	}
+
 }
\ No newline at end of file
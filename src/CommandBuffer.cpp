@@ -7,6 +7,8 @@
 #include "Image.hpp"
 #include "Mesh.hpp"
 #include "Pipeline.hpp"
+#include "PipelineStatistics.hpp"
+#include "Profiler.hpp"
 #include "RenderPass.hpp"
 #include "Swapchain.hpp"
 
@@ -22,6 +24,8 @@ namespace sqrp
 			throw std::runtime_error("No such queue context type");
 		}
 		const auto& context = it->second;
+		queueFlags_ = context.queueFlags;
+		barrierBatcher_.SetQueueFlags(queueFlags_);
 		commandBuffer_ = std::move(pDevice_->GetDevice().allocateCommandBuffersUnique(
 			vk::CommandBufferAllocateInfo()
 			.setCommandPool(context.commandPool.get())
@@ -35,6 +39,28 @@ namespace sqrp
 		);
 	}
 
+	CommandBuffer::CommandBuffer(const Device& device, std::string name, vk::CommandPool commandPool, vk::CommandBufferLevel level, QueueContextType queueType)
+		: pDevice_(&device), queueType_(queueType), level_(level)
+	{
+		auto it = pDevice_->GetQueueContexts().find(queueType_);
+		if (it == pDevice_->GetQueueContexts().end()) {
+			throw std::runtime_error("No such queue context type");
+		}
+		queueFlags_ = it->second.queueFlags;
+		barrierBatcher_.SetQueueFlags(queueFlags_);
+		commandBuffer_ = std::move(pDevice_->GetDevice().allocateCommandBuffersUnique(
+			vk::CommandBufferAllocateInfo()
+			.setCommandPool(commandPool)
+			.setCommandBufferCount(1)
+			.setLevel(level_)
+		).front());
+		pDevice_->SetObjectName(
+			(uint64_t)(VkCommandBuffer)(commandBuffer_.get()),
+			vk::ObjectType::eCommandBuffer,
+			name + "_CommandBuffer"
+		);
+	}
+
 	void CommandBuffer::Begin()
 	{
 		commandBuffer_->begin(
@@ -50,8 +76,30 @@ namespace sqrp
 		);
 	}
 
+	void CommandBuffer::BeginSecondary(RenderPassHandle pRenderPass, uint32_t subpass, FrameBufferHandle pFrameBuffer, uint32_t inflightIndex)
+	{
+		if (level_ != vk::CommandBufferLevel::eSecondary) {
+			throw std::runtime_error("BeginSecondary requires a secondary command buffer");
+		}
+		// The framebuffer is optional but lets the driver optimize for it
+		auto inheritanceInfo = vk::CommandBufferInheritanceInfo()
+			.setRenderPass(pRenderPass->GetRenderPass())
+			.setSubpass(subpass)
+			.setFramebuffer(pFrameBuffer ? pFrameBuffer->GetFrameBuffer(inflightIndex) : nullptr);
+		// Required to be executed while a pipeline statistics query is active in the primary
+		if (pDevice_->GetEnabledFeatures().pipelineStatisticsQuery && pDevice_->GetEnabledFeatures().inheritedQueries) {
+			inheritanceInfo.setPipelineStatistics(PipelineStatistics::QueryFlags);
+		}
+		commandBuffer_->begin(
+			vk::CommandBufferBeginInfo()
+			.setFlags(vk::CommandBufferUsageFlagBits::eOneTimeSubmit | vk::CommandBufferUsageFlagBits::eRenderPassContinue)
+			.setPInheritanceInfo(&inheritanceInfo)
+		);
+	}
+
 	void CommandBuffer::End()
 	{
+		FlushBarriers();
 		commandBuffer_->end();
 	}
 
@@ -65,7 +113,7 @@ namespace sqrp
 
 	}
 
-	void CommandBuffer::BeginRenderPass(RenderPassHandle pRenderPass, FrameBufferHandle pFrameBuffer, uint32_t inflightIndex)
+	void CommandBuffer::BeginRenderPass(RenderPassHandle pRenderPass, FrameBufferHandle pFrameBuffer, uint32_t inflightIndex, vk::SubpassContents contents)
 	{
 		vk::RenderPassBeginInfo renderPassInfo{};
 		renderPassInfo.renderPass = pRenderPass->GetRenderPass();
@@ -87,11 +135,93 @@ namespace sqrp
 		renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
 		renderPassInfo.pClearValues = clearValues.data();
 
-		commandBuffer_->beginRenderPass(renderPassInfo, vk::SubpassContents::eInline);
+		FlushBarriers();
+		BeginProfileScope("RenderPass");
+		commandBuffer_->beginRenderPass(renderPassInfo, contents);
+	}
+
+	void CommandBuffer::NextSubpass(vk::SubpassContents contents)
+	{
+		commandBuffer_->nextSubpass(contents);
 	}
 
 	void CommandBuffer::EndRenderPass() {
 		commandBuffer_->endRenderPass();
+		EndProfileScope();
+	}
+
+	void CommandBuffer::BeginRendering(const std::vector<RenderingAttachment>& colorAttachments, const std::optional<RenderingAttachment>& depthAttachment, vk::RenderingFlags flags)
+	{
+		ImageHandle pFirstImage = !colorAttachments.empty() ? colorAttachments.front().pImage : (depthAttachment ? depthAttachment->pImage : nullptr);
+		if (!pFirstImage) {
+			throw std::runtime_error("BeginRendering requires at least one attachment");
+		}
+
+		auto toAttachmentInfo = [this](const RenderingAttachment& attachment, vk::ImageLayout layout, vk::ResolveModeFlagBits resolveMode) {
+			// Cleared contents don't need the previous layout
+			if (attachment.loadOp == vk::AttachmentLoadOp::eLoad) {
+				barrierBatcher_.Transition(attachment.pImage, layout);
+			}
+			else {
+				barrierBatcher_.Discard(attachment.pImage, layout);
+			}
+			auto attachmentInfo = vk::RenderingAttachmentInfo()
+				.setImageView(attachment.pImage->GetImageView())
+				.setImageLayout(layout)
+				.setLoadOp(attachment.loadOp)
+				.setStoreOp(attachment.storeOp)
+				.setClearValue(attachment.clearValue);
+			if (attachment.pResolveImage) {
+				barrierBatcher_.Discard(attachment.pResolveImage, layout);
+				attachmentInfo
+					.setResolveMode(resolveMode)
+					.setResolveImageView(attachment.pResolveImage->GetImageView())
+					.setResolveImageLayout(layout);
+			}
+			return attachmentInfo;
+		};
+
+		std::vector<vk::RenderingAttachmentInfo> colorAttachmentInfos;
+		colorAttachmentInfos.reserve(colorAttachments.size());
+		for (const auto& colorAttachment : colorAttachments) {
+			colorAttachmentInfos.push_back(toAttachmentInfo(colorAttachment, vk::ImageLayout::eColorAttachmentOptimal, vk::ResolveModeFlagBits::eAverage));
+		}
+
+		vk::Extent3D extent = pFirstImage->GetExtent3D();
+		vk::RenderingInfo renderingInfo{};
+		renderingInfo
+			.setFlags(flags)
+			.setRenderArea(vk::Rect2D{ { 0, 0 }, { extent.width, extent.height } })
+			.setLayerCount(1)
+			.setColorAttachments(colorAttachmentInfos);
+
+		vk::RenderingAttachmentInfo depthAttachmentInfo{};
+		if (depthAttachment) {
+			depthAttachmentInfo = toAttachmentInfo(*depthAttachment, vk::ImageLayout::eDepthStencilAttachmentOptimal, vk::ResolveModeFlagBits::eSampleZero);
+			if (depthAttachment->pImage->GetAspectFlags() & vk::ImageAspectFlagBits::eDepth) {
+				renderingInfo.setPDepthAttachment(&depthAttachmentInfo);
+			}
+			if (depthAttachment->pImage->GetAspectFlags() & vk::ImageAspectFlagBits::eStencil) {
+				renderingInfo.setPStencilAttachment(&depthAttachmentInfo);
+			}
+		}
+
+		FlushBarriers();
+		BeginProfileScope("Rendering");
+		commandBuffer_->beginRendering(renderingInfo);
+	}
+
+	void CommandBuffer::BeginRendering(const vk::RenderingInfo& renderingInfo)
+	{
+		FlushBarriers();
+		BeginProfileScope("Rendering");
+		commandBuffer_->beginRendering(renderingInfo);
+	}
+
+	void CommandBuffer::EndRendering()
+	{
+		commandBuffer_->endRendering();
+		EndProfileScope();
 	}
 
 	void CommandBuffer::BindPipeline(PipelineHandle pPipeline, vk::PipelineBindPoint pipelineBindPoint)
@@ -99,6 +229,15 @@ namespace sqrp
 		commandBuffer_->bindPipeline(pipelineBindPoint, pPipeline->GetPipeline());
 	}
 
+	bool CommandBuffer::TryBindPipeline(PipelineHandle pPipeline, vk::PipelineBindPoint pipelineBindPoint)
+	{
+		if (!pPipeline->IsReady()) {
+			return false;
+		}
+		commandBuffer_->bindPipeline(pipelineBindPoint, pPipeline->GetPipeline());
+		return true;
+	}
+
 	void CommandBuffer::BindMeshBuffer(MeshBaseHandle pMesh)
 	{
 		commandBuffer_->bindVertexBuffers(0, pMesh->GetVertexBuffer()->GetBuffer(), { 0 });
@@ -122,6 +261,17 @@ namespace sqrp
 		);
 	}
 
+	void CommandBuffer::BindDescriptorSet(PipelineHandle pPipeline, DescriptorSetHandle pDescriptorSet, vk::PipelineBindPoint pipelineBindPoint, const std::vector<uint32_t>& dynamicOffsets)
+	{
+		commandBuffer_->bindDescriptorSets(
+			pipelineBindPoint,
+			pPipeline->GetPipelineLayout(),
+			0,
+			pDescriptorSet->GetDescriptorSet(),
+			dynamicOffsets
+		);
+	}
+
 	void CommandBuffer::PushConstants(PipelineHandle pPipeline, vk::ShaderStageFlags stageFlags, uint32_t size, const void* pValues)
 	{
 		commandBuffer_->pushConstants(
@@ -135,15 +285,20 @@ namespace sqrp
 
 	void CommandBuffer::CopyBuffer(BufferHandle srcBuffer, BufferHandle dstBuffer)
 	{
+		FlushBarriers();
+		BeginProfileScope("Copy");
 		commandBuffer_->copyBuffer(
 			srcBuffer->GetBuffer(), dstBuffer->GetBuffer(),
 			vk::BufferCopy()
 			.setSize(min(srcBuffer->GetSize(), dstBuffer->GetSize()))
 		);
+		EndProfileScope();
 	}
 
 	void CommandBuffer::CopyBufferRegion(BufferHandle srcBuffer, vk::DeviceSize srcOffset, BufferHandle dstBuffer, vk::DeviceSize dstOffset, vk::DeviceSize size)
 	{
+		FlushBarriers();
+		BeginProfileScope("Copy");
 		commandBuffer_->copyBuffer(
 			srcBuffer->GetBuffer(), dstBuffer->GetBuffer(),
 			vk::BufferCopy()
@@ -151,12 +306,13 @@ namespace sqrp
 				.setDstOffset(dstOffset)
 				.setSize(size)
 		);
+		EndProfileScope();
 	}
 
-	void CommandBuffer::CopyBufferToImage(BufferHandle srcBuffer, ImageHandle dstImage)
+	void CommandBuffer::CopyBufferToImage(BufferHandle srcBuffer, ImageHandle dstImage, vk::DeviceSize srcOffset)
 	{
 		vk::BufferImageCopy region{};
-		region.setBufferOffset(0);
+		region.setBufferOffset(srcOffset);
 		region.setBufferRowLength(0);
 		region.setBufferImageHeight(0);
 
@@ -171,12 +327,44 @@ namespace sqrp
 		region.setImageOffset(vk::Offset3D{ 0, 0, 0 });
 		region.setImageExtent(dstImage->GetExtent3D());
 
+		FlushBarriers();
+		BeginProfileScope("Copy");
 		commandBuffer_->copyBufferToImage(
 			srcBuffer->GetBuffer(),
 			dstImage->GetImage(),
 			vk::ImageLayout::eTransferDstOptimal,
 			{ region }
 		);
+		EndProfileScope();
+	}
+
+	void CommandBuffer::CopyImageToBuffer(ImageHandle srcImage, BufferHandle dstBuffer, vk::DeviceSize dstOffset)
+	{
+		vk::BufferImageCopy region{};
+		region.setBufferOffset(dstOffset);
+		region.setBufferRowLength(0);
+		region.setBufferImageHeight(0);
+
+		region.setImageSubresource(
+			vk::ImageSubresourceLayers()
+			.setAspectMask(srcImage->GetAspectFlags())
+			.setMipLevel(0)
+			.setBaseArrayLayer(0)
+			.setLayerCount(1)
+		);
+
+		region.setImageOffset(vk::Offset3D{ 0, 0, 0 });
+		region.setImageExtent(srcImage->GetExtent3D());
+
+		FlushBarriers();
+		BeginProfileScope("Copy");
+		commandBuffer_->copyImageToBuffer(
+			srcImage->GetImage(),
+			vk::ImageLayout::eTransferSrcOptimal,
+			dstBuffer->GetBuffer(),
+			{ region }
+		);
+		EndProfileScope();
 	}
 
 	void CommandBuffer::SetScissor(uint32_t width, uint32_t height)
@@ -191,54 +379,39 @@ namespace sqrp
 
 	void CommandBuffer::TransitionLayout(ImageHandle pImage, vk::ImageLayout oldLayout, vk::ImageLayout newLayout)
 	{
-		if (oldLayout == newLayout) return;
-		vk::ImageMemoryBarrier barrier{};
-		barrier.oldLayout = oldLayout;
-		barrier.newLayout = newLayout;
-		barrier.srcQueueFamilyIndex = vk::QueueFamilyIgnored;
-		barrier.dstQueueFamilyIndex = vk::QueueFamilyIgnored;
-		barrier.image = pImage->GetImage();
-		barrier.subresourceRange = {
-			pImage->GetAspectFlags(),
-			0, pImage->GetMipLevels(),  // mipLevels
-			0, pImage->GetArrayLayers()   // arrayLayers
-		};
-		commandBuffer_->pipelineBarrier(
-			vk::PipelineStageFlagBits::eAllCommands, vk::PipelineStageFlagBits::eAllCommands,
-			{},
-			{},
-			{},
-			{ barrier }
-		);
-		pImage->SetImageLayout(newLayout);
+		barrierBatcher_.Transition(pImage, oldLayout, newLayout);
+	}
+
+	void CommandBuffer::TransitionLayout(ImageHandle pImage, vk::ImageLayout newLayout)
+	{
+		barrierBatcher_.Transition(pImage, newLayout);
 	}
 
 	void CommandBuffer::TransitionLayout(vk::Image image, vk::ImageLayout oldLayout, vk::ImageLayout newLayout)
 	{
-		vk::ImageMemoryBarrier barrier{};
-		barrier.setOldLayout(oldLayout);
-		barrier.setNewLayout(newLayout);
-		barrier.setSrcQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED);
-		barrier.setDstQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED);
-		barrier.setImage(image);
-		barrier.setSubresourceRange(
-			vk::ImageSubresourceRange()
-			.setAspectMask(vk::ImageAspectFlagBits::eColor)
-			.setBaseMipLevel(0)
-			.setLevelCount(1)
-			.setBaseArrayLayer(0)
-			.setLayerCount(1)
-		);
-		barrier.setSrcAccessMask(vk::AccessFlagBits::eNone);
-		barrier.setDstAccessMask(vk::AccessFlagBits::eColorAttachmentWrite);
-
-		commandBuffer_->pipelineBarrier(
-			vk::PipelineStageFlagBits::eBottomOfPipe,
-			vk::PipelineStageFlagBits::eColorAttachmentOutput,
-			{},
-			{},
-			{},
-			{ barrier }
+		if (oldLayout == newLayout) return;
+		LayoutSyncInfo src = GetLayoutSyncInfo(oldLayout, queueFlags_);
+		LayoutSyncInfo dst = GetLayoutSyncInfo(newLayout, queueFlags_);
+		// NOTE : Used for swapchain images, the transition must wait for the acquire semaphore at eColorAttachmentOutput
+		barrierBatcher_.AddImageBarrier(
+			vk::ImageMemoryBarrier2()
+			.setSrcStageMask(src.stageMask | vk::PipelineStageFlagBits2::eColorAttachmentOutput)
+			.setSrcAccessMask(src.accessMask)
+			.setDstStageMask(dst.stageMask)
+			.setDstAccessMask(dst.accessMask)
+			.setOldLayout(oldLayout)
+			.setNewLayout(newLayout)
+			.setSrcQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+			.setDstQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+			.setImage(image)
+			.setSubresourceRange(
+				vk::ImageSubresourceRange()
+				.setAspectMask(vk::ImageAspectFlagBits::eColor)
+				.setBaseMipLevel(0)
+				.setLevelCount(1)
+				.setBaseArrayLayer(0)
+				.setLayerCount(1)
+			)
 		);
 	}
 
@@ -252,54 +425,150 @@ namespace sqrp
 		vk::AccessFlags dstAccessMask
 	)
 	{
-		vk::ImageMemoryBarrier barrier{};
-		barrier.setOldLayout(oldLayout);
-		barrier.setNewLayout(newLayout);
-		barrier.setSrcQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED);
-		barrier.setDstQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED);
-		barrier.setImage(pImage->GetImage());
-		barrier.setSubresourceRange(
-			vk::ImageSubresourceRange()
-			.setAspectMask(pImage->GetAspectFlags())
-			.setBaseMipLevel(0)
-			.setLevelCount(pImage->GetMipLevels())
-			.setBaseArrayLayer(0)
-			.setLayerCount(pImage->GetArrayLayers())
-		);
-		barrier.setSrcAccessMask(srcAccessMask);
-		barrier.setDstAccessMask(dstAccessMask);
-		commandBuffer_->pipelineBarrier(
-			srcStageMask, dstStageMask,
-			{},
-			{},
-			{},
-			{ barrier }
+		barrierBatcher_.AddImageBarrier(
+			vk::ImageMemoryBarrier2()
+			.setSrcStageMask(ToPipelineStageFlags2(srcStageMask))
+			.setSrcAccessMask(ToAccessFlags2(srcAccessMask))
+			.setDstStageMask(ToPipelineStageFlags2(dstStageMask))
+			.setDstAccessMask(ToAccessFlags2(dstAccessMask))
+			.setOldLayout(oldLayout)
+			.setNewLayout(newLayout)
+			.setSrcQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+			.setDstQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+			.setImage(pImage->GetImage())
+			.setSubresourceRange(
+				vk::ImageSubresourceRange()
+				.setAspectMask(pImage->GetAspectFlags())
+				.setBaseMipLevel(0)
+				.setLevelCount(pImage->GetMipLevels())
+				.setBaseArrayLayer(0)
+				.setLayerCount(pImage->GetArrayLayers())
+			)
 		);
 	}
 
+	void CommandBuffer::BufferBarrier(
+		BufferHandle pBuffer,
+		vk::PipelineStageFlags2 srcStageMask, vk::AccessFlags2 srcAccessMask,
+		vk::PipelineStageFlags2 dstStageMask, vk::AccessFlags2 dstAccessMask,
+		vk::DeviceSize offset, vk::DeviceSize size
+	)
+	{
+		barrierBatcher_.AddBufferBarrier(pBuffer, srcStageMask, srcAccessMask, dstStageMask, dstAccessMask, offset, size);
+	}
+
+	void CommandBuffer::GlobalBarrier(
+		vk::PipelineStageFlags2 srcStageMask, vk::AccessFlags2 srcAccessMask,
+		vk::PipelineStageFlags2 dstStageMask, vk::AccessFlags2 dstAccessMask
+	)
+	{
+		barrierBatcher_.AddMemoryBarrier(srcStageMask, srcAccessMask, dstStageMask, dstAccessMask);
+	}
+
+	void CommandBuffer::FlushBarriers()
+	{
+		barrierBatcher_.Flush(commandBuffer_.get());
+	}
+
+	void CommandBuffer::SetProfiler(ProfilerHandle pProfiler)
+	{
+		pProfiler_ = pProfiler;
+	}
+
+	void CommandBuffer::BeginProfileScope(const std::string& name)
+	{
+		if (!pProfiler_) {
+			return;
+		}
+		profileScopes_.push_back(pProfiler_->BeginGpuScope(commandBuffer_.get(), queueType_, name));
+	}
+
+	void CommandBuffer::EndProfileScope()
+	{
+		if (!pProfiler_ || profileScopes_.empty()) {
+			return;
+		}
+		pProfiler_->EndGpuScope(commandBuffer_.get(), profileScopes_.back());
+		profileScopes_.pop_back();
+	}
+
+	void CommandBuffer::SetPipelineStatistics(PipelineStatisticsHandle pPipelineStatistics)
+	{
+		pPipelineStatistics_ = pPipelineStatistics;
+	}
+
+	void CommandBuffer::BeginStatisticsScope(const std::string& name)
+	{
+		if (!pPipelineStatistics_) {
+			return;
+		}
+		if (statisticsScopeDepth_++ == 0) {
+			statisticsScope_ = pPipelineStatistics_->BeginScope(commandBuffer_.get(), queueType_, name);
+		}
+	}
+
+	void CommandBuffer::EndStatisticsScope()
+	{
+		if (!pPipelineStatistics_ || statisticsScopeDepth_ == 0) {
+			return;
+		}
+		if (--statisticsScopeDepth_ == 0) {
+			pPipelineStatistics_->EndScope(commandBuffer_.get(), statisticsScope_);
+			statisticsScope_ = PipelineStatistics::InvalidScope;
+		}
+	}
+
 	void CommandBuffer::DrawMesh(MeshBaseHandle pMesh, int numIndices)
 	{
+		FlushBarriers();
 		commandBuffer_->drawIndexed(static_cast<uint32_t>(numIndices), 1, 0, 0, 0);
 	}
 
 	void CommandBuffer::Draw(uint32_t vertexCount, uint32_t instanceCount)
 	{
+		FlushBarriers();
 		commandBuffer_->draw(vertexCount, instanceCount, 0, 0);
 	}
 
 	void CommandBuffer::Dispatch(uint32_t groupCountX, uint32_t groupCountY, uint32_t groupCountZ)
 	{
+		FlushBarriers();
+		BeginProfileScope("Dispatch");
 		commandBuffer_->dispatch(groupCountX, groupCountY, groupCountZ);
+		EndProfileScope();
 	}
 
 	void CommandBuffer::DrawGui(GUI& gui)
 	{
 		ImGui::Render();
+		FlushBarriers();
 		ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), this->GetCommandBuffer());
 	}
 
+	void CommandBuffer::ExecuteCommands(const std::vector<CommandBufferHandle>& pSecondaryCommandBuffers)
+	{
+		if (pSecondaryCommandBuffers.empty()) {
+			return;
+		}
+		std::vector<vk::CommandBuffer> commandBuffers;
+		commandBuffers.reserve(pSecondaryCommandBuffers.size());
+		for (const auto& pSecondaryCommandBuffer : pSecondaryCommandBuffers) {
+			commandBuffers.push_back(pSecondaryCommandBuffer->GetCommandBuffer());
+		}
+		if (statisticsScope_ != PipelineStatistics::InvalidScope && !pDevice_->GetEnabledFeatures().inheritedQueries) {
+			throw std::runtime_error("ExecuteCommands in a pipeline statistics scope requires inheritedQueries");
+		}
+		FlushBarriers();
+		commandBuffer_->executeCommands(commandBuffers);
+	}
+
 	vk::CommandBuffer CommandBuffer::GetCommandBuffer() const
 	{
 		return commandBuffer_.get();
 	}
+
+	bool CommandBuffer::IsSecondary() const
+	{
+		return level_ == vk::CommandBufferLevel::eSecondary;
+	}
 }
\ No newline at end of file
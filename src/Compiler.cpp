@@ -1,13 +1,65 @@
 #include "Compiler.hpp"
 
+#include "Hash.hpp"
 #include "Shader.hpp"
+#include "ThreadPool.hpp"
+#include "TraceRecorder.hpp"
+
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
 
 using namespace std;
 
+namespace
+{
+    constexpr glslang::EShTargetClientVersion TargetClientVersion = glslang::EShTargetVulkan_1_3;
+    constexpr glslang::EShTargetLanguageVersion TargetLanguageVersion = glslang::EShTargetSpv_1_6;
+    constexpr int GLSLDefaultVersion = 450;
+
+    // Bump when the cache file layout or compile options change
+    constexpr uint32_t SPIRVCacheMagic = 0x56535153; // "SQSV"
+    constexpr uint32_t SPIRVCacheVersion = 2;
+    constexpr uint32_t SPIRVMagicNumber = 0x07230203;
+
+    struct SPIRVCacheHeader
+    {
+        uint32_t magic = SPIRVCacheMagic;
+        uint32_t version = SPIRVCacheVersion;
+        uint64_t key = 0;
+        uint64_t codeWordCount = 0;
+        uint64_t codeHash = 0;
+    };
+
+    std::string ToCacheFileName(uint64_t key)
+    {
+        std::stringstream ss;
+        ss << std::hex << std::setw(16) << std::setfill('0') << key << ".spv";
+        return ss.str();
+    }
+
+    // Unique among the threads of all processes sharing the cache directory
+    std::string ToTempFileSuffix()
+    {
+#ifdef _WIN32
+        int processId = _getpid();
+#else
+        int processId = static_cast<int>(getpid());
+#endif
+        std::stringstream ss;
+        ss << ".tmp" << processId << "_" << std::hash<std::thread::id>{}(std::this_thread::get_id());
+        return ss.str();
+    }
+}
+
 namespace sqrp
 {
     TBuiltInResource Compiler::DefaultTBuiltInResource() const {
-        TBuiltInResource res = {};
+        // Zero clear including padding since the resource limits are hashed into the cache key
+        TBuiltInResource res;
+        std::memset(&res, 0, sizeof(TBuiltInResource));
         res.maxLights = 32;
         res.maxClipPlanes = 6;
         res.maxTextureUnits = 32;
@@ -102,7 +154,93 @@ namespace sqrp
         return res;
     }
 
-    Compiler::Compiler() {
+    uint64_t Compiler::ComputeCacheKey(const std::string& glslSource, const std::string& preamble, ShaderType shaderType) const
+    {
+        TBuiltInResource resources = DefaultTBuiltInResource();
+
+        uint64_t key = HashValue(SPIRVCacheVersion);
+        key = HashString(glslSource, key);
+        key = HashString(preamble, key);
+        key = HashValue(static_cast<int>(shaderType), key);
+        key = HashValue(static_cast<int>(TargetClientVersion), key);
+        key = HashValue(static_cast<int>(TargetLanguageVersion), key);
+        key = HashValue(GLSLDefaultVersion, key);
+        key = HashValue(resources, key);
+        // A glslang upgrade may change the generated code, entries of other versions are compiled again
+        glslang::Version glslangVersion = glslang::GetVersion();
+        key = HashValue(glslangVersion.major, key);
+        key = HashValue(glslangVersion.minor, key);
+        key = HashValue(glslangVersion.patch, key);
+        key = HashString(glslangVersion.flavor ? glslangVersion.flavor : "", key);
+        key = HashValue(glslang::GetSpirvGeneratorVersion(), key);
+
+        return key;
+    }
+
+    bool Compiler::LoadCachedSPIRV(uint64_t key, std::vector<uint32_t>& spirv) const
+    {
+        std::filesystem::path cachePath = cacheDirectory_ / ToCacheFileName(key);
+        std::ifstream file(cachePath, std::ios::in | std::ios::binary);
+        if (!file.is_open()) {
+            return false;
+        }
+
+        SPIRVCacheHeader header{};
+        if (!file.read(reinterpret_cast<char*>(&header), sizeof(SPIRVCacheHeader))) {
+            return false;
+        }
+        if (header.magic != SPIRVCacheMagic || header.version != SPIRVCacheVersion || header.key != key || header.codeWordCount == 0) {
+            return false;
+        }
+
+        spirv.resize(header.codeWordCount);
+        if (!file.read(reinterpret_cast<char*>(spirv.data()), spirv.size() * sizeof(uint32_t))) {
+            return false;
+        }
+
+        // Reject truncated or corrupted entries, they are overwritten by the next compile
+        if (spirv[0] != SPIRVMagicNumber || HashBytes(spirv.data(), spirv.size() * sizeof(uint32_t)) != header.codeHash) {
+            std::cerr << "Warning: Invalid SPIR-V cache entry " << cachePath.string() << std::endl;
+            return false;
+        }
+
+        return true;
+    }
+
+    void Compiler::StoreCachedSPIRV(uint64_t key, const std::vector<uint32_t>& spirv) const
+    {
+        std::error_code errorCode;
+        std::filesystem::create_directories(cacheDirectory_, errorCode);
+
+        SPIRVCacheHeader header{};
+        header.key = key;
+        header.codeWordCount = spirv.size();
+        header.codeHash = HashBytes(spirv.data(), spirv.size() * sizeof(uint32_t));
+
+        // Write to a temporary file then rename it so that other processes never see a partial entry
+        std::filesystem::path cachePath = cacheDirectory_ / ToCacheFileName(key);
+        std::filesystem::path tempPath = cachePath;
+        tempPath += ToTempFileSuffix();
+        {
+            std::ofstream file(tempPath, std::ios::out | std::ios::binary | std::ios::trunc);
+            if (!file.is_open()) {
+                std::cerr << "Warning: Failed to write SPIR-V cache " << tempPath.string() << std::endl;
+                return;
+            }
+            file.write(reinterpret_cast<const char*>(&header), sizeof(SPIRVCacheHeader));
+            file.write(reinterpret_cast<const char*>(spirv.data()), spirv.size() * sizeof(uint32_t));
+        }
+        std::filesystem::rename(tempPath, cachePath, errorCode);
+        if (errorCode) {
+            std::filesystem::remove(tempPath, errorCode);
+        }
+    }
+
+    Compiler::Compiler(std::string cacheDirectory)
+        : cacheDirectory_(cacheDirectory)
+    {
+        // NOTE : Process wide and reference counted by glslang, so it must be called before any worker thread compiles.
+        //        Each compile creates its own TShader / TProgram and uses the thread local pool allocator, so they are thread safe.
         glslang::InitializeProcess();
     }
 
@@ -110,8 +248,9 @@ namespace sqrp
         glslang::FinalizeProcess();
     }
 
-    std::vector<uint32_t> Compiler::CompileGLSLToSPIRV(const std::string& fileName, ShaderType shaderType) const
+    std::vector<uint32_t> Compiler::CompileGLSLToSPIRV(const std::string& fileName, ShaderType shaderType, const std::vector<std::string>& defines) const
     {
+        TraceScope traceScope("CompileShader", "startup");
         std::ifstream file(fileName, std::ios::in);
         if (!file.is_open()) {
             throw std::runtime_error("Failed to open GLSL file: " + fileName);
@@ -155,18 +294,40 @@ namespace sqrp
 				throw std::runtime_error("Unsupported shader type");
         }
 
+        std::string preamble;
+        for (const auto& define : defines) {
+            std::string line = define;
+            size_t equalPos = line.find('=');
+            if (equalPos != std::string::npos) {
+                line[equalPos] = ' ';
+            }
+            preamble += "#define " + line + "\n";
+        }
+
+        uint64_t cacheKey = 0;
+        if (!cacheDirectory_.empty()) {
+            cacheKey = ComputeCacheKey(glslSource, preamble, shaderType);
+            std::vector<uint32_t> cachedSpirv;
+            if (LoadCachedSPIRV(cacheKey, cachedSpirv)) {
+                cacheHitCount_++;
+                return cachedSpirv;
+            }
+            cacheMissCount_++;
+        }
+
         glslang::TShader shader(stage);
         const char* sourceCStr = glslSource.c_str();
         shader.setStrings(&sourceCStr, 1);
+        shader.setPreamble(preamble.c_str());
 		// Disable automatic binding and location assignment
         shader.setAutoMapBindings(false);
 		shader.setAutoMapLocations(false);
-        shader.setEnvInput(glslang::EShSourceGlsl, stage, glslang::EShClientVulkan, 450);
-        shader.setEnvClient(glslang::EShClientVulkan, glslang::EShTargetVulkan_1_3); // For vulkan 1.3s
-		shader.setEnvTarget(glslang::EShTargetSpv, glslang::EShTargetSpv_1_6); // Set 1.6 For vulkan 1.3
+        shader.setEnvInput(glslang::EShSourceGlsl, stage, glslang::EShClientVulkan, GLSLDefaultVersion);
+        shader.setEnvClient(glslang::EShClientVulkan, TargetClientVersion); // For vulkan 1.3s
+		shader.setEnvTarget(glslang::EShTargetSpv, TargetLanguageVersion); // Set 1.6 For vulkan 1.3
 
         TBuiltInResource resources = DefaultTBuiltInResource();  // ftHg
-        int defaultVersion = 450;
+        int defaultVersion = GLSLDefaultVersion;
 
         EShMessages messages = (EShMessages)(EShMsgSpvRules | EShMsgVulkanRules);
 
@@ -191,7 +352,52 @@ namespace sqrp
 
         std::vector<uint32_t> spirv;
         glslang::GlslangToSpv(*program.getIntermediate(stage), spirv);
+
+        if (!cacheDirectory_.empty()) {
+            StoreCachedSPIRV(cacheKey, spirv);
+        }
         
 		return spirv;
     }
+
+    std::vector<std::vector<uint32_t>> Compiler::CompileBatch(const std::vector<ShaderCompileJob>& jobs, uint32_t threadCount) const
+    {
+        if (jobs.empty()) {
+            return {};
+        }
+        if (threadCount == 0) {
+            threadCount = std::min(static_cast<uint32_t>(jobs.size()), std::max(1u, std::thread::hardware_concurrency()));
+        }
+
+        std::vector<std::future<std::vector<uint32_t>>> futures;
+        futures.reserve(jobs.size());
+        {
+            ThreadPool threadPool(threadCount);
+            for (const auto& job : jobs) {
+                futures.push_back(threadPool.Enqueue([this, &job]() {
+                    return CompileGLSLToSPIRV(job.fileName, job.shaderType, job.defines);
+                }));
+            }
+            // Pool destructor waits for all jobs
+        }
+
+        std::vector<std::vector<uint32_t>> spirvs;
+        spirvs.reserve(jobs.size());
+        for (auto& future : futures) {
+            // Rethrow the compile error of the job
+            spirvs.push_back(future.get());
+        }
+
+        return spirvs;
+    }
+
+    uint32_t Compiler::GetCacheHitCount() const
+    {
+        return cacheHitCount_.load();
+    }
+
+    uint32_t Compiler::GetCacheMissCount() const
+    {
+        return cacheMissCount_.load();
+    }
 }
\ No newline at end of file
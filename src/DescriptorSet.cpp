@@ -3,6 +3,7 @@
 #include "Buffer.hpp"
 #include "CommandBuffer.hpp"
 #include "Device.hpp"
+#include "Hash.hpp"
 #include "Image.hpp"
 
 using namespace std;
@@ -16,6 +17,7 @@ namespace sqrp
 		vector<vk::DescriptorSetLayoutBinding> layoutBindings(descriptorSetCreateInfos_.size());
 		map<vk::DescriptorType, uint32_t> descriptorTypeCounts;
 		int index = 0;
+		layoutHash_ = HashSeed;
 		for (const auto& descriptorSetCreateInfo : descriptorSetCreateInfos_) {
 			auto type = descriptorSetCreateInfo.type;
 			layoutBindings[index] = vk::DescriptorSetLayoutBinding{}
@@ -25,6 +27,11 @@ namespace sqrp
 				.setDescriptorCount(1)
 				.setStageFlags(descriptorSetCreateInfo.shaderStageFlags);
 
+			layoutHash_ = HashValue(layoutBindings[index].binding, layoutHash_);
+			layoutHash_ = HashValue(static_cast<VkDescriptorType>(type), layoutHash_);
+			layoutHash_ = HashValue(layoutBindings[index].descriptorCount, layoutHash_);
+			layoutHash_ = HashValue(static_cast<VkShaderStageFlags>(descriptorSetCreateInfo.shaderStageFlags), layoutHash_);
+
 			if (descriptorTypeCounts.find(type) != descriptorTypeCounts.end()) {
 				descriptorTypeCounts[type]++;
 			}
@@ -92,7 +99,7 @@ namespace sqrp
 				auto buffer = std::get<BufferHandle>(descriptorSetCreateInfo.pResource);
 				descriptorBufferInfos[index].setBuffer(buffer->GetBuffer());
 				descriptorBufferInfos[index].setOffset(0);
-				descriptorBufferInfos[index].setRange(buffer->GetSize());
+				descriptorBufferInfos[index].setRange(descriptorSetCreateInfo.range > 0 ? descriptorSetCreateInfo.range : buffer->GetSize());
 
 				writeDescriptorSets[index] = vk::WriteDescriptorSet{}
 					.setDstSet(descriptorSets_.get())
@@ -144,4 +151,9 @@ namespace sqrp
 	{
 		return descriptorSetLayout_.get();
 	}
+
+	uint64_t DescriptorSet::GetLayoutHash() const
+	{
+		return layoutHash_;
+	}
 }
\ No newline at end of file
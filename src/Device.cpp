@@ -3,12 +3,22 @@
 #include "CommandBuffer.hpp"
 #include "Buffer.hpp"
 #include "Fence.hpp"
+#include "FrameCapture.hpp"
+#include "FrameCommandAllocator.hpp"
 #include "Gui.hpp"
 #include "Image.hpp"
+#include "ParallelRecorder.hpp"
 #include "Pipeline.hpp"
+#include "PipelineStatistics.hpp"
+#include "Profiler.hpp"
+#include "RenderGraph.hpp"
+#include "RingBuffer.hpp"
 #include "Semaphore.hpp"
 #include "Shader.hpp"
+#include "SubmitBatch.hpp"
 #include "Swapchain.hpp"
+#include "TimelineSemaphore.hpp"
+#include "UploadManager.hpp"
 
 VULKAN_HPP_DEFAULT_DISPATCH_LOADER_DYNAMIC_STORAGE
 
@@ -29,10 +39,45 @@ namespace
 
 		return VK_FALSE;
 	}
+
+	// Higher is preferred, CPU implementations (lavapipe) are the last resort
+	int GetPhysicalDeviceTypeRank(vk::PhysicalDeviceType type)
+	{
+		switch (type) {
+		case vk::PhysicalDeviceType::eDiscreteGpu:
+			return 4;
+		case vk::PhysicalDeviceType::eIntegratedGpu:
+			return 3;
+		case vk::PhysicalDeviceType::eVirtualGpu:
+			return 2;
+		case vk::PhysicalDeviceType::eCpu:
+			return 1;
+		default:
+			return 0;
+		}
+	}
 }
 
 namespace sqrp
 {
+	const char* GetMemoryCategoryName(MemoryCategory category)
+	{
+		switch (category) {
+		case MemoryCategory::Mesh:
+			return "Mesh";
+		case MemoryCategory::Texture:
+			return "Texture";
+		case MemoryCategory::Uniform:
+			return "Uniform";
+		case MemoryCategory::Attachment:
+			return "Attachment";
+		case MemoryCategory::Staging:
+			return "Staging";
+		default:
+			return "Other";
+		}
+	}
+
 	bool Device::isDeviceExtensionSupport(vk::PhysicalDevice physDev)
 	{
 		set<string> requiredExtensions{ requestDeviceExtensions_.begin(), requestDeviceExtensions_.end() };
@@ -49,11 +94,17 @@ namespace sqrp
 		if (!isDeviceExtensionSupport(physDev)) {
 			return false;
 		}
-		if (physDev.getSurfaceFormatsKHR(surface_.get()).empty() || physDev.getSurfacePresentModesKHR(surface_.get()).empty()) {
+		if (surface_ && (physDev.getSurfaceFormatsKHR(surface_.get()).empty() || physDev.getSurfacePresentModesKHR(surface_.get()).empty())) {
 			return false;
 		}
+		bool hasGraphicsQueue = false;
+		for (const auto& queueFamily : physDev.getQueueFamilyProperties()) {
+			if (queueFamily.queueFlags & vk::QueueFlagBits::eGraphics) {
+				hasGraphicsQueue = true;
+			}
+		}
 
-		return true;
+		return hasGraphicsQueue;
 	}
 
 	bool Device::isDeviceRayTracingSupport(vk::PhysicalDevice physDev)
@@ -85,6 +136,43 @@ namespace sqrp
 		}
 	}
 
+	std::vector<uint8_t> Device::LoadPipelineCacheData() const
+	{
+		if (pipelineCachePath_.empty()) {
+			return {};
+		}
+
+		std::ifstream file(pipelineCachePath_, std::ios::in | std::ios::binary | std::ios::ate);
+		if (!file.is_open()) {
+			return {};
+		}
+		size_t fileSize = static_cast<size_t>(file.tellg());
+		std::vector<uint8_t> data(fileSize);
+		file.seekg(0);
+		if (!file.read(reinterpret_cast<char*>(data.data()), fileSize)) {
+			return {};
+		}
+
+		// Driver may crash with the data of other device or driver version, so validate the header before use
+		VkPipelineCacheHeaderVersionOne header{};
+		if (data.size() < sizeof(VkPipelineCacheHeaderVersionOne)) {
+			return {};
+		}
+		std::memcpy(&header, data.data(), sizeof(VkPipelineCacheHeaderVersionOne));
+
+		auto properties = physicalDevice_.getProperties();
+		if (header.headerSize < sizeof(VkPipelineCacheHeaderVersionOne) ||
+			header.headerVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE ||
+			header.vendorID != properties.vendorID ||
+			header.deviceID != properties.deviceID ||
+			std::memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID.data(), VK_UUID_SIZE) != 0) {
+			cout << "Pipeline cache is not compatible with this device, ignored." << endl;
+			return {};
+		}
+
+		return data;
+	}
+
 	Device::Device()
 	{
 		
@@ -92,36 +180,81 @@ namespace sqrp
 
 	Device::~Device()
 	{
+		// Pending pipeline builds are finished before the pipeline cache and the device are destroyed
+		pipelineThreadPool_.reset();
+		// Query pools are destroyed before the device
+		pProfiler_.reset();
+		// Pending uploads are finished before the allocator is destroyed
+		uploadManager_.reset();
+		if (pipelineCache_) {
+			SavePipelineCache();
+			pipelineCache_.reset();
+		}
+		if (allocationCount_ != 0) {
+			cerr << "Warning: " << allocationCount_ << " allocations (" << totalBytes_ << " bytes) are not freed before the device is destroyed" << endl;
+		}
 		vmaDestroyAllocator(allocator_);
 	}
 
+	void Device::SetPipelineCachePath(const std::string& path)
+	{
+		pipelineCachePath_ = path;
+	}
+
 	bool Device::Init(Application application)
 	{
+		return InitInternal(application.GetAppName(), application.GetPWindow());
+	}
+
+	bool Device::InitHeadless(std::string appName)
+	{
+		return InitInternal(appName, nullptr);
+	}
+
+	bool Device::InitInternal(const std::string& appName, GLFWwindow* pWindow)
+	{
+		isHeadless_ = pWindow == nullptr;
+
 		// Setup dynamic library loader
 		static vk::DynamicLoader dl;
 		auto vkGetInstanceProcAddr = dl.getProcAddress<PFN_vkGetInstanceProcAddr>("vkGetInstanceProcAddr");
 		VULKAN_HPP_DEFAULT_DISPATCHER.init(vkGetInstanceProcAddr);
 
 		vk::ApplicationInfo appInfo = vk::ApplicationInfo()
-			.setPApplicationName(application.GetAppName().c_str())
+			.setPApplicationName(appName.c_str())
 			.setApplicationVersion(VK_MAKE_API_VERSION(1, 0, 0, 0))
 			.setApiVersion(VK_API_VERSION_1_3);
 
-		// Get extension for GLFW
-		uint32_t extensionCount = 0;
-		auto ppExtensionNames = glfwGetRequiredInstanceExtensions(&extensionCount);
-		// Using range constructor of vector
-		for (int i = 0; i < extensionCount; i++) {
-			requestInstanceExtensions_.push_back(ppExtensionNames[i]);
+		if (!isHeadless_) {
+			// Get extension for GLFW
+			uint32_t extensionCount = 0;
+			auto ppExtensionNames = glfwGetRequiredInstanceExtensions(&extensionCount);
+			// Using range constructor of vector
+			for (int i = 0; i < extensionCount; i++) {
+				requestInstanceExtensions_.push_back(ppExtensionNames[i]);
+			}
+
+			requestDeviceExtensions_.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
 		}
 		// Get extension for debug
 		requestInstanceExtensions_.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
 
-		requestDeviceExtensions_.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
-
 		// Create instance
 		// NOTE : Turn on validation layer at debug build
-		layers_.push_back("VK_LAYER_KHRONOS_validation");
+		// Servers without the SDK have no validation layer, so it is skipped instead of failing createInstance
+		const char* validationLayerName = "VK_LAYER_KHRONOS_validation";
+		bool hasValidationLayer = false;
+		for (const auto& layer : vk::enumerateInstanceLayerProperties()) {
+			if (string(layer.layerName.data()) == validationLayerName) {
+				hasValidationLayer = true;
+			}
+		}
+		if (hasValidationLayer) {
+			layers_.push_back(validationLayerName);
+		}
+		else {
+			std::cerr << "Warning: " << validationLayerName << " is not available" << std::endl;
+		}
 		instance_ = vk::createInstanceUnique(vk::InstanceCreateInfo()
 			.setPApplicationInfo(&appInfo)
 			.setEnabledLayerCount(layers_.size())
@@ -144,16 +277,24 @@ namespace sqrp
 		debugMessenger_ = instance_->createDebugUtilsMessengerEXTUnique(createInfo);
 
 		// Create surface
-		VkSurfaceKHR rawSurface;
-		if (glfwCreateWindowSurface(instance_.get(), application.GetPWindow(), nullptr, &rawSurface) != VK_SUCCESS) {
-			throw std::runtime_error("Failed to create window surface!");
+		if (!isHeadless_) {
+			VkSurfaceKHR rawSurface;
+			if (glfwCreateWindowSurface(instance_.get(), pWindow, nullptr, &rawSurface) != VK_SUCCESS) {
+				throw std::runtime_error("Failed to create window surface!");
+			}
+			surface_ = vk::UniqueSurfaceKHR(rawSurface, instance_.get());
 		}
-		surface_ = vk::UniqueSurfaceKHR(rawSurface, instance_.get());
 
-		// Select physical device
+		// Select physical device, GPUs are preferred over CPU implementations
+		int selectedRank = -1;
 		for (const auto& physDev : instance_->enumeratePhysicalDevices()) {
-			if (isDeviceSuitable(physDev)) { // == VK_SUCCESS ???
+			if (!isDeviceSuitable(physDev)) {
+				continue;
+			}
+			int rank = GetPhysicalDeviceTypeRank(physDev.getProperties().deviceType);
+			if (rank >= selectedRank) {
 				physicalDevice_ = physDev;
+				selectedRank = rank;
 			}
 		}
 		if (!physicalDevice_) {
@@ -167,19 +308,33 @@ namespace sqrp
 			auto isSupportGraphics = queueFamilies[i].queueFlags & vk::QueueFlagBits::eGraphics;
 			auto isSupportCompute = queueFamilies[i].queueFlags & vk::QueueFlagBits::eCompute;
 			auto isSupportTransfer = queueFamilies[i].queueFlags & vk::QueueFlagBits::eTransfer;
-			if (surface_) {
-				auto isSupportPresent = physicalDevice_.getSurfaceSupportKHR(i, surface_.get());
-				if (isSupportGraphics && isSupportCompute && isSupportTransfer && isSupportPresent) {
-					queueContexts_[QueueContextType::General] = { i, {}, 0, {} };
-					if (queueFamilies[i].queueCount > 1) {
-						queueContexts_[QueueContextType::Compute] = { i, {}, 1, {} };
-					}
-					continue;
-				}
-				if (isSupportGraphics && isSupportPresent) {
-					queueContexts_[QueueContextType::Graphics] = { i, {}, 0, {} };
-					continue;
+			// Nothing is presented in headless mode
+			bool isSupportPresent = surface_ ? physicalDevice_.getSurfaceSupportKHR(i, surface_.get()) : true;
+			if (isSupportGraphics && isSupportCompute && isSupportTransfer && isSupportPresent) {
+				queueContexts_[QueueContextType::General] = { i, {}, 0, {} };
+				if (queueFamilies[i].queueCount > 1) {
+					queueContexts_[QueueContextType::Compute] = { i, {}, 1, {} };
 				}
+				continue;
+			}
+			if (isSupportGraphics && isSupportPresent) {
+				queueContexts_[QueueContextType::Graphics] = { i, {}, 0, {} };
+				continue;
+			}
+		}
+		// Dedicated transfer queue (DMA engine), prefer a family without compute
+		// Uploads fall back to the rendering queue if not found
+		for (uint32_t i = 0; i < queueFamilies.size(); i++) {
+			auto queueFlags = queueFamilies[i].queueFlags;
+			if (!(queueFlags & vk::QueueFlagBits::eTransfer) || (queueFlags & vk::QueueFlagBits::eGraphics)) {
+				continue;
+			}
+			if (!(queueFlags & vk::QueueFlagBits::eCompute)) {
+				queueContexts_[QueueContextType::Transfer] = { i, {}, 0, {} };
+				break;
+			}
+			if (!queueContexts_.contains(QueueContextType::Transfer)) {
+				queueContexts_[QueueContextType::Transfer] = { i, {}, 0, {} };
 			}
 		}
 
@@ -200,12 +355,13 @@ namespace sqrp
 		}
 		cout << "queueFamilyNum = " << queueFamilyInfos.size() << endl;
 		float queuePriority = 1.0f;
-		vector<float> queuePriorities;
+		// NOTE : Shared by all DeviceQueueCreateInfos, so it must not be reallocated after the pointers are taken
+		uint32_t maxQueueCount = 0;
+		for (const auto [familyIndex, count] : queueFamilyInfos) {
+			maxQueueCount = std::max(maxQueueCount, count);
+		}
+		vector<float> queuePriorities(maxQueueCount, queuePriority);
 		for (const auto [familyIndex, count] : queueFamilyInfos) {
-			queuePriorities.resize(count);
-			for (uint32_t i = 0; i < count; i++) {
-				queuePriorities[i] = queuePriority;
-			}
 			queueCreateInfos.push_back(
 				vk::DeviceQueueCreateInfo{}
 				.setQueueFamilyIndex(familyIndex)
@@ -224,28 +380,71 @@ namespace sqrp
 			requestDeviceExtensions_.push_back(VK_KHR_DEFERRED_HOST_OPERATIONS_EXTENSION_NAME);
 			requestDeviceExtensions_.push_back(VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME);
 		}
+		// Optional, VMA reads the real usage and budget of each heap instead of estimating them
+		isSupportMemoryBudget_ = false;
+		for (const auto& extension : physicalDevice_.enumerateDeviceExtensionProperties()) {
+			if (std::string(extension.extensionName.data()) == VK_EXT_MEMORY_BUDGET_EXTENSION_NAME) {
+				isSupportMemoryBudget_ = true;
+			}
+		}
+		if (isSupportMemoryBudget_) {
+			requestDeviceExtensions_.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+		}
+		// Optional core features used by GraphicsPipelineDesc
+		vk::PhysicalDeviceFeatures supportedFeatures = physicalDevice_.getFeatures();
+		enabledFeatures_ = vk::PhysicalDeviceFeatures{};
+		enabledFeatures_.fillModeNonSolid = supportedFeatures.fillModeNonSolid;
+		enabledFeatures_.wideLines = supportedFeatures.wideLines;
+		// Optional, used by PipelineStatistics
+		enabledFeatures_.pipelineStatisticsQuery = supportedFeatures.pipelineStatisticsQuery;
+		// Optional, secondary command buffers are executed in an active pipeline statistics query
+		enabledFeatures_.inheritedQueries = supportedFeatures.inheritedQueries;
+
+		// Vulkan 1.2 / 1.3 core features
+		auto supportedFeatureChain = physicalDevice_.getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceVulkan12Features, vk::PhysicalDeviceVulkan13Features>();
+		const auto& supportedVulkan12Features = supportedFeatureChain.get<vk::PhysicalDeviceVulkan12Features>();
+		const auto& supportedVulkan13Features = supportedFeatureChain.get<vk::PhysicalDeviceVulkan13Features>();
+		if (!supportedVulkan12Features.timelineSemaphore) {
+			throw std::runtime_error("Timeline semaphore is not supported");
+		}
+		if (!supportedVulkan13Features.synchronization2) {
+			throw std::runtime_error("Synchronization2 is not supported");
+		}
+		if (!supportedVulkan13Features.dynamicRendering) {
+			throw std::runtime_error("Dynamic rendering is not supported");
+		}
+		enabledVulkan12Features_ = vk::PhysicalDeviceVulkan12Features{};
+		enabledVulkan12Features_.timelineSemaphore = VK_TRUE;
+		// Optional, Profiler resets timestamp queries from the host
+		enabledVulkan12Features_.hostQueryReset = supportedVulkan12Features.hostQueryReset;
+		enabledVulkan13Features_ = vk::PhysicalDeviceVulkan13Features{};
+		enabledVulkan13Features_.synchronization2 = VK_TRUE;
+		enabledVulkan13Features_.dynamicRendering = VK_TRUE;
+
 		vk::DeviceCreateInfo deviceCreateInfo{};
 		deviceCreateInfo
 			.setPQueueCreateInfos(queueCreateInfos.data())
 			.setQueueCreateInfoCount(queueCreateInfos.size()) // If you need multi queue when async compute, set multivalue
-			.setPEnabledExtensionNames(requestDeviceExtensions_);
+			.setPEnabledExtensionNames(requestDeviceExtensions_)
+			.setPEnabledFeatures(&enabledFeatures_);
 
 		if (!isSupportRayTracing_) {
 			// NOTE : FIX!
-			vk::StructureChain<vk::DeviceCreateInfo/*, features*/> createInfoChain{
+			vk::StructureChain<vk::DeviceCreateInfo, vk::PhysicalDeviceVulkan12Features, vk::PhysicalDeviceVulkan13Features> createInfoChain{
 				deviceCreateInfo,
-				//vk::PhysicalDevice
+				enabledVulkan12Features_,
+				enabledVulkan13Features_
 			};
 
 			device_ = physicalDevice_.createDeviceUnique(createInfoChain.get<vk::DeviceCreateInfo>());
 		}
 		else {
-			vk::PhysicalDeviceBufferDeviceAddressFeatures bufferAddrFeatures{};
-			bufferAddrFeatures.bufferDeviceAddress = VK_TRUE;
+			// NOTE : PhysicalDeviceBufferDeviceAddressFeatures can't be chained with PhysicalDeviceVulkan12Features
+			enabledVulkan12Features_.bufferDeviceAddress = VK_TRUE;
 
 			vk::PhysicalDeviceRayTracingPipelineFeaturesKHR rayTracingPipelineFeatures{};
 			rayTracingPipelineFeatures.rayTracingPipeline = VK_TRUE;
-			rayTracingPipelineFeatures.pNext = &bufferAddrFeatures; // Connect to pNext chain
+			rayTracingPipelineFeatures.pNext = &enabledVulkan12Features_; // Connect to pNext chain
 
 			vk::PhysicalDeviceAccelerationStructureFeaturesKHR accelStructFeatures{};
 			accelStructFeatures.accelerationStructure = VK_TRUE;
@@ -255,13 +454,15 @@ namespace sqrp
 			vk::StructureChain<vk::DeviceCreateInfo,
 				vk::PhysicalDeviceAccelerationStructureFeaturesKHR,
 				vk::PhysicalDeviceRayTracingPipelineFeaturesKHR,
-				vk::PhysicalDeviceBufferDeviceAddressFeatures> createInfoChain{
+				vk::PhysicalDeviceVulkan12Features,
+				vk::PhysicalDeviceVulkan13Features> createInfoChain{
 				// DeviceCreateInfo
 				 deviceCreateInfo,
 				 // features
 				 accelStructFeatures,
 				 rayTracingPipelineFeatures,
-				 bufferAddrFeatures
+				 enabledVulkan12Features_,
+				 enabledVulkan13Features_
 			};
 
 			device_ = physicalDevice_.createDeviceUnique(createInfoChain.get<vk::DeviceCreateInfo>());
@@ -269,8 +470,15 @@ namespace sqrp
 
 		VULKAN_HPP_DEFAULT_DISPATCHER.init(device_.get());
 
+		map<pair<uint32_t, uint32_t>, shared_ptr<mutex>> queueMutexes;
 		for (auto& [type, context] : queueContexts_) {
 			context.queue = device_->getQueue(context.queueFamilyIndex, context.queueIndex);
+			context.queueFlags = queueFamilies[context.queueFamilyIndex].queueFlags;
+			auto& pQueueMutex = queueMutexes[{ context.queueFamilyIndex, context.queueIndex }];
+			if (!pQueueMutex) {
+				pQueueMutex = make_shared<mutex>();
+			}
+			context.pQueueMutex = pQueueMutex;
 			context.commandPool = device_->createCommandPoolUnique(
 				vk::CommandPoolCreateInfo()
 				.setFlags(vk::CommandPoolCreateFlagBits::eResetCommandBuffer)
@@ -283,11 +491,42 @@ namespace sqrp
 		allocatorInfo.device = device_.get();
 		allocatorInfo.instance = instance_.get();
 		allocatorInfo.vulkanApiVersion = VK_API_VERSION_1_3;
+		if (isSupportMemoryBudget_) {
+			allocatorInfo.flags |= VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT;
+		}
 
 		if (vmaCreateAllocator(&allocatorInfo, &allocator_) != VK_SUCCESS) {
 			throw std::runtime_error("Failed to create VMA allocator");
 		}
 
+		// Create pipeline cache shared by all pipelines
+		std::vector<uint8_t> pipelineCacheData = LoadPipelineCacheData();
+		if (!pipelineCacheData.empty()) {
+			try {
+				pipelineCache_ = device_->createPipelineCacheUnique(
+					vk::PipelineCacheCreateInfo()
+					.setInitialDataSize(pipelineCacheData.size())
+					.setPInitialData(pipelineCacheData.data())
+				);
+				isPipelineCacheWarm_ = true;
+			}
+			catch (const vk::SystemError& e) {
+				cout << "Failed to load pipeline cache : " << e.what() << endl;
+			}
+		}
+		if (!pipelineCache_) {
+			pipelineCache_ = device_->createPipelineCacheUnique(vk::PipelineCacheCreateInfo());
+		}
+
+		// Leave one hardware thread for the render thread
+		uint32_t hardwareThreadCount = std::thread::hardware_concurrency();
+		pipelineThreadPool_ = std::make_unique<ThreadPool>(hardwareThreadCount > 1 ? hardwareThreadCount - 1 : 1);
+
+		// Uploads run on the transfer queue if available and are acquired by the rendering queue
+		QueueContextType renderQueueType = queueContexts_.contains(QueueContextType::General) ? QueueContextType::General : QueueContextType::Graphics;
+		QueueContextType uploadQueueType = queueContexts_.contains(QueueContextType::Transfer) ? QueueContextType::Transfer : renderQueueType;
+		uploadManager_ = std::make_unique<UploadManager>(*this, 64 * 1024 * 1024, uploadQueueType, renderQueueType);
+
 		return true;
 	}
 
@@ -326,6 +565,16 @@ namespace sqrp
 		return std::make_shared<FrameBuffer>(*this, name, pRenderPass, attachmentImages, width, height, inflightCount, pSwapchain);
 	}
 
+	FrameCaptureHandle Device::CreateFrameCapture(std::string name, uint32_t slotCount) const
+	{
+		return std::make_shared<FrameCapture>(*this, name, slotCount);
+	}
+
+	FrameCommandAllocatorHandle Device::CreateFrameCommandAllocator(std::string name, uint32_t inflightCount, QueueContextType queueType) const
+	{
+		return std::make_shared<FrameCommandAllocator>(*this, name, inflightCount, queueType);
+	}
+
 	GUIHandle Device::CreateGUI(GLFWwindow* window, SwapchainHandle pSwapchain, RenderPassHandle pRenderPass) const
 	{
 		return std::make_shared<GUI>(*this, window, pSwapchain, pRenderPass);
@@ -385,7 +634,49 @@ namespace sqrp
 		bool needVertexBuffer
 	) const
 	{
-		return std::make_shared<GraphicsPipeline>(*this, name, pRenderPass, pSwapchain, pVertexShader, pPixelShader, pDescriptorSet, pushConstantRange, enableDepthWrite, needVertexBuffer);
+		GraphicsPipelineDesc desc{};
+		desc.enableDepthWrite = enableDepthWrite;
+		desc.needVertexBuffer = needVertexBuffer;
+		return CreateGraphicsPipeline(name, pRenderPass, pVertexShader, pPixelShader, pDescriptorSet, desc, pushConstantRange);
+	}
+
+	GraphicsPipelineHandle Device::CreateGraphicsPipeline(
+		std::string name,
+		RenderPassHandle pRenderPass,
+		ShaderHandle pVertexShader,
+		ShaderHandle pPixelShader,
+		DescriptorSetHandle pDescriptorSet,
+		const GraphicsPipelineDesc& desc,
+		vk::PushConstantRange pushConstantRange
+	) const
+	{
+		PipelineKey stateKey = GraphicsPipeline::ComputeStateKey(pRenderPass, pVertexShader, pPixelShader, pDescriptorSet, desc, pushConstantRange);
+		if (auto pPipeline = FindPipeline(graphicsPipelineRegistry_, stateKey)) {
+			return pPipeline;
+		}
+
+		// Created outside of the lock so that other pipelines are not blocked by the driver compilation
+		auto pPipeline = std::make_shared<GraphicsPipeline>(*this, name, pRenderPass, pVertexShader, pPixelShader, pDescriptorSet, desc, pushConstantRange);
+		return RegisterPipeline(graphicsPipelineRegistry_, stateKey, pPipeline);
+	}
+
+	GraphicsPipelineHandle Device::CreateGraphicsPipeline(
+		std::string name,
+		const RenderingFormats& renderingFormats,
+		ShaderHandle pVertexShader,
+		ShaderHandle pPixelShader,
+		DescriptorSetHandle pDescriptorSet,
+		const GraphicsPipelineDesc& desc,
+		vk::PushConstantRange pushConstantRange
+	) const
+	{
+		PipelineKey stateKey = GraphicsPipeline::ComputeStateKey(renderingFormats, pVertexShader, pPixelShader, pDescriptorSet, desc, pushConstantRange);
+		if (auto pPipeline = FindPipeline(graphicsPipelineRegistry_, stateKey)) {
+			return pPipeline;
+		}
+
+		auto pPipeline = std::make_shared<GraphicsPipeline>(*this, name, renderingFormats, pVertexShader, pPixelShader, pDescriptorSet, desc, pushConstantRange);
+		return RegisterPipeline(graphicsPipelineRegistry_, stateKey, pPipeline);
 	}
 
 	ComputePipelineHandle Device::CreateComputePipeline(
@@ -395,7 +686,139 @@ namespace sqrp
 		vk::PushConstantRange pushConstantRange
 	) const
 	{
-		return make_shared<ComputePipeline>(*this, name, pComputeShader, pDescriptorSet, pushConstantRange);
+		PipelineKey stateKey = ComputePipeline::ComputeStateKey(pComputeShader, pDescriptorSet, pushConstantRange);
+		if (auto pPipeline = FindPipeline(computePipelineRegistry_, stateKey)) {
+			return pPipeline;
+		}
+
+		auto pPipeline = make_shared<ComputePipeline>(*this, name, pComputeShader, pDescriptorSet, pushConstantRange);
+		return RegisterPipeline(computePipelineRegistry_, stateKey, pPipeline);
+	}
+
+	GraphicsPipelineHandle Device::CreateGraphicsPipelineAsync(
+		std::string name,
+		RenderPassHandle pRenderPass,
+		ShaderHandle pVertexShader,
+		ShaderHandle pPixelShader,
+		DescriptorSetHandle pDescriptorSet,
+		const GraphicsPipelineDesc& desc,
+		vk::PushConstantRange pushConstantRange
+	) const
+	{
+		PipelineKey stateKey = GraphicsPipeline::ComputeStateKey(pRenderPass, pVertexShader, pPixelShader, pDescriptorSet, desc, pushConstantRange);
+		if (auto pPipeline = FindPipeline(graphicsPipelineRegistry_, stateKey)) {
+			return pPipeline;
+		}
+
+		auto pPipeline = std::make_shared<GraphicsPipeline>(*this, name, pRenderPass, pVertexShader, pPixelShader, pDescriptorSet, desc, pushConstantRange, true);
+		// NOTE : Build is launched before registration so that other threads never see a pipeline without the future
+		BuildPipelineAsync(pPipeline);
+		return RegisterPipeline(graphicsPipelineRegistry_, stateKey, pPipeline);
+	}
+
+	GraphicsPipelineHandle Device::CreateGraphicsPipelineAsync(
+		std::string name,
+		const RenderingFormats& renderingFormats,
+		ShaderHandle pVertexShader,
+		ShaderHandle pPixelShader,
+		DescriptorSetHandle pDescriptorSet,
+		const GraphicsPipelineDesc& desc,
+		vk::PushConstantRange pushConstantRange
+	) const
+	{
+		PipelineKey stateKey = GraphicsPipeline::ComputeStateKey(renderingFormats, pVertexShader, pPixelShader, pDescriptorSet, desc, pushConstantRange);
+		if (auto pPipeline = FindPipeline(graphicsPipelineRegistry_, stateKey)) {
+			return pPipeline;
+		}
+
+		auto pPipeline = std::make_shared<GraphicsPipeline>(*this, name, renderingFormats, pVertexShader, pPixelShader, pDescriptorSet, desc, pushConstantRange, true);
+		BuildPipelineAsync(pPipeline);
+		return RegisterPipeline(graphicsPipelineRegistry_, stateKey, pPipeline);
+	}
+
+	ComputePipelineHandle Device::CreateComputePipelineAsync(
+		std::string name,
+		ShaderHandle pComputeShader,
+		DescriptorSetHandle pDescriptorSet,
+		vk::PushConstantRange pushConstantRange
+	) const
+	{
+		PipelineKey stateKey = ComputePipeline::ComputeStateKey(pComputeShader, pDescriptorSet, pushConstantRange);
+		if (auto pPipeline = FindPipeline(computePipelineRegistry_, stateKey)) {
+			return pPipeline;
+		}
+
+		auto pPipeline = make_shared<ComputePipeline>(*this, name, pComputeShader, pDescriptorSet, pushConstantRange, true);
+		BuildPipelineAsync(pPipeline);
+		return RegisterPipeline(computePipelineRegistry_, stateKey, pPipeline);
+	}
+
+	template<typename T>
+	std::shared_ptr<T> Device::FindPipeline(const std::unordered_map<uint64_t, PipelineRegistryEntry<T>>& registry, const PipelineKey& stateKey) const
+	{
+		std::lock_guard<std::mutex> lock(pipelineRegistryMutex_);
+		auto it = registry.find(stateKey.Hash());
+		if (it != registry.end() && it->second.key == stateKey) {
+			return it->second.wpPipeline.lock();
+		}
+		return nullptr;
+	}
+
+	template<typename T>
+	std::shared_ptr<T> Device::RegisterPipeline(std::unordered_map<uint64_t, PipelineRegistryEntry<T>>& registry, const PipelineKey& stateKey, std::shared_ptr<T> pPipeline) const
+	{
+		std::lock_guard<std::mutex> lock(pipelineRegistryMutex_);
+		// Released pipelines would otherwise stay forever, e.g. with hot reloaded shaders
+		std::erase_if(registry, [](const auto& item) {
+			return item.second.wpPipeline.expired();
+		});
+		auto& entry = registry[stateKey.Hash()];
+		if (auto pExisting = entry.wpPipeline.lock()) {
+			if (entry.key == stateKey) {
+				// Same state was created by another thread meanwhile
+				return pExisting;
+			}
+			// Hash collision with a different state, the new pipeline is used without sharing
+			return pPipeline;
+		}
+		entry.key = stateKey;
+		entry.wpPipeline = pPipeline;
+		return pPipeline;
+	}
+
+	void Device::BuildPipelineAsync(PipelineHandle pPipeline) const
+	{
+		if (!pipelineThreadPool_) {
+			throw std::runtime_error("Device is not initialized");
+		}
+		// The task must not own the pipeline, the pipeline owns the task through buildFuture_
+		// A pipeline released before its build starts is skipped, one released during the build is destroyed by the worker
+		std::weak_ptr<Pipeline> wpPipeline = pPipeline;
+		pPipeline->buildFuture_ = pipelineThreadPool_->Enqueue([wpPipeline]() {
+			if (auto pPipeline = wpPipeline.lock()) {
+				pPipeline->Build();
+			}
+		}).share();
+	}
+
+	ParallelRecorderHandle Device::CreateParallelRecorder(std::string name, uint32_t inflightCount, uint32_t threadCount, QueueContextType queueType) const
+	{
+		return std::make_shared<ParallelRecorder>(*this, name, inflightCount, threadCount, queueType);
+	}
+
+	PipelineStatisticsHandle Device::CreatePipelineStatistics(std::string name, uint32_t inflightCount, uint32_t maxScopeCount) const
+	{
+		return std::make_shared<PipelineStatistics>(*this, name, inflightCount, maxScopeCount);
+	}
+
+	ProfilerHandle Device::CreateProfiler(std::string name, uint32_t inflightCount, uint32_t maxScopeCount) const
+	{
+		return std::make_shared<Profiler>(*this, name, inflightCount, maxScopeCount);
+	}
+
+	RenderGraphHandle Device::CreateRenderGraph(std::string name) const
+	{
+		return std::make_shared<RenderGraph>(*this, name);
 	}
 
 	RenderPassHandle Device::CreateRenderPass(std::string name, SwapchainHandle pSwapchain, bool depth) const
@@ -403,9 +826,14 @@ namespace sqrp
 		return std::make_shared<RenderPass>(*this, name, pSwapchain, depth);
 	}
 
-	RenderPassHandle Device::CreateRenderPass(std::string name, std::vector<SubPassInfo> subPassInfos, std::map<string, AttachmentInfo> attachmentNameToInfo) const
+	RenderPassHandle Device::CreateRenderPass(std::string name, std::vector<SubPassInfo> subPassInfos, std::map<string, AttachmentInfo> attachmentNameToInfo, std::vector<std::string> attachmentOrder) const
 	{
-		return std::make_shared<RenderPass>(*this, name, subPassInfos, attachmentNameToInfo);
+		return std::make_shared<RenderPass>(*this, name, subPassInfos, attachmentNameToInfo, attachmentOrder);
+	}
+
+	RingBufferHandle Device::CreateRingBuffer(std::string name, vk::DeviceSize frameSize, uint32_t inflightCount, vk::BufferUsageFlags usage) const
+	{
+		return std::make_shared<RingBuffer>(*this, name, frameSize, inflightCount, usage);
 	}
 
 	SemaphoreHandle Device::CreateSemaphore(std::string name) const
@@ -413,11 +841,38 @@ namespace sqrp
 		return std::make_shared<Semaphore>(*this, name);
 	}
 
+	SubmitBatchHandle Device::CreateSubmitBatch(QueueContextType type) const
+	{
+		return std::make_shared<SubmitBatch>(*this, type);
+	}
+
+	TimelineSemaphoreHandle Device::CreateTimelineSemaphore(std::string name, uint64_t initialValue) const
+	{
+		return std::make_shared<TimelineSemaphore>(*this, name, initialValue);
+	}
+
 	ShaderHandle Device::CreateShader(const Compiler& compiler, const std::string& fileName, ShaderType shaderType) const
 	{
 		return std::make_shared<Shader>(*this, compiler, fileName, shaderType);
 	}
 
+	ShaderHandle Device::CreateShader(const std::vector<uint32_t>& spirv, ShaderType shaderType) const
+	{
+		return std::make_shared<Shader>(*this, spirv, shaderType);
+	}
+
+	std::vector<ShaderHandle> Device::CreateShaders(const Compiler& compiler, const std::vector<ShaderCompileJob>& jobs) const
+	{
+		std::vector<std::vector<uint32_t>> spirvs = compiler.CompileBatch(jobs);
+
+		std::vector<ShaderHandle> shaders(jobs.size());
+		for (size_t i = 0; i < jobs.size(); i++) {
+			shaders[i] = CreateShader(spirvs[i], jobs[i].shaderType);
+		}
+
+		return shaders;
+	}
+
 	SwapchainHandle Device::CreateSwapchain(uint32_t width, uint32_t height) const
 	{
 		return std::make_shared<Swapchain>(*this, width, height);
@@ -432,10 +887,15 @@ namespace sqrp
 		FenceHandle pFence
 	) const
 	{
+		CpuProfileScope profileScope(pProfiler_.get(), "Submit");
 		auto queueContextItr = queueContexts_.find(type);
 		if (queueContextItr == queueContexts_.end()) {
 			throw std::runtime_error("Invalid QueueContextType for Submit");
 		}
+		// Pending uploads are submitted and acquired first so that the command buffer can use them
+		if (uploadManager_ && uploadManager_->GetDstQueueType() == type) {
+			uploadManager_->Flush();
+		}
 		vk::Queue queue = queueContextItr->second.queue;
 		auto commandBuffer = pCommandBuffer->GetCommandBuffer();
 
@@ -448,6 +908,7 @@ namespace sqrp
 			.setSignalSemaphoreCount(pSignalSemaphores.size())
 			.setPSignalSemaphores(pSignalSemaphores.data());
 
+		std::lock_guard<std::mutex> queueLock(*queueContextItr->second.pQueueMutex);
 		if (pFence) {
 			queue.submit(submitInfo, pFence->GetFence());
 		}
@@ -465,10 +926,14 @@ namespace sqrp
 		FenceHandle pFence
 	) const
 	{
+		CpuProfileScope profileScope(pProfiler_.get(), "Submit");
 		auto queueContextItr = queueContexts_.find(type);
 		if (queueContextItr == queueContexts_.end()) {
 			throw std::runtime_error("Invalid QueueContext for Submit");
 		}
+		if (uploadManager_ && uploadManager_->GetDstQueueType() == type) {
+			uploadManager_->Flush();
+		}
 		vk::Queue queue = queueContextItr->second.queue;
 		auto commandBuffer = pCommandBuffer->GetCommandBuffer();
 
@@ -492,6 +957,7 @@ namespace sqrp
 			submitInfo.setSignalSemaphoreCount(0);
 		}
 
+		std::lock_guard<std::mutex> queueLock(*queueContextItr->second.pQueueMutex);
 		if (pFence) {
 			queue.submit(submitInfo, pFence->GetFence());
 		}
@@ -500,12 +966,66 @@ namespace sqrp
 		}
 	}
 
+	void Device::Submit(
+		QueueContextType type,
+		const std::vector<CommandBufferHandle>& pCommandBuffers,
+		const std::vector<SubmitSemaphore>& waitSemaphores,
+		const std::vector<SubmitSemaphore>& signalSemaphores,
+		FenceHandle pFence
+	) const
+	{
+		CpuProfileScope profileScope(pProfiler_.get(), "Submit");
+		auto queueContextItr = queueContexts_.find(type);
+		if (queueContextItr == queueContexts_.end()) {
+			throw std::runtime_error("Invalid QueueContextType for Submit");
+		}
+		if (uploadManager_ && uploadManager_->GetDstQueueType() == type) {
+			uploadManager_->Flush();
+		}
+		vk::Queue queue = queueContextItr->second.queue;
+
+		std::vector<vk::CommandBuffer> commandBuffers;
+		commandBuffers.reserve(pCommandBuffers.size());
+		for (const auto& pCommandBuffer : pCommandBuffers) {
+			commandBuffers.push_back(pCommandBuffer->GetCommandBuffer());
+		}
+		std::vector<vk::Semaphore> waits;
+		std::vector<uint64_t> waitValues;
+		std::vector<vk::PipelineStageFlags> waitDstStageMasks;
+		for (const auto& waitSemaphore : waitSemaphores) {
+			waits.push_back(waitSemaphore.semaphore);
+			waitValues.push_back(waitSemaphore.value);
+			waitDstStageMasks.push_back(waitSemaphore.stageMask);
+		}
+		std::vector<vk::Semaphore> signals;
+		std::vector<uint64_t> signalValues;
+		for (const auto& signalSemaphore : signalSemaphores) {
+			signals.push_back(signalSemaphore.semaphore);
+			signalValues.push_back(signalSemaphore.value);
+		}
+
+		vk::StructureChain<vk::SubmitInfo, vk::TimelineSemaphoreSubmitInfo> submitInfoChain{
+			vk::SubmitInfo()
+			.setCommandBuffers(commandBuffers)
+			.setWaitSemaphores(waits)
+			.setWaitDstStageMask(waitDstStageMasks)
+			.setSignalSemaphores(signals),
+			vk::TimelineSemaphoreSubmitInfo()
+			.setWaitSemaphoreValues(waitValues)
+			.setSignalSemaphoreValues(signalValues)
+		};
+
+		std::lock_guard<std::mutex> queueLock(*queueContextItr->second.pQueueMutex);
+		queue.submit(submitInfoChain.get<vk::SubmitInfo>(), pFence ? pFence->GetFence() : nullptr);
+	}
+
 	void Device::WaitIdle(QueueContextType type) const
 	{
 		auto queueContextItr = queueContexts_.find(type);
 		if (queueContextItr == queueContexts_.end()) {
 			throw std::runtime_error("Invalid QueueContext for WaitIdle");
 		}
+		std::lock_guard<std::mutex> queueLock(*queueContextItr->second.pQueueMutex);
 		queueContextItr->second.queue.waitIdle();
 	}
 
@@ -535,6 +1055,39 @@ namespace sqrp
 		WaitIdle(selectedType);
 	}
 
+	std::vector<uint8_t> Device::ReadbackImage(ImageHandle pImage) const
+	{
+		vk::Extent3D extent = pImage->GetExtent3D();
+		vk::DeviceSize size = static_cast<vk::DeviceSize>(extent.width) * extent.height * extent.depth * GetFormatTexelSize(pImage->GetFormat());
+		BufferHandle readbackBuffer = CreateBuffer(
+			"readback",
+			static_cast<int>(size),
+			vk::BufferUsageFlagBits::eTransferDst,
+			VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT,
+			VMA_MEMORY_USAGE_AUTO
+		);
+
+		OneTimeSubmit([&](CommandBufferHandle pCommandBuffer) {
+			pCommandBuffer->TransitionLayout(pImage, vk::ImageLayout::eTransferSrcOptimal);
+			pCommandBuffer->CopyImageToBuffer(pImage, readbackBuffer);
+			// Completion of the submit doesn't make the writes visible to the host
+			pCommandBuffer->BufferBarrier(
+				readbackBuffer,
+				vk::PipelineStageFlagBits2::eAllTransfer, vk::AccessFlagBits2::eTransferWrite,
+				vk::PipelineStageFlagBits2::eHost, vk::AccessFlagBits2::eHostRead
+			);
+		});
+
+		std::vector<uint8_t> data(size);
+		readbackBuffer->Read(0, data.data(), data.size());
+		return data;
+	}
+
+	void Device::SetProfiler(ProfilerHandle pProfiler)
+	{
+		pProfiler_ = pProfiler;
+	}
+
 	void Device::SetObjectName(uint64_t object, vk::ObjectType objectType, const std::string& name) const
 	{
 		if (!debugMessenger_) return;
@@ -546,6 +1099,104 @@ namespace sqrp
 		device_->setDebugUtilsObjectNameEXT(nameInfo);
 	}
 
+	bool Device::SavePipelineCache() const
+	{
+		if (!pipelineCache_ || pipelineCachePath_.empty()) {
+			return false;
+		}
+
+		std::vector<uint8_t> data = device_->getPipelineCacheData(pipelineCache_.get());
+		if (data.empty()) {
+			return false;
+		}
+
+		std::error_code errorCode;
+		if (pipelineCachePath_.has_parent_path()) {
+			std::filesystem::create_directories(pipelineCachePath_.parent_path(), errorCode);
+		}
+
+		// Write to a temporary file then rename it to avoid leaving a partial cache
+		std::filesystem::path tempPath = pipelineCachePath_;
+		tempPath += ".tmp";
+		{
+			std::ofstream file(tempPath, std::ios::out | std::ios::binary | std::ios::trunc);
+			if (!file.is_open()) {
+				std::cerr << "Warning: Failed to write pipeline cache " << tempPath.string() << std::endl;
+				return false;
+			}
+			file.write(reinterpret_cast<const char*>(data.data()), data.size());
+		}
+		std::filesystem::rename(tempPath, pipelineCachePath_, errorCode);
+		if (errorCode) {
+			std::filesystem::remove(tempPath, errorCode);
+			return false;
+		}
+
+		return true;
+	}
+
+	void Device::TrackAllocation(MemoryCategory category, vk::DeviceSize size) const
+	{
+		std::lock_guard<std::mutex> lock(memoryStatsMutex_);
+		size_t index = static_cast<size_t>(category);
+		categoryBytes_[index] += size;
+		categoryPeakBytes_[index] = std::max(categoryPeakBytes_[index], categoryBytes_[index]);
+		totalBytes_ += size;
+		peakBytes_ = std::max(peakBytes_, totalBytes_);
+		allocationCount_++;
+	}
+
+	void Device::UntrackAllocation(MemoryCategory category, vk::DeviceSize size) const
+	{
+		std::lock_guard<std::mutex> lock(memoryStatsMutex_);
+		size_t index = static_cast<size_t>(category);
+		categoryBytes_[index] -= std::min(categoryBytes_[index], size);
+		totalBytes_ -= std::min(totalBytes_, size);
+		if (allocationCount_ > 0) {
+			allocationCount_--;
+		}
+	}
+
+	MemoryStats Device::GetMemoryStats() const
+	{
+		MemoryStats stats;
+		stats.isBudgetSupported = isSupportMemoryBudget_;
+
+		const VkPhysicalDeviceMemoryProperties* pMemoryProperties = nullptr;
+		vmaGetMemoryProperties(allocator_, &pMemoryProperties);
+		std::vector<VmaBudget> budgets(pMemoryProperties->memoryHeapCount);
+		vmaGetHeapBudgets(allocator_, budgets.data());
+		stats.heaps.resize(pMemoryProperties->memoryHeapCount);
+		for (uint32_t i = 0; i < pMemoryProperties->memoryHeapCount; i++) {
+			auto& heap = stats.heaps[i];
+			heap.flags = vk::MemoryHeapFlags(pMemoryProperties->memoryHeaps[i].flags);
+			heap.usage = budgets[i].usage;
+			heap.budget = budgets[i].budget;
+			heap.blockBytes = budgets[i].statistics.blockBytes;
+			heap.allocationBytes = budgets[i].statistics.allocationBytes;
+			heap.allocationCount = budgets[i].statistics.allocationCount;
+		}
+
+		std::lock_guard<std::mutex> lock(memoryStatsMutex_);
+		stats.categoryBytes = categoryBytes_;
+		stats.categoryPeakBytes = categoryPeakBytes_;
+		stats.totalBytes = totalBytes_;
+		stats.peakBytes = peakBytes_;
+		stats.allocationCount = allocationCount_;
+
+		return stats;
+	}
+
+	std::string Device::GetMemoryStatsJson(bool detailed) const
+	{
+		char* pStatsString = nullptr;
+		vmaBuildStatsString(allocator_, &pStatsString, detailed ? VK_TRUE : VK_FALSE);
+		std::string json = pStatsString ? pStatsString : "";
+		vmaFreeStatsString(allocator_, pStatsString);
+
+		return json;
+	}
+
 	VmaAllocator Device::GetAllocator() const
 	{
 		return allocator_;;
@@ -585,6 +1236,63 @@ namespace sqrp
 		return queueContextItr->second.queue;
 	}
 
+	std::unique_lock<std::mutex> Device::LockQueue(QueueContextType type) const
+	{
+		auto queueContextItr = queueContexts_.find(type);
+		if (queueContextItr == queueContexts_.end()) {
+			throw std::runtime_error("Invalid QueueContext for LockQueue");
+		}
+		return std::unique_lock<std::mutex>(*queueContextItr->second.pQueueMutex);
+	}
+
+	const vk::PhysicalDeviceFeatures& Device::GetEnabledFeatures() const
+	{
+		return enabledFeatures_;
+	}
+
+	const vk::PhysicalDeviceVulkan12Features& Device::GetEnabledVulkan12Features() const
+	{
+		return enabledVulkan12Features_;
+	}
+
+	const vk::PhysicalDeviceVulkan13Features& Device::GetEnabledVulkan13Features() const
+	{
+		return enabledVulkan13Features_;
+	}
+
+	ProfilerHandle Device::GetProfiler() const
+	{
+		return pProfiler_;
+	}
+
+	UploadManager& Device::GetUploadManager() const
+	{
+		if (!uploadManager_) {
+			throw std::runtime_error("UploadManager is not created, call Init first");
+		}
+		return *uploadManager_;
+	}
+
+	vk::PipelineCache Device::GetPipelineCache() const
+	{
+		return pipelineCache_.get();
+	}
+
+	bool Device::IsPipelineCacheWarm() const
+	{
+		return isPipelineCacheWarm_;
+	}
+
+	bool Device::IsHeadless() const
+	{
+		return isHeadless_;
+	}
+
+	bool Device::IsMemoryBudgetSupported() const
+	{
+		return isSupportMemoryBudget_;
+	}
+
 	/*uint32_t Device::GetGraphicsQueueFamilyIndex() const
 	{
 		return graphicsQueueFamilyIndex_;
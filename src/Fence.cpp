@@ -37,6 +37,15 @@ namespace sqrp
 		}
 	}
 
+	bool Fence::IsSignaled() const
+	{
+		auto result = pDevice_->GetDevice().getFenceStatus(fence_.get());
+		if (result != vk::Result::eSuccess && result != vk::Result::eNotReady) {
+			throw std::runtime_error("Failed to get fence status");
+		}
+		return result == vk::Result::eSuccess;
+	}
+
 	void Fence::Reset()
 	{
 		pDevice_->GetDevice().resetFences(fence_.get());
@@ -0,0 +1,191 @@
+#include "FrameCapture.hpp"
+
+#include "Buffer.hpp"
+#include "CommandBuffer.hpp"
+#include "Device.hpp"
+#include "Image.hpp"
+#include "Swapchain.hpp"
+#include "TimelineSemaphore.hpp"
+
+#include <stb_image_write.h>
+
+using namespace std;
+
+namespace sqrp
+{
+	bool WriteCapturePNG(const CaptureResult& result, const std::string& path)
+	{
+		bool isBGRA = result.format == vk::Format::eB8G8R8A8Unorm || result.format == vk::Format::eB8G8R8A8Srgb;
+		bool isRGBA = result.format == vk::Format::eR8G8B8A8Unorm || result.format == vk::Format::eR8G8B8A8Srgb;
+		if (!isBGRA && !isRGBA) {
+			cerr << "Warning: " << vk::to_string(result.format) << " can't be written to PNG" << endl;
+			return false;
+		}
+
+		std::vector<uint8_t> pixels = result.pixels;
+		if (isBGRA) {
+			for (size_t i = 0; i + 3 < pixels.size(); i += 4) {
+				std::swap(pixels[i], pixels[i + 2]);
+			}
+		}
+		return stbi_write_png(path.c_str(), result.width, result.height, 4, pixels.data(), result.width * 4) != 0;
+	}
+
+	FrameCapture::FrameCapture(const Device& device, std::string name, uint32_t slotCount)
+		: pDevice_(&device), name_(name)
+	{
+		if (slotCount == 0) {
+			throw std::runtime_error("FrameCapture requires at least one slot");
+		}
+		slots_.resize(slotCount);
+	}
+
+	FrameCapture::Slot* FrameCapture::AcquireSlot(vk::DeviceSize size)
+	{
+		for (uint32_t i = 0; i < slots_.size(); i++) {
+			auto& slot = slots_[i];
+			if (slot.isPending) {
+				continue;
+			}
+			// Grows only, the largest capture so far is kept
+			if (!slot.pBuffer || slot.pBuffer->GetSize() < size) {
+				slot.pBuffer = pDevice_->CreateBuffer(
+					name_ + "Readback" + to_string(i),
+					static_cast<int>(size),
+					vk::BufferUsageFlagBits::eTransferDst,
+					VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT,
+					VMA_MEMORY_USAGE_AUTO
+				);
+			}
+			return &slot;
+		}
+
+		cerr << "Warning: All slots of FrameCapture " << name_ << " are pending, the capture is dropped" << endl;
+		return nullptr;
+	}
+
+	CaptureResult FrameCapture::ReadSlot(Slot& slot)
+	{
+		CaptureResult result;
+		result.captureId = slot.captureId;
+		result.width = slot.width;
+		result.height = slot.height;
+		result.format = slot.format;
+		result.pixels.resize(static_cast<size_t>(slot.width) * slot.height * GetFormatTexelSize(slot.format));
+		slot.pBuffer->Read(0, result.pixels.data(), result.pixels.size());
+
+		slot.isPending = false;
+		slot.pTimeline = nullptr;
+		return result;
+	}
+
+	uint64_t FrameCapture::Capture(CommandBufferHandle pCommandBuffer, ImageHandle pImage, TimelineSemaphoreHandle pTimeline, uint64_t completeValue)
+	{
+		vk::Extent3D extent = pImage->GetExtent3D();
+		Slot* pSlot = AcquireSlot(static_cast<vk::DeviceSize>(extent.width) * extent.height * GetFormatTexelSize(pImage->GetFormat()));
+		if (!pSlot) {
+			return 0;
+		}
+
+		pCommandBuffer->TransitionLayout(pImage, vk::ImageLayout::eTransferSrcOptimal);
+		pCommandBuffer->CopyImageToBuffer(pImage, pSlot->pBuffer);
+		// Host reads after the timeline wait
+		pCommandBuffer->BufferBarrier(
+			pSlot->pBuffer,
+			vk::PipelineStageFlagBits2::eAllTransfer, vk::AccessFlagBits2::eTransferWrite,
+			vk::PipelineStageFlagBits2::eHost, vk::AccessFlagBits2::eHostRead
+		);
+
+		pSlot->pTimeline = pTimeline;
+		pSlot->completeValue = completeValue;
+		pSlot->captureId = ++lastCaptureId_;
+		pSlot->width = extent.width;
+		pSlot->height = extent.height;
+		pSlot->format = pImage->GetFormat();
+		pSlot->isPending = true;
+		return pSlot->captureId;
+	}
+
+	uint64_t FrameCapture::Capture(CommandBufferHandle pCommandBuffer, SwapchainHandle pSwapchain)
+	{
+		if (!(pSwapchain->GetImageUsage() & vk::ImageUsageFlagBits::eTransferSrc)) {
+			throw std::runtime_error("Swapchain images can't be captured, the surface doesn't support eTransferSrc");
+		}
+
+		vk::Format format = pSwapchain->GetSurfaceFormat();
+		Slot* pSlot = AcquireSlot(static_cast<vk::DeviceSize>(pSwapchain->GetWidth()) * pSwapchain->GetHeight() * GetFormatTexelSize(format));
+		if (!pSlot) {
+			return 0;
+		}
+
+		vk::Image image = pSwapchain->GetCurrentImage();
+		// ePresentSrcKHR has no access to wait for, so the color writes are made available first
+		pCommandBuffer->GlobalBarrier(
+			vk::PipelineStageFlagBits2::eColorAttachmentOutput, vk::AccessFlagBits2::eColorAttachmentWrite,
+			vk::PipelineStageFlagBits2::eColorAttachmentOutput, vk::AccessFlagBits2::eNone
+		);
+		pCommandBuffer->FlushBarriers();
+		pCommandBuffer->TransitionLayout(image, vk::ImageLayout::ePresentSrcKHR, vk::ImageLayout::eTransferSrcOptimal);
+		pCommandBuffer->FlushBarriers();
+
+		vk::BufferImageCopy region = vk::BufferImageCopy{}
+			.setImageSubresource(
+				vk::ImageSubresourceLayers()
+				.setAspectMask(vk::ImageAspectFlagBits::eColor)
+				.setMipLevel(0)
+				.setBaseArrayLayer(0)
+				.setLayerCount(1)
+			)
+			.setImageExtent(vk::Extent3D{ pSwapchain->GetWidth(), pSwapchain->GetHeight(), 1 });
+		pCommandBuffer->GetCommandBuffer().copyImageToBuffer(image, vk::ImageLayout::eTransferSrcOptimal, pSlot->pBuffer->GetBuffer(), { region });
+
+		pCommandBuffer->TransitionLayout(image, vk::ImageLayout::eTransferSrcOptimal, vk::ImageLayout::ePresentSrcKHR);
+		pCommandBuffer->BufferBarrier(
+			pSlot->pBuffer,
+			vk::PipelineStageFlagBits2::eAllTransfer, vk::AccessFlagBits2::eTransferWrite,
+			vk::PipelineStageFlagBits2::eHost, vk::AccessFlagBits2::eHostRead
+		);
+
+		pSlot->pTimeline = pSwapchain->GetFrameTimeline();
+		pSlot->completeValue = pSwapchain->GetCurrentFrameValue();
+		pSlot->captureId = ++lastCaptureId_;
+		pSlot->width = pSwapchain->GetWidth();
+		pSlot->height = pSwapchain->GetHeight();
+		pSlot->format = format;
+		pSlot->isPending = true;
+		return pSlot->captureId;
+	}
+
+	std::vector<CaptureResult> FrameCapture::Poll()
+	{
+		std::vector<CaptureResult> results;
+		for (auto& slot : slots_) {
+			if (slot.isPending && slot.pTimeline->IsCompleted(slot.completeValue)) {
+				results.push_back(ReadSlot(slot));
+			}
+		}
+		std::sort(results.begin(), results.end(), [](const CaptureResult& a, const CaptureResult& b) { return a.captureId < b.captureId; });
+		return results;
+	}
+
+	std::vector<CaptureResult> FrameCapture::WaitAll()
+	{
+		for (auto& slot : slots_) {
+			if (slot.isPending) {
+				slot.pTimeline->Wait(slot.completeValue);
+			}
+		}
+		return Poll();
+	}
+
+	uint32_t FrameCapture::GetPendingCount() const
+	{
+		uint32_t count = 0;
+		for (const auto& slot : slots_) {
+			if (slot.isPending) {
+				count++;
+			}
+		}
+		return count;
+	}
+}
\ No newline at end of file
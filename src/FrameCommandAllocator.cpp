@@ -0,0 +1,79 @@
+#include "FrameCommandAllocator.hpp"
+
+#include "CommandBuffer.hpp"
+
+using namespace std;
+
+namespace sqrp
+{
+	FrameCommandAllocator::FrameCommandAllocator(const Device& device, std::string name, uint32_t inflightCount, QueueContextType queueType)
+		: pDevice_(&device), name_(name), queueType_(queueType)
+	{
+		auto queueContextItr = pDevice_->GetQueueContexts().find(queueType_);
+		if (queueContextItr == pDevice_->GetQueueContexts().end()) {
+			throw std::runtime_error("No such queue context type for FrameCommandAllocator");
+		}
+
+		// No eResetCommandBuffer, command buffers are only reset with the pool
+		frames_.resize(std::max(1u, inflightCount));
+		for (uint32_t i = 0; i < frames_.size(); i++) {
+			frames_[i].commandPool = pDevice_->GetDevice().createCommandPoolUnique(
+				vk::CommandPoolCreateInfo()
+				.setFlags(vk::CommandPoolCreateFlagBits::eTransient)
+				.setQueueFamilyIndex(queueContextItr->second.queueFamilyIndex)
+			);
+			pDevice_->SetObjectName(
+				(uint64_t)(VkCommandPool)(frames_[i].commandPool.get()),
+				vk::ObjectType::eCommandPool,
+				name_ + "_CommandPool" + to_string(i)
+			);
+		}
+	}
+
+	void FrameCommandAllocator::BeginFrame(uint32_t inflightIndex)
+	{
+		inflightIndex_ = inflightIndex % frames_.size();
+		Frame& frame = frames_[inflightIndex_];
+		pDevice_->GetDevice().resetCommandPool(frame.commandPool.get());
+		frame.usedPrimaryCount = 0;
+		frame.usedSecondaryCount = 0;
+	}
+
+	CommandBufferHandle FrameCommandAllocator::Allocate(vk::CommandBufferLevel level)
+	{
+		Frame& frame = frames_[inflightIndex_];
+		bool isPrimary = level == vk::CommandBufferLevel::ePrimary;
+		auto& pCommandBuffers = isPrimary ? frame.pPrimaryCommandBuffers : frame.pSecondaryCommandBuffers;
+		uint32_t& usedCount = isPrimary ? frame.usedPrimaryCount : frame.usedSecondaryCount;
+		if (usedCount == pCommandBuffers.size()) {
+			pCommandBuffers.push_back(std::make_shared<CommandBuffer>(
+				*pDevice_,
+				name_ + (isPrimary ? "_primary" : "_secondary") + to_string(usedCount),
+				frame.commandPool.get(),
+				level,
+				queueType_
+			));
+		}
+		return pCommandBuffers[usedCount++];
+	}
+
+	uint32_t FrameCommandAllocator::GetInflightCount() const
+	{
+		return static_cast<uint32_t>(frames_.size());
+	}
+
+	uint32_t FrameCommandAllocator::GetCurrentInflightIndex() const
+	{
+		return inflightIndex_;
+	}
+
+	uint32_t FrameCommandAllocator::GetAllocatedCount() const
+	{
+		return frames_[inflightIndex_].usedPrimaryCount + frames_[inflightIndex_].usedSecondaryCount;
+	}
+
+	QueueContextType FrameCommandAllocator::GetQueueType() const
+	{
+		return queueType_;
+	}
+}
\ No newline at end of file
@@ -2,6 +2,7 @@
 
 #include "CommandBuffer.hpp"
 #include "Device.hpp"
+#include "Profiler.hpp"
 #include "RenderPass.hpp"
 #include "Swapchain.hpp"
 
@@ -57,7 +58,7 @@ namespace sqrp
 		}
 		initInfo.QueueFamily = queueContextItr->second.queueFamilyIndex;
 		initInfo.Queue = queueContextItr->second.queue;
-		initInfo.PipelineCache = nullptr;
+		initInfo.PipelineCache = pDevice_->GetPipelineCache();
 		initInfo.DescriptorPool = imguiDescPool_.get();
 		initInfo.MinImageCount = minImageCount;
 		initInfo.ImageCount = imageCount;
@@ -94,6 +95,83 @@ namespace sqrp
 		ImGui::NewFrame();
 	}
 
+	void GUI::DrawProfiler(const Profiler& profiler)
+	{
+		ImGui::Begin("Profiler");
+		if (!profiler.IsGpuEnabled()) {
+			ImGui::TextUnformatted("GPU timestamps are not supported");
+		}
+		if (ImGui::BeginTable("ProfileStats", 5, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) {
+			ImGui::TableSetupColumn("Scope");
+			ImGui::TableSetupColumn("");
+			ImGui::TableSetupColumn("min (ms)");
+			ImGui::TableSetupColumn("avg (ms)");
+			ImGui::TableSetupColumn("p99 (ms)");
+			ImGui::TableHeadersRow();
+			for (const auto& stat : profiler.GetStats()) {
+				ImGui::TableNextRow();
+				ImGui::TableNextColumn();
+				ImGui::TextUnformatted(stat.name.c_str());
+				ImGui::TableNextColumn();
+				ImGui::TextUnformatted(stat.isGpu ? "GPU" : "CPU");
+				ImGui::TableNextColumn();
+				ImGui::Text("%.3f", stat.minMs);
+				ImGui::TableNextColumn();
+				ImGui::Text("%.3f", stat.avgMs);
+				ImGui::TableNextColumn();
+				ImGui::Text("%.3f", stat.p99Ms);
+			}
+			ImGui::EndTable();
+		}
+		ImGui::End();
+	}
+
+	void GUI::DrawMemoryStats(const MemoryStats& stats)
+	{
+		constexpr double MiB = 1024.0 * 1024.0;
+		ImGui::Begin("Memory");
+		if (!stats.isBudgetSupported) {
+			ImGui::TextUnformatted("Budgets are estimated, VK_EXT_memory_budget is not supported");
+		}
+		if (ImGui::BeginTable("MemoryHeaps", 4, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) {
+			ImGui::TableSetupColumn("Heap");
+			ImGui::TableSetupColumn("");
+			ImGui::TableSetupColumn("usage (MiB)");
+			ImGui::TableSetupColumn("budget (MiB)");
+			ImGui::TableHeadersRow();
+			for (size_t i = 0; i < stats.heaps.size(); i++) {
+				ImGui::TableNextRow();
+				ImGui::TableNextColumn();
+				ImGui::Text("%zu", i);
+				ImGui::TableNextColumn();
+				ImGui::TextUnformatted((stats.heaps[i].flags & vk::MemoryHeapFlagBits::eDeviceLocal) ? "Device" : "Host");
+				ImGui::TableNextColumn();
+				ImGui::Text("%.1f", stats.heaps[i].usage / MiB);
+				ImGui::TableNextColumn();
+				ImGui::Text("%.1f", stats.heaps[i].budget / MiB);
+			}
+			ImGui::EndTable();
+		}
+		if (ImGui::BeginTable("MemoryCategories", 3, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) {
+			ImGui::TableSetupColumn("Category");
+			ImGui::TableSetupColumn("current (MiB)");
+			ImGui::TableSetupColumn("peak (MiB)");
+			ImGui::TableHeadersRow();
+			for (size_t i = 0; i < stats.categoryBytes.size(); i++) {
+				ImGui::TableNextRow();
+				ImGui::TableNextColumn();
+				ImGui::TextUnformatted(GetMemoryCategoryName(static_cast<MemoryCategory>(i)));
+				ImGui::TableNextColumn();
+				ImGui::Text("%.1f", stats.categoryBytes[i] / MiB);
+				ImGui::TableNextColumn();
+				ImGui::Text("%.1f", stats.categoryPeakBytes[i] / MiB);
+			}
+			ImGui::EndTable();
+		}
+		ImGui::Text("Total %.1f MiB, peak %.1f MiB, %u allocations", stats.totalBytes / MiB, stats.peakBytes / MiB, stats.allocationCount);
+		ImGui::End();
+	}
+
 	vk::DescriptorPool GUI::GetImguiDescPool() const
 	{
 		return imguiDescPool_.get();
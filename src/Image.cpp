@@ -4,8 +4,48 @@
 
 using namespace std;
 
+namespace
+{
+	sqrp::MemoryCategory GetImageMemoryCategory(vk::ImageUsageFlags usage)
+	{
+		vk::ImageUsageFlags attachmentUsage = vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eDepthStencilAttachment | vk::ImageUsageFlagBits::eTransientAttachment;
+		return (usage & attachmentUsage) ? sqrp::MemoryCategory::Attachment : sqrp::MemoryCategory::Texture;
+	}
+}
+
 namespace sqrp
 {
+	uint32_t GetFormatTexelSize(vk::Format format)
+	{
+		switch (format) {
+		case vk::Format::eR8Unorm:
+		case vk::Format::eR8Uint:
+			return 1;
+		case vk::Format::eR8G8Unorm:
+		case vk::Format::eR16Sfloat:
+		case vk::Format::eD16Unorm:
+			return 2;
+		case vk::Format::eR8G8B8A8Unorm:
+		case vk::Format::eR8G8B8A8Srgb:
+		case vk::Format::eB8G8R8A8Unorm:
+		case vk::Format::eB8G8R8A8Srgb:
+		case vk::Format::eA2B10G10R10UnormPack32:
+		case vk::Format::eB10G11R11UfloatPack32:
+		case vk::Format::eR16G16Sfloat:
+		case vk::Format::eR32Sfloat:
+		case vk::Format::eR32Uint:
+		case vk::Format::eD32Sfloat:
+			return 4;
+		case vk::Format::eR16G16B16A16Sfloat:
+		case vk::Format::eR32G32Sfloat:
+			return 8;
+		case vk::Format::eR32G32B32A32Sfloat:
+			return 16;
+		default:
+			throw std::runtime_error("Unsupported format for readback : " + vk::to_string(format));
+		}
+	}
+
 	int Image::imageIdCounter_ = 0;
 
 	Image::Image(
@@ -48,6 +88,8 @@ namespace sqrp
 			throw std::runtime_error("Failed to create image!");
 		}
 		image_ = vk::Image(image);
+		memoryCategory_ = GetImageMemoryCategory(usage);
+		TrackAllocation();
 
 		pDevice_->SetObjectName((uint64_t)(VkImage)image_, vk::ObjectType::eImage, name + "Image");
 
@@ -87,28 +129,17 @@ namespace sqrp
 		std::string name,
 		vk::ImageCreateInfo imageCreateInfo,
 		vk::ImageAspectFlags aspectFlags,
-		vk::SamplerCreateInfo samplerCreateInfo
+		vk::SamplerCreateInfo samplerCreateInfo,
+		ImageMemoryType memoryType
 	)
-		: pDevice_(&device), name_(name), aspectFlags_(aspectFlags)
+		: pDevice_(&device), name_(name), aspectFlags_(aspectFlags), memoryType_(memoryType)
 	{
 		imageId_ = imageIdCounter_;
 		imageIdCounter_++;
 
-		imageLayout_ = imageCreateInfo.initialLayout;
-
-		VmaAllocationCreateInfo allocCreateInfo{};
-		allocCreateInfo.usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE;
-
 		imageCreateInfo_ = imageCreateInfo;
-		VkImage image;
-		if (vmaCreateImage(pDevice_->GetAllocator(), reinterpret_cast<VkImageCreateInfo*>(&imageCreateInfo_), &allocCreateInfo, &image, &allocation_, &allocationInfo_) != VK_SUCCESS) {
-			throw std::runtime_error("Failed to create image!");
-		}
-		image_ = vk::Image(image);
-
-		pDevice_->SetObjectName((uint64_t)(VkImage)image_, vk::ObjectType::eImage, name + "Image");
+		CreateImage();
 
-		imageViewCreateInfo_.setImage(image_);
 		imageViewCreateInfo_.setFormat(imageCreateInfo_.format);
 		if (imageCreateInfo_.imageType == vk::ImageType::e1D) {
 			imageViewCreateInfo_.setViewType(vk::ImageViewType::e1D);
@@ -131,15 +162,10 @@ namespace sqrp
 			.setLayerCount(imageCreateInfo_.arrayLayers)
 		);
 
-		imageView_ = pDevice_->GetDevice().createImageView(imageViewCreateInfo_);
-		pDevice_->SetObjectName((uint64_t)(VkImageView)imageView_, vk::ObjectType::eImageView, name + "ImageView");
-
 		if (imageCreateInfo_.mipLevels > 1) {
 			mipImageViewCreateInfos_.resize(imageCreateInfo_.mipLevels);
-			mipImageView_.resize(imageCreateInfo_.mipLevels);
 			for (uint32_t i = 0; i < imageCreateInfo_.mipLevels; i++) {
 				vk::ImageViewCreateInfo mipViewCreateInfo{};
-				mipViewCreateInfo.setImage(image_);
 				mipViewCreateInfo.setFormat(imageCreateInfo_.format);
 				if (imageCreateInfo_.imageType == vk::ImageType::e2D) {
 					mipViewCreateInfo.setViewType(vk::ImageViewType::e2D);
@@ -162,10 +188,12 @@ namespace sqrp
 					.setLayerCount(imageCreateInfo.arrayLayers)
 				);
 				mipImageViewCreateInfos_[i] = mipViewCreateInfo;
-				mipImageView_[i] = pDevice_->GetDevice().createImageView(mipViewCreateInfo);
-				pDevice_->SetObjectName((uint64_t)(VkImageView)mipImageView_[i], vk::ObjectType::eImageView, name + "MipImageView_" + to_string(i));
 			}
 		}
+		// Views of aliased images are created by BindMemory
+		if (isMemoryBound_) {
+			CreateViews();
+		}
 
 		samplerCreateInfo_ = samplerCreateInfo;
 		sampler_ = pDevice_->GetDevice().createSampler(samplerCreateInfo);
@@ -177,21 +205,81 @@ namespace sqrp
 		Destroy();
 	}
 
+	void Image::CreateImage()
+	{
+		memoryCategory_ = GetImageMemoryCategory(imageCreateInfo_.usage);
+		if (memoryType_ == ImageMemoryType::Aliased) {
+			image_ = pDevice_->GetDevice().createImage(imageCreateInfo_);
+			allocation_ = nullptr;
+			isMemoryBound_ = false;
+		}
+		else {
+			VmaAllocationCreateInfo allocCreateInfo{};
+			allocCreateInfo.usage = memoryType_ == ImageMemoryType::LazilyAllocated ? VMA_MEMORY_USAGE_GPU_LAZILY_ALLOCATED : VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE;
+
+			VkImage image;
+			if (vmaCreateImage(pDevice_->GetAllocator(), reinterpret_cast<VkImageCreateInfo*>(&imageCreateInfo_), &allocCreateInfo, &image, &allocation_, &allocationInfo_) != VK_SUCCESS) {
+				throw std::runtime_error("Failed to create image!");
+			}
+			image_ = vk::Image(image);
+			isMemoryBound_ = true;
+			TrackAllocation();
+		}
+		imageLayout_ = imageCreateInfo_.initialLayout;
+
+		pDevice_->SetObjectName((uint64_t)(VkImage)image_, vk::ObjectType::eImage, name_ + "Image");
+	}
+
+	void Image::CreateViews()
+	{
+		imageViewCreateInfo_.setImage(image_);
+		imageView_ = pDevice_->GetDevice().createImageView(imageViewCreateInfo_);
+		pDevice_->SetObjectName((uint64_t)(VkImageView)imageView_, vk::ObjectType::eImageView, name_ + "ImageView");
+
+		mipImageView_.resize(mipImageViewCreateInfos_.size());
+		for (uint32_t i = 0; i < mipImageViewCreateInfos_.size(); i++) {
+			mipImageViewCreateInfos_[i].setImage(image_);
+			mipImageView_[i] = pDevice_->GetDevice().createImageView(mipImageViewCreateInfos_[i]);
+			pDevice_->SetObjectName((uint64_t)(VkImageView)mipImageView_[i], vk::ObjectType::eImageView, name_ + "MipImageView_" + to_string(i));
+		}
+	}
+
+	void Image::TrackAllocation()
+	{
+		pDevice_->TrackAllocation(memoryCategory_, allocationInfo_.size);
+		vmaSetAllocationName(pDevice_->GetAllocator(), allocation_, (name_ + "Image").c_str());
+	}
+
 	void Image::Destroy()
 	{
 		if (imageView_) {
 			pDevice_->GetDevice().destroyImageView(imageView_);
+			imageView_ = nullptr;
 		}
 		if (sampler_) {
 			pDevice_->GetDevice().destroySampler(sampler_);
+			sampler_ = nullptr;
 		}
-		if (mipImageView_.size() > 0) {
-			for (auto& mipView : mipImageView_) {
-				pDevice_->GetDevice().destroyImageView(mipView);
-			}
+		for (auto& mipView : mipImageView_) {
+			pDevice_->GetDevice().destroyImageView(mipView);
 		}
+		mipImageView_.clear();
 
-		vmaDestroyImage(pDevice_->GetAllocator(), image_, allocation_);
+		if (memoryType_ == ImageMemoryType::Aliased) {
+			// The memory is owned by the one who bound it
+			if (image_) {
+				pDevice_->GetDevice().destroyImage(image_);
+			}
+		}
+		else {
+			if (allocation_) {
+				pDevice_->UntrackAllocation(memoryCategory_, allocationInfo_.size);
+			}
+			vmaDestroyImage(pDevice_->GetAllocator(), image_, allocation_);
+		}
+		image_ = nullptr;
+		allocation_ = nullptr;
+		isMemoryBound_ = false;
 	}
 
 	void Image::Recreate(uint32_t width, uint32_t height)
@@ -205,35 +293,48 @@ namespace sqrp
 				imageCreateInfo_.extent.depth
 			}
 		);
+		CreateImage();
+		if (isMemoryBound_) {
+			CreateViews();
+		}
 
-		VmaAllocationCreateInfo allocCreateInfo{};
-		allocCreateInfo.usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE;
+		sampler_ = pDevice_->GetDevice().createSampler(samplerCreateInfo_);
+		pDevice_->SetObjectName((uint64_t)(VkSampler)sampler_, vk::ObjectType::eSampler, name_ + "Sampler");
+	}
 
-		VkImage image;
-		if (vmaCreateImage(pDevice_->GetAllocator(), reinterpret_cast<VkImageCreateInfo*>(&imageCreateInfo_), &allocCreateInfo, &image, &allocation_, &allocationInfo_) != VK_SUCCESS) {
-			throw std::runtime_error("Failed to create image!");
+	void Image::BindMemory(VmaAllocation allocation, vk::DeviceSize offset)
+	{
+		if (memoryType_ != ImageMemoryType::Aliased) {
+			throw std::runtime_error("BindMemory requires an aliased image");
 		}
-		image_ = vk::Image(image);
-
-		pDevice_->SetObjectName((uint64_t)(VkImage)image_, vk::ObjectType::eImage, name_ + "Image");
+		if (isMemoryBound_) {
+			throw std::runtime_error("Image " + name_ + " is already bound, Recreate it to bind again");
+		}
+		if (vmaBindImageMemory2(pDevice_->GetAllocator(), allocation, offset, image_, nullptr) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to bind image memory!");
+		}
+		isMemoryBound_ = true;
+		CreateViews();
+	}
 
-		imageViewCreateInfo_.setImage(image_);
+	vk::MemoryRequirements Image::GetMemoryRequirements() const
+	{
+		return pDevice_->GetDevice().getImageMemoryRequirements(image_);
+	}
 
-		imageView_ = pDevice_->GetDevice().createImageView(imageViewCreateInfo_);
-		pDevice_->SetObjectName((uint64_t)(VkImageView)imageView_, vk::ObjectType::eImageView, name_ + "ImageView");
+	ImageMemoryType Image::GetMemoryType() const
+	{
+		return memoryType_;
+	}
 
-		if (imageCreateInfo_.mipLevels > 1) {
-			mipImageView_.resize(imageCreateInfo_.mipLevels);
-			for (uint32_t i = 0; i < imageCreateInfo_.mipLevels; i++) {
-				vk::ImageViewCreateInfo mipViewCreateInfo{};
-				mipViewCreateInfo.setImage(image_);
-				mipImageView_[i] = pDevice_->GetDevice().createImageView(mipViewCreateInfo);
-				pDevice_->SetObjectName((uint64_t)(VkImageView)mipImageView_[i], vk::ObjectType::eImageView, name_ + "MipImageView_" + to_string(i));
-			}
-		}
+	MemoryCategory Image::GetMemoryCategory() const
+	{
+		return memoryCategory_;
+	}
 
-		sampler_ = pDevice_->GetDevice().createSampler(samplerCreateInfo_);
-		pDevice_->SetObjectName((uint64_t)(VkSampler)sampler_, vk::ObjectType::eSampler, name_ + "Sampler");
+	bool Image::IsMemoryBound() const
+	{
+		return isMemoryBound_;
 	}
 
 	vk::Image Image::GetImage() const
@@ -1,8 +1,9 @@
 #include "Mesh.hpp"
 
 #include "Buffer.hpp"
-#include "CommandBuffer.hpp"
 #include "Device.hpp"
+#include "TraceRecorder.hpp"
+#include "UploadManager.hpp"
 
 using namespace std;
 using namespace glm;
@@ -23,21 +24,6 @@ namespace sqrp
 
 	bool MeshBase::CreateVertexBuffer()
 	{
-		BufferHandle vertexStagingBuffer;
-		vertexStagingBuffer = pDevice_->CreateBuffer(
-			name_ + "_vertexstaging",
-			sizeof(Vertex) * vertices_.size(),
-			vk::BufferUsageFlagBits::eTransferSrc,
-			VmaAllocationCreateFlagBits::VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT,
-			VmaMemoryUsage::VMA_MEMORY_USAGE_AUTO_PREFER_HOST
-		);
-		void* rawPtr = vertexStagingBuffer->Map();
-		if (rawPtr) {
-			Vertex* pVertex = static_cast<Vertex*>(rawPtr);
-			memcpy(pVertex, vertices_.data(), sizeof(Vertex) * vertices_.size());
-			vertexStagingBuffer->Unmap();
-		}
-
 		vertexBuffer_ = pDevice_->CreateBuffer(
 			name_ + "_vertex",
 			sizeof(Vertex) * vertices_.size(),
@@ -46,30 +32,14 @@ namespace sqrp
 			VmaMemoryUsage::VMA_MEMORY_USAGE_GPU_ONLY
 		);
 
-		pDevice_->OneTimeSubmit([&](CommandBufferHandle pCommandBuffer) {
-			pCommandBuffer->CopyBuffer(vertexStagingBuffer, vertexBuffer_);
-		});
+		// Usable by the next submit on the rendering queue
+		pDevice_->GetUploadManager().UploadBuffer(vertexBuffer_, vertices_.data(), sizeof(Vertex) * vertices_.size());
 
 		return true;
 	}
 
 	bool MeshBase::CreateIndexBuffer()
 	{
-		BufferHandle indexStagingBuffer;
-		indexStagingBuffer = pDevice_->CreateBuffer(
-			name_ + "_indexstaging",
-			sizeof(uint32_t) * indices_.size(),
-			vk::BufferUsageFlagBits::eTransferSrc,
-			VmaAllocationCreateFlagBits::VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT,
-			VmaMemoryUsage::VMA_MEMORY_USAGE_AUTO_PREFER_HOST
-		);
-		void* rawPtr = indexStagingBuffer->Map();
-		if (rawPtr) {
-			uint32_t* pIndex = static_cast<uint32_t*>(rawPtr);
-			memcpy(pIndex, indices_.data(), sizeof(uint32_t) * indices_.size());
-			indexStagingBuffer->Unmap();
-		}
-
 		indexBuffer_ = pDevice_->CreateBuffer(
 			name_ + "_index",
 			sizeof(uint32_t) * indices_.size(),
@@ -77,9 +47,7 @@ namespace sqrp
 			0,
 			VmaMemoryUsage::VMA_MEMORY_USAGE_GPU_ONLY
 		);
-		pDevice_->OneTimeSubmit([&](CommandBufferHandle pCommandBuffer) {
-			pCommandBuffer->CopyBuffer(indexStagingBuffer, indexBuffer_);
-		});
+		pDevice_->GetUploadManager().UploadBuffer(indexBuffer_, indices_.data(), sizeof(uint32_t) * indices_.size());
 
 		return true;
 	}
@@ -106,6 +74,7 @@ namespace sqrp
 
 	bool Mesh::LoadModel(std::string modelPath)
 	{
+		TraceScope traceScope("LoadMesh", "startup");
 		tinygltf::Model model;
 		tinygltf::TinyGLTF loader;
 		string err, warn;
@@ -190,6 +159,7 @@ namespace sqrp
 
 	bool GLTFMesh::LoadModel(std::string modelPath)
 	{
+		TraceScope traceScope("LoadMesh", "startup");
 		tinygltf::Model model;
 		tinygltf::TinyGLTF loader;
 		string err, warn;
@@ -0,0 +1,106 @@
+#include "ParallelRecorder.hpp"
+
+#include "CommandBuffer.hpp"
+#include "TraceRecorder.hpp"
+
+using namespace std;
+
+namespace sqrp
+{
+	ParallelRecorder::ParallelRecorder(const Device& device, std::string name, uint32_t inflightCount, uint32_t threadCount, QueueContextType queueType)
+		: pDevice_(&device), name_(name), queueType_(queueType)
+	{
+		if (threadCount == 0) {
+			threadCount = std::max(1u, std::thread::hardware_concurrency());
+		}
+		threadCount_ = threadCount;
+
+		pCommandAllocators_.resize(threadCount_);
+		for (uint32_t threadIndex = 0; threadIndex < threadCount_; threadIndex++) {
+			pCommandAllocators_[threadIndex] = pDevice_->CreateFrameCommandAllocator(name_ + to_string(threadIndex), inflightCount, queueType_);
+		}
+
+		if (threadCount_ > 1) {
+			threadPool_ = std::make_unique<ThreadPool>(threadCount_ - 1);
+		}
+	}
+
+	ParallelRecorder::~ParallelRecorder()
+	{
+		threadPool_.reset();
+	}
+
+	void ParallelRecorder::BeginFrame(uint32_t inflightIndex)
+	{
+		inflightIndex_ = inflightIndex;
+		for (auto& pCommandAllocator : pCommandAllocators_) {
+			pCommandAllocator->BeginFrame(inflightIndex);
+		}
+	}
+
+	std::vector<CommandBufferHandle> ParallelRecorder::Record(
+		RenderPassHandle pRenderPass,
+		uint32_t subpass,
+		FrameBufferHandle pFrameBuffer,
+		uint32_t drawCount,
+		const RecordFunction& recordFunction,
+		uint32_t minDrawsPerThread
+	)
+	{
+		if (drawCount == 0) {
+			return {};
+		}
+		minDrawsPerThread = std::max(1u, minDrawsPerThread);
+		uint32_t jobCount = std::min(threadCount_, (drawCount + minDrawsPerThread - 1) / minDrawsPerThread);
+
+		// Command buffers are allocated on this thread, each job only records into its own
+		std::vector<CommandBufferHandle> pCommandBuffers(jobCount);
+		for (uint32_t jobIndex = 0; jobIndex < jobCount; jobIndex++) {
+			pCommandBuffers[jobIndex] = pCommandAllocators_[jobIndex]->Allocate(vk::CommandBufferLevel::eSecondary);
+		}
+
+		auto recordJob = [&, drawCount, jobCount](uint32_t jobIndex) {
+			uint32_t begin = static_cast<uint32_t>(static_cast<uint64_t>(drawCount) * jobIndex / jobCount);
+			uint32_t end = static_cast<uint32_t>(static_cast<uint64_t>(drawCount) * (jobIndex + 1) / jobCount);
+			const auto& pCommandBuffer = pCommandBuffers[jobIndex];
+			TraceScope traceScope("RecordJob");
+			pCommandBuffer->BeginSecondary(pRenderPass, subpass, pFrameBuffer, inflightIndex_);
+			recordFunction(pCommandBuffer, begin, end);
+			pCommandBuffer->End();
+		};
+
+		std::vector<std::future<void>> futures;
+		futures.reserve(jobCount);
+		for (uint32_t jobIndex = 1; jobIndex < jobCount; jobIndex++) {
+			futures.push_back(threadPool_->Enqueue([&recordJob, jobIndex]() { recordJob(jobIndex); }));
+		}
+		// NOTE : Workers reference the locals, so all of them are joined before an exception leaves this function
+		std::exception_ptr exception;
+		try {
+			recordJob(0);
+		}
+		catch (...) {
+			exception = std::current_exception();
+		}
+		for (auto& future : futures) {
+			try {
+				future.get();
+			}
+			catch (...) {
+				if (!exception) {
+					exception = std::current_exception();
+				}
+			}
+		}
+		if (exception) {
+			std::rethrow_exception(exception);
+		}
+
+		return pCommandBuffers;
+	}
+
+	uint32_t ParallelRecorder::GetThreadCount() const
+	{
+		return threadCount_;
+	}
+}
\ No newline at end of file
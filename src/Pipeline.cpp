@@ -2,15 +2,68 @@
 
 #include "DescriptorSet.hpp"
 #include "Device.hpp"
+#include "Hash.hpp"
 #include "Mesh.hpp"
 #include "RenderPass.hpp"
 #include "Shader.hpp"
-#include "Swapchain.hpp"
 
 using namespace std;
 
 namespace sqrp
 {
+    namespace
+    {
+        // targetHash identifies the render pass or the dynamic rendering formats
+        PipelineKey ComputeGraphicsStateKey(
+            uint64_t targetHash,
+            ShaderHandle pVertexShader,
+            ShaderHandle pPixelShader,
+            DescriptorSetHandle pDescriptorSet,
+            const GraphicsPipelineDesc& desc,
+            vk::PushConstantRange pushConstantRange
+        )
+        {
+            PipelineKey key{};
+            key.bindPoint = vk::PipelineBindPoint::eGraphics;
+            key.shaderHash = pVertexShader->GetHash();
+            key.pixelShaderHash = pPixelShader ? pPixelShader->GetHash() : uint64_t(0);
+            key.targetHash = targetHash;
+            key.layoutHash = pDescriptorSet->GetLayoutHash();
+            key.descHash = desc.Hash();
+            key.pushConstantRange = pushConstantRange;
+            return key;
+        }
+    }
+
+    uint64_t PipelineKey::Hash() const
+    {
+        uint64_t hash = HashValue(static_cast<uint32_t>(bindPoint));
+        hash = HashValue(shaderHash, hash);
+        hash = HashValue(pixelShaderHash, hash);
+        hash = HashValue(targetHash, hash);
+        hash = HashValue(layoutHash, hash);
+        hash = HashValue(static_cast<VkShaderStageFlags>(pushConstantRange.stageFlags), hash);
+        hash = HashValue(pushConstantRange.offset, hash);
+        hash = HashValue(pushConstantRange.size, hash);
+        hash = HashValue(descHash, hash);
+
+        return hash;
+    }
+
+    uint64_t RenderingFormats::Hash() const
+    {
+        // Seeded differently from render pass compatibility hashes
+        uint64_t hash = HashString("RenderingFormats");
+        hash = HashValue(static_cast<uint32_t>(colorFormats.size()), hash);
+        for (auto format : colorFormats) {
+            hash = HashValue(static_cast<VkFormat>(format), hash);
+        }
+        hash = HashValue(static_cast<VkFormat>(depthFormat), hash);
+        hash = HashValue(static_cast<VkFormat>(stencilFormat), hash);
+
+        return hash;
+    }
+
     Pipeline::Pipeline(
         const Device& device
     )
@@ -21,6 +74,7 @@ namespace sqrp
 
     vk::Pipeline Pipeline::GetPipeline() const
     {
+        Wait();
         return pipeline_.get();
     }
 
@@ -29,31 +83,231 @@ namespace sqrp
         return pipelineLayout_.get();
     }
 
+    uint64_t Pipeline::GetStateHash() const
+    {
+        return stateHash_;
+    }
+
+    bool Pipeline::IsReady() const
+    {
+        if (!buildFuture_.valid()) {
+            return true;
+        }
+        return buildFuture_.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+    }
+
+    void Pipeline::Wait() const
+    {
+        if (buildFuture_.valid()) {
+            buildFuture_.get();
+        }
+    }
+
+    uint64_t GraphicsPipelineDesc::Hash() const
+    {
+        uint64_t hash = HashValue(static_cast<VkPrimitiveTopology>(topology));
+        hash = HashValue(static_cast<VkPolygonMode>(polygonMode), hash);
+        hash = HashValue(static_cast<VkCullModeFlags>(cullMode), hash);
+        hash = HashValue(static_cast<VkFrontFace>(frontFace), hash);
+        hash = HashValue(lineWidth, hash);
+        hash = HashValue(enableDepthTest, hash);
+        hash = HashValue(enableDepthWrite, hash);
+        hash = HashValue(static_cast<VkCompareOp>(depthCompareOp), hash);
+        hash = HashValue(static_cast<VkSampleCountFlagBits>(sampleCount), hash);
+        hash = HashValue(static_cast<uint32_t>(colorBlendAttachments.size()), hash);
+        for (const auto& attachment : colorBlendAttachments) {
+            hash = HashValue(static_cast<VkPipelineColorBlendAttachmentState>(attachment), hash);
+        }
+        // Explicit blend states override enableColorWrite, only the effective state separates variants
+        if (colorBlendAttachments.empty()) {
+            hash = HashValue(enableColorWrite, hash);
+        }
+        hash = HashValue(static_cast<uint32_t>(dynamicStates.size()), hash);
+        for (auto state : dynamicStates) {
+            hash = HashValue(static_cast<VkDynamicState>(state), hash);
+        }
+        hash = HashValue(needVertexBuffer, hash);
+        hash = HashValue(subpass, hash);
+
+        return hash;
+    }
+
+    GraphicsPipelineDesc GraphicsPipelineDesc::DepthOnly()
+    {
+        GraphicsPipelineDesc desc{};
+        desc.enableColorWrite = false;
+        return desc;
+    }
+
+    GraphicsPipelineDesc GraphicsPipelineDesc::DepthEqual(uint32_t subpass)
+    {
+        GraphicsPipelineDesc desc{};
+        desc.enableDepthWrite = false;
+        desc.depthCompareOp = vk::CompareOp::eEqual;
+        desc.subpass = subpass;
+        return desc;
+    }
+
+    GraphicsPipelineDesc GraphicsPipelineDesc::Wireframe()
+    {
+        GraphicsPipelineDesc desc{};
+        desc.polygonMode = vk::PolygonMode::eLine;
+        desc.cullMode = vk::CullModeFlagBits::eNone;
+        return desc;
+    }
+
+    GraphicsPipelineDesc GraphicsPipelineDesc::Lines()
+    {
+        GraphicsPipelineDesc desc{};
+        desc.topology = vk::PrimitiveTopology::eLineList;
+        desc.cullMode = vk::CullModeFlagBits::eNone;
+        return desc;
+    }
+
+    vk::PipelineColorBlendAttachmentState GraphicsPipelineDesc::OpaqueBlend()
+    {
+        return vk::PipelineColorBlendAttachmentState{}
+            .setBlendEnable(vk::False)
+            .setColorWriteMask(
+                vk::ColorComponentFlagBits::eR |
+                vk::ColorComponentFlagBits::eG |
+                vk::ColorComponentFlagBits::eB |
+                vk::ColorComponentFlagBits::eA
+            );
+    }
+
+    vk::PipelineColorBlendAttachmentState GraphicsPipelineDesc::AlphaBlend()
+    {
+        return OpaqueBlend()
+            .setBlendEnable(vk::True)
+            .setSrcColorBlendFactor(vk::BlendFactor::eSrcAlpha)
+            .setDstColorBlendFactor(vk::BlendFactor::eOneMinusSrcAlpha)
+            .setColorBlendOp(vk::BlendOp::eAdd)
+            .setSrcAlphaBlendFactor(vk::BlendFactor::eOne)
+            .setDstAlphaBlendFactor(vk::BlendFactor::eOneMinusSrcAlpha)
+            .setAlphaBlendOp(vk::BlendOp::eAdd);
+    }
+
+    vk::PipelineColorBlendAttachmentState GraphicsPipelineDesc::AdditiveBlend()
+    {
+        return OpaqueBlend()
+            .setBlendEnable(vk::True)
+            .setSrcColorBlendFactor(vk::BlendFactor::eOne)
+            .setDstColorBlendFactor(vk::BlendFactor::eOne)
+            .setColorBlendOp(vk::BlendOp::eAdd)
+            .setSrcAlphaBlendFactor(vk::BlendFactor::eOne)
+            .setDstAlphaBlendFactor(vk::BlendFactor::eOne)
+            .setAlphaBlendOp(vk::BlendOp::eAdd);
+    }
+
+    PipelineKey GraphicsPipeline::ComputeStateKey(
+        RenderPassHandle pRenderPass,
+        ShaderHandle pVertexShader,
+        ShaderHandle pPixelShader,
+        DescriptorSetHandle pDescriptorSet,
+        const GraphicsPipelineDesc& desc,
+        vk::PushConstantRange pushConstantRange
+    )
+    {
+        return ComputeGraphicsStateKey(pRenderPass->GetCompatibilityHash(), pVertexShader, pPixelShader, pDescriptorSet, desc, pushConstantRange);
+    }
+
+    PipelineKey GraphicsPipeline::ComputeStateKey(
+        const RenderingFormats& renderingFormats,
+        ShaderHandle pVertexShader,
+        ShaderHandle pPixelShader,
+        DescriptorSetHandle pDescriptorSet,
+        const GraphicsPipelineDesc& desc,
+        vk::PushConstantRange pushConstantRange
+    )
+    {
+        return ComputeGraphicsStateKey(renderingFormats.Hash(), pVertexShader, pPixelShader, pDescriptorSet, desc, pushConstantRange);
+    }
+
+    PipelineKey ComputePipeline::ComputeStateKey(
+        ShaderHandle pComputeShader,
+        DescriptorSetHandle pDescriptorSet,
+        vk::PushConstantRange pushConstantRange
+    )
+    {
+        PipelineKey key{};
+        key.bindPoint = vk::PipelineBindPoint::eCompute;
+        key.shaderHash = pComputeShader->GetHash();
+        key.layoutHash = pDescriptorSet->GetLayoutHash();
+        key.pushConstantRange = pushConstantRange;
+        return key;
+    }
+
     GraphicsPipeline::GraphicsPipeline(
         const Device& device,
         std::string name,
         RenderPassHandle pRenderPass,
-        SwapchainHandle pSwapchain,
         ShaderHandle pVertexShader,
         ShaderHandle pPixelShader,
         DescriptorSetHandle pDescriptorSet,
+        const GraphicsPipelineDesc& desc,
         vk::PushConstantRange pushConstantRange,
-        bool enableDepthWrite,
-        bool needVertexBuffer
+        bool deferBuild
     )
-        : Pipeline(device)
+        : Pipeline(device), name_(name), pRenderPass_(pRenderPass), pVertexShader_(pVertexShader), pPixelShader_(pPixelShader), desc_(desc)
     {
-        vk::PipelineShaderStageCreateInfo vertStage{};
-        vertStage.stage = pVertexShader->GetShaderStage();
-        vertStage.module = pVertexShader->GetShaderModule();
-        vertStage.pName = "main";
+        stateHash_ = ComputeStateKey(pRenderPass, pVertexShader, pPixelShader, pDescriptorSet, desc, pushConstantRange).Hash();
+        CreatePipelineLayout(pDescriptorSet, pushConstantRange);
+
+        if (!deferBuild) {
+            Build();
+        }
+    }
+
+    GraphicsPipeline::GraphicsPipeline(
+        const Device& device,
+        std::string name,
+        const RenderingFormats& renderingFormats,
+        ShaderHandle pVertexShader,
+        ShaderHandle pPixelShader,
+        DescriptorSetHandle pDescriptorSet,
+        const GraphicsPipelineDesc& desc,
+        vk::PushConstantRange pushConstantRange,
+        bool deferBuild
+    )
+        : Pipeline(device), name_(name), renderingFormats_(renderingFormats), pVertexShader_(pVertexShader), pPixelShader_(pPixelShader), desc_(desc)
+    {
+        stateHash_ = ComputeStateKey(renderingFormats, pVertexShader, pPixelShader, pDescriptorSet, desc, pushConstantRange).Hash();
+        CreatePipelineLayout(pDescriptorSet, pushConstantRange);
 
-        vk::PipelineShaderStageCreateInfo fragStage{};
-        fragStage.stage = pPixelShader->GetShaderStage();
-        fragStage.module = pPixelShader->GetShaderModule();
-        fragStage.pName = "main";
+        if (!deferBuild) {
+            Build();
+        }
+    }
 
-        vk::PipelineShaderStageCreateInfo shaderStages[] = { vertStage, fragStage };
+    void GraphicsPipeline::CreatePipelineLayout(DescriptorSetHandle pDescriptorSet, vk::PushConstantRange pushConstantRange)
+    {
+        vk::PipelineLayoutCreateInfo layoutInfo{};
+		auto descriptorSetLayout = pDescriptorSet->GetDescriptorSetLayout();
+        layoutInfo.setLayoutCount = 1;
+        layoutInfo.pSetLayouts = &descriptorSetLayout;
+		layoutInfo.setPushConstantRangeCount(pushConstantRange.size > 0 ? 1 : 0);
+		layoutInfo.pPushConstantRanges = pushConstantRange.size > 0 ? &pushConstantRange : nullptr;
+        pipelineLayout_ = pDevice_->GetDevice().createPipelineLayoutUnique(layoutInfo);
+    }
+
+    void GraphicsPipeline::Build()
+    {
+        std::vector<vk::PipelineShaderStageCreateInfo> shaderStages;
+        vk::PipelineShaderStageCreateInfo vertStage{};
+        vertStage.stage = pVertexShader_->GetShaderStage();
+        vertStage.module = pVertexShader_->GetShaderModule();
+        vertStage.pName = "main";
+        shaderStages.push_back(vertStage);
+
+        // Pixel shader is optional for depth only rendering
+        if (pPixelShader_) {
+            vk::PipelineShaderStageCreateInfo fragStage{};
+            fragStage.stage = pPixelShader_->GetShaderStage();
+            fragStage.module = pPixelShader_->GetShaderModule();
+            fragStage.pName = "main";
+            shaderStages.push_back(fragStage);
+        }
 
 		// Vertex format
 		vk::VertexInputBindingDescription bindingDescription{};
@@ -88,7 +342,7 @@ namespace sqrp
         attributeDescriptions[3].offset = offsetof(Vertex, uv);
 
         vk::PipelineVertexInputStateCreateInfo vertexInput{};
-        if (needVertexBuffer) {
+        if (desc_.needVertexBuffer) {
             vertexInput.setVertexBindingDescriptionCount(1);
             vertexInput.setPVertexBindingDescriptions(&bindingDescription);
             vertexInput.setVertexAttributeDescriptionCount(static_cast<uint32_t>(attributeDescriptions.size()));
@@ -100,71 +354,77 @@ namespace sqrp
         }
 
         vk::PipelineInputAssemblyStateCreateInfo inputAssembly{};
-        inputAssembly.topology = vk::PrimitiveTopology::eTriangleList;
+        inputAssembly.topology = desc_.topology;
 
-        std::array<vk::DynamicState, 2> dynamicStates = {
+        std::vector<vk::DynamicState> dynamicStates = {
             vk::DynamicState::eViewport,
             vk::DynamicState::eScissor
 		};
+        for (auto state : desc_.dynamicStates) {
+            if (std::find(dynamicStates.begin(), dynamicStates.end(), state) == dynamicStates.end()) {
+                dynamicStates.push_back(state);
+            }
+        }
 		vk::PipelineDynamicStateCreateInfo dynamicState{};
 		dynamicState.setDynamicStates(dynamicStates);
 
-        vk::Viewport viewport{};
-        viewport.x = 0.0f;
-        viewport.y = 0.0f;
-        viewport.width = static_cast<float>(pSwapchain->GetWidth());
-        viewport.height = static_cast<float>(pSwapchain->GetHeight());
-        viewport.minDepth = 0.0f;
-        viewport.maxDepth = 1.0f;
-
-        vk::Rect2D scissor{ {0, 0}, {pSwapchain->GetWidth(), pSwapchain->GetHeight()}};
+        // NOTE : Viewport and scissor are set by the command buffer
         vk::PipelineViewportStateCreateInfo viewportState{};
         viewportState.viewportCount = 1;
         viewportState.scissorCount = 1;
 
+        const vk::PhysicalDeviceFeatures& features = pDevice_->GetEnabledFeatures();
+        vk::PolygonMode polygonMode = desc_.polygonMode;
+        if (polygonMode != vk::PolygonMode::eFill && !features.fillModeNonSolid) {
+            cerr << "Warning: fillModeNonSolid is not supported, " << name_ << " falls back to eFill" << endl;
+            polygonMode = vk::PolygonMode::eFill;
+        }
+        float lineWidth = desc_.lineWidth;
+        if (lineWidth != 1.0f && !features.wideLines) {
+            cerr << "Warning: wideLines is not supported, " << name_ << " uses lineWidth 1.0" << endl;
+            lineWidth = 1.0f;
+        }
+
         vk::PipelineRasterizationStateCreateInfo rasterizer{};
-        rasterizer.polygonMode = vk::PolygonMode::eFill;
-        rasterizer.lineWidth = 1.0f;
-        rasterizer.cullMode = vk::CullModeFlagBits::eBack;
-        rasterizer.frontFace = vk::FrontFace::eCounterClockwise;
+        rasterizer.polygonMode = polygonMode;
+        rasterizer.lineWidth = lineWidth;
+        rasterizer.cullMode = desc_.cullMode;
+        rasterizer.frontFace = desc_.frontFace;
 
         vk::PipelineMultisampleStateCreateInfo multisampling{};
-        multisampling.rasterizationSamples = vk::SampleCountFlagBits::e1;
-
-        std::vector<vk::PipelineColorBlendAttachmentState> colorBlendAttachments(pRenderPass->GetNumColorAttachments());
-        for (int i = 0; i < pRenderPass->GetNumColorAttachments(); i++) {
-            colorBlendAttachments[i].colorWriteMask =
-                vk::ColorComponentFlagBits::eR |
-                vk::ColorComponentFlagBits::eG |
-                vk::ColorComponentFlagBits::eB |
-				vk::ColorComponentFlagBits::eA;
-		}
+        multisampling.rasterizationSamples = desc_.sampleCount;
+
+        std::vector<vk::PipelineColorBlendAttachmentState> colorBlendAttachments = desc_.colorBlendAttachments;
+        int numColorAttachments = pRenderPass_
+            ? pRenderPass_->GetNumSubpassColorAttachments(desc_.subpass)
+            : static_cast<int>(renderingFormats_.colorFormats.size());
+        if (colorBlendAttachments.empty()) {
+            colorBlendAttachments.resize(numColorAttachments, GraphicsPipelineDesc::OpaqueBlend());
+            if (!desc_.enableColorWrite) {
+                for (auto& attachment : colorBlendAttachments) {
+                    attachment.colorWriteMask = {};
+                }
+            }
+        }
+        else if (static_cast<int>(colorBlendAttachments.size()) != numColorAttachments) {
+            throw std::runtime_error("colorBlendAttachments must match the color attachments of the subpass");
+        }
 
         vk::PipelineColorBlendStateCreateInfo colorBlending{};
         colorBlending.attachmentCount = colorBlendAttachments.size();
         colorBlending.pAttachments = colorBlendAttachments.data();
 
-		// pipeline layout
-        vk::PipelineLayoutCreateInfo layoutInfo{};
-		auto descriptorSetLayout = pDescriptorSet->GetDescriptorSetLayout();
-        layoutInfo.setLayoutCount = 1;
-        layoutInfo.pSetLayouts = &descriptorSetLayout;
-		layoutInfo.setPushConstantRangeCount(pushConstantRange.size > 0 ? 1 : 0);
-		layoutInfo.pPushConstantRanges = pushConstantRange.size > 0 ? &pushConstantRange : nullptr;
-        pipelineLayout_ = pDevice_->GetDevice().createPipelineLayoutUnique(layoutInfo);
-
         vk::PipelineDepthStencilStateCreateInfo depthStencilState{};
         depthStencilState
-            .setDepthTestEnable(vk::True)
-            .setDepthWriteEnable(enableDepthWrite ? vk::True : vk::False)
-            .setDepthCompareOp(vk::CompareOp::eLessOrEqual)
+            .setDepthTestEnable(desc_.enableDepthTest ? vk::True : vk::False)
+            .setDepthWriteEnable(desc_.enableDepthWrite ? vk::True : vk::False)
+            .setDepthCompareOp(desc_.depthCompareOp)
             .setDepthBoundsTestEnable(vk::False)
             .setStencilTestEnable(vk::False);
 
         // pipeline
         vk::GraphicsPipelineCreateInfo pipelineInfo{};
-        pipelineInfo.setStageCount(2);
-		pipelineInfo.setPStages(shaderStages);
+		pipelineInfo.setStages(shaderStages);
 		pipelineInfo.setPDepthStencilState(&depthStencilState);
         pipelineInfo.setPVertexInputState(&vertexInput);
 		pipelineInfo.setPInputAssemblyState(&inputAssembly);
@@ -174,10 +434,20 @@ namespace sqrp
 		pipelineInfo.setPColorBlendState(&colorBlending);
 		pipelineInfo.setPDynamicState(&dynamicState);
 		pipelineInfo.setLayout(pipelineLayout_.get());
-		pipelineInfo.setRenderPass(pRenderPass->GetRenderPass());
-		pipelineInfo.setSubpass(0);
+        vk::PipelineRenderingCreateInfo renderingCreateInfo{};
+        if (pRenderPass_) {
+            pipelineInfo.setRenderPass(pRenderPass_->GetRenderPass());
+            pipelineInfo.setSubpass(desc_.subpass);
+        }
+        else {
+            renderingCreateInfo
+                .setColorAttachmentFormats(renderingFormats_.colorFormats)
+                .setDepthAttachmentFormat(renderingFormats_.depthFormat)
+                .setStencilAttachmentFormat(renderingFormats_.stencilFormat);
+            pipelineInfo.setPNext(&renderingCreateInfo);
+        }
 
-        auto result = pDevice_->GetDevice().createGraphicsPipelinesUnique(nullptr, pipelineInfo);
+        auto result = pDevice_->GetDevice().createGraphicsPipelinesUnique(pDevice_->GetPipelineCache(), pipelineInfo);
         if (result.result != vk::Result::eSuccess) {
             throw std::runtime_error("failed to create graphics pipeline!");
         }
@@ -185,7 +455,7 @@ namespace sqrp
         pDevice_->SetObjectName(
             (uint64_t)(VkPipeline)(pipeline_.get()),
             vk::ObjectType::ePipeline,
-            name + "_GraphicsPipeline"
+            name_ + "_GraphicsPipeline"
 		);
     }
 
@@ -194,13 +464,11 @@ namespace sqrp
         std::string name,
         ShaderHandle pComputeShader,
         DescriptorSetHandle pDescriptorSet,
-        vk::PushConstantRange pushConstantRange
-	) : Pipeline(device)
+        vk::PushConstantRange pushConstantRange,
+        bool deferBuild
+	) : Pipeline(device), name_(name), pComputeShader_(pComputeShader)
     {
-        vk::PipelineShaderStageCreateInfo computeStage{};
-        computeStage.stage = pComputeShader->GetShaderStage();
-        computeStage.module = pComputeShader->GetShaderModule();
-        computeStage.pName = "main";
+        stateHash_ = ComputeStateKey(pComputeShader, pDescriptorSet, pushConstantRange).Hash();
 
 		// pipeline layout
         vk::PipelineLayoutCreateInfo layoutInfo{};
@@ -211,12 +479,24 @@ namespace sqrp
         layoutInfo.pPushConstantRanges = pushConstantRange.size > 0 ? &pushConstantRange : nullptr;
         pipelineLayout_ = pDevice_->GetDevice().createPipelineLayoutUnique(layoutInfo);
 
+        if (!deferBuild) {
+            Build();
+        }
+    }
+
+    void ComputePipeline::Build()
+    {
+        vk::PipelineShaderStageCreateInfo computeStage{};
+        computeStage.stage = pComputeShader_->GetShaderStage();
+        computeStage.module = pComputeShader_->GetShaderModule();
+        computeStage.pName = "main";
+
 		// pipeline
         vk::ComputePipelineCreateInfo pipelineInfo{};
 		pipelineInfo.setStage(computeStage);
 		pipelineInfo.setLayout(pipelineLayout_.get());
 
-        auto result = pDevice_->GetDevice().createComputePipelinesUnique(nullptr, pipelineInfo);
+        auto result = pDevice_->GetDevice().createComputePipelinesUnique(pDevice_->GetPipelineCache(), pipelineInfo);
         if (result.result != vk::Result::eSuccess) {
             throw std::runtime_error("failed to create compute pipeline!");
         }
@@ -224,7 +504,7 @@ namespace sqrp
         pDevice_->SetObjectName(
             (uint64_t)(VkPipeline)(pipeline_.get()),
             vk::ObjectType::ePipeline,
-            name + "_ComputePipeline"
+            name_ + "_ComputePipeline"
         );
     }
 }
\ No newline at end of file
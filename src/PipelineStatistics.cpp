@@ -0,0 +1,133 @@
+#include "PipelineStatistics.hpp"
+
+#include "Device.hpp"
+
+using namespace std;
+
+namespace sqrp
+{
+	PipelineStatistics::PipelineStatistics(const Device& device, std::string name, uint32_t inflightCount, uint32_t maxScopeCount)
+		: pDevice_(&device), name_(name), maxScopeCount_(maxScopeCount)
+	{
+		isEnabled_ = pDevice_->GetEnabledFeatures().pipelineStatisticsQuery && pDevice_->GetEnabledVulkan12Features().hostQueryReset;
+		if (!isEnabled_) {
+			cerr << "Warning: PipelineStatistics " << name_ << " is disabled, pipelineStatisticsQuery or hostQueryReset is not supported" << endl;
+			return;
+		}
+
+		auto queueFamilies = pDevice_->GetPhysicalDevice().getQueueFamilyProperties();
+		for (const auto& [type, context] : pDevice_->GetQueueContexts()) {
+			if (queueFamilies[context.queueFamilyIndex].queueFlags & vk::QueueFlagBits::eGraphics) {
+				graphicsQueues_.insert(type);
+			}
+		}
+
+		frames_.resize(inflightCount);
+		for (uint32_t i = 0; i < inflightCount; i++) {
+			frames_[i].queryPool = pDevice_->GetDevice().createQueryPoolUnique(
+				vk::QueryPoolCreateInfo()
+				.setQueryType(vk::QueryType::ePipelineStatistics)
+				.setQueryCount(maxScopeCount_)
+				.setPipelineStatistics(QueryFlags)
+			);
+			pDevice_->SetObjectName((uint64_t)(VkQueryPool)frames_[i].queryPool.get(), vk::ObjectType::eQueryPool, name_ + "PipelineStatistics" + to_string(i));
+			pDevice_->GetDevice().resetQueryPool(frames_[i].queryPool.get(), 0, maxScopeCount_);
+		}
+	}
+
+	void PipelineStatistics::BeginFrame(uint32_t inflightIndex)
+	{
+		if (!isEnabled_) {
+			return;
+		}
+
+		std::lock_guard<std::mutex> lock(mutex_);
+		inflightIndex_ = inflightIndex;
+		auto& frame = frames_[inflightIndex_];
+		uint32_t queryCount = static_cast<uint32_t>(frame.scopes.size());
+		if (queryCount > 0) {
+			// Counters and availability per query, queries of unsubmitted command buffers are not available
+			constexpr uint32_t Stride = CounterCount + 1;
+			std::vector<uint64_t> values(queryCount * Stride);
+			vk::Result result = pDevice_->GetDevice().getQueryPoolResults(
+				frame.queryPool.get(), 0, queryCount,
+				values.size() * sizeof(uint64_t), values.data(), Stride * sizeof(uint64_t),
+				vk::QueryResultFlagBits::e64 | vk::QueryResultFlagBits::eWithAvailability
+			);
+			if (result == vk::Result::eSuccess || result == vk::Result::eNotReady) {
+				// Only names resolved in this frame are reset, others keep the last value
+				std::set<std::string> resolvedNames;
+				for (const auto& scope : frame.scopes) {
+					const uint64_t* counters = values.data() + scope.query * Stride;
+					if (!scope.isEnded || counters[CounterCount] == 0) {
+						continue;
+					}
+					auto it = std::find_if(results_.begin(), results_.end(), [&](const PipelineStatisticsResult& r) { return r.name == scope.name; });
+					if (it == results_.end()) {
+						results_.push_back(PipelineStatisticsResult{ scope.name });
+						it = results_.end() - 1;
+					}
+					if (resolvedNames.insert(scope.name).second) {
+						*it = PipelineStatisticsResult{ scope.name };
+					}
+					it->inputAssemblyVertices += counters[0];
+					it->inputAssemblyPrimitives += counters[1];
+					it->vertexShaderInvocations += counters[2];
+					it->clippingInvocations += counters[3];
+					it->clippingPrimitives += counters[4];
+					it->fragmentShaderInvocations += counters[5];
+					it->computeShaderInvocations += counters[6];
+				}
+			}
+			pDevice_->GetDevice().resetQueryPool(frame.queryPool.get(), 0, queryCount);
+		}
+		frame.scopes.clear();
+	}
+
+	uint32_t PipelineStatistics::BeginScope(vk::CommandBuffer commandBuffer, QueueContextType queueType, const std::string& name)
+	{
+		if (!isEnabled_ || graphicsQueues_.find(queueType) == graphicsQueues_.end()) {
+			return InvalidScope;
+		}
+
+		std::lock_guard<std::mutex> lock(mutex_);
+		auto& frame = frames_[inflightIndex_];
+		if (frame.scopes.size() >= maxScopeCount_) {
+			if (!isOverflowWarned_) {
+				cerr << "Warning: Too many scopes in a frame of PipelineStatistics " << name_ << ", the rest are skipped" << endl;
+				isOverflowWarned_ = true;
+			}
+			return InvalidScope;
+		}
+		uint32_t query = static_cast<uint32_t>(frame.scopes.size());
+		commandBuffer.beginQuery(frame.queryPool.get(), query, {});
+		frame.scopes.push_back(Scope{ name, query, false });
+		return query;
+	}
+
+	void PipelineStatistics::EndScope(vk::CommandBuffer commandBuffer, uint32_t scope)
+	{
+		if (scope == InvalidScope) {
+			return;
+		}
+
+		std::lock_guard<std::mutex> lock(mutex_);
+		auto& frame = frames_[inflightIndex_];
+		if (scope >= frame.scopes.size()) {
+			return;
+		}
+		commandBuffer.endQuery(frame.queryPool.get(), scope);
+		frame.scopes[scope].isEnded = true;
+	}
+
+	std::vector<PipelineStatisticsResult> PipelineStatistics::GetResults() const
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		return results_;
+	}
+
+	bool PipelineStatistics::IsEnabled() const
+	{
+		return isEnabled_;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,255 @@
+#include "Profiler.hpp"
+
+#include "CommandBuffer.hpp"
+#include "Device.hpp"
+#include "TraceRecorder.hpp"
+
+using namespace std;
+
+namespace
+{
+	const char* GetQueueName(sqrp::QueueContextType type)
+	{
+		switch (type) {
+		case sqrp::QueueContextType::General:
+			return "General";
+		case sqrp::QueueContextType::Graphics:
+			return "Graphics";
+		case sqrp::QueueContextType::Compute:
+			return "Compute";
+		case sqrp::QueueContextType::Transfer:
+			return "Transfer";
+		default:
+			return "Present";
+		}
+	}
+}
+
+namespace sqrp
+{
+	Profiler::Profiler(const Device& device, std::string name, uint32_t inflightCount, uint32_t maxScopeCount, uint32_t historySize)
+		: pDevice_(&device), name_(name), maxQueryCount_(maxScopeCount * 2), historySize_(std::max(1u, historySize))
+	{
+		auto properties = pDevice_->GetPhysicalDevice().getProperties();
+		timestampPeriod_ = properties.limits.timestampPeriod;
+
+		auto queueFamilies = pDevice_->GetPhysicalDevice().getQueueFamilyProperties();
+		for (const auto& [type, context] : pDevice_->GetQueueContexts()) {
+			uint32_t validBits = queueFamilies[context.queueFamilyIndex].timestampValidBits;
+			if (validBits > 0) {
+				validMasks_[type] = validBits >= 64 ? UINT64_MAX : (1ull << validBits) - 1;
+				TraceRecorder::SetGpuTrackName(static_cast<uint32_t>(type), name_ + " " + GetQueueName(type));
+			}
+		}
+
+		// Queries are reset from the host in BeginFrame, so they can be written anywhere in the command buffer (even inside render passes)
+		isGpuEnabled_ = pDevice_->GetEnabledVulkan12Features().hostQueryReset && !validMasks_.empty();
+		if (!isGpuEnabled_) {
+			cerr << "Warning: GPU scopes of Profiler " << name_ << " are disabled, hostQueryReset or timestamps are not supported" << endl;
+			return;
+		}
+
+		frames_.resize(inflightCount);
+		for (uint32_t i = 0; i < inflightCount; i++) {
+			frames_[i].queryPool = pDevice_->GetDevice().createQueryPoolUnique(
+				vk::QueryPoolCreateInfo()
+				.setQueryType(vk::QueryType::eTimestamp)
+				.setQueryCount(maxQueryCount_)
+			);
+			pDevice_->SetObjectName((uint64_t)(VkQueryPool)frames_[i].queryPool.get(), vk::ObjectType::eQueryPool, name_ + "Timestamp" + to_string(i));
+			pDevice_->GetDevice().resetQueryPool(frames_[i].queryPool.get(), 0, maxQueryCount_);
+		}
+		Calibrate();
+	}
+
+	void Profiler::Calibrate()
+	{
+		auto maskIt = validMasks_.find(QueueContextType::General);
+		if (maskIt == validMasks_.end()) {
+			maskIt = validMasks_.begin();
+		}
+		vk::QueryPool queryPool = frames_[0].queryPool.get();
+
+		// The timestamp is taken between the submit and the end of the wait, the midpoint is used
+		double submitUs = TraceRecorder::NowUs();
+		pDevice_->OneTimeSubmit([&](CommandBufferHandle pCommandBuffer) {
+			pCommandBuffer->GetCommandBuffer().writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, queryPool, 0);
+		});
+		double waitedUs = TraceRecorder::NowUs();
+
+		uint64_t timestamp = 0;
+		vk::Result result = pDevice_->GetDevice().getQueryPoolResults(
+			queryPool, 0, 1, sizeof(uint64_t), &timestamp, sizeof(uint64_t),
+			vk::QueryResultFlagBits::e64 | vk::QueryResultFlagBits::eWait
+		);
+		pDevice_->GetDevice().resetQueryPool(queryPool, 0, 1);
+		if (result != vk::Result::eSuccess) {
+			return;
+		}
+		double gpuUs = static_cast<double>(timestamp & maskIt->second) * timestampPeriod_ / 1000.0;
+		gpuToCpuOffsetUs_ = (submitUs + waitedUs) * 0.5 - gpuUs;
+	}
+
+	void Profiler::AddSampleLocked(const std::string& name, bool isGpu, double ms)
+	{
+		auto it = historyIndices_.find(name);
+		if (it == historyIndices_.end()) {
+			it = historyIndices_.emplace(name, static_cast<uint32_t>(histories_.size())).first;
+			histories_.push_back(History{ name, isGpu, {} });
+		}
+		auto& samples = histories_[it->second].samples;
+		samples.push_back(ms);
+		if (samples.size() > historySize_) {
+			samples.pop_front();
+		}
+	}
+
+	void Profiler::BeginFrame(uint32_t inflightIndex)
+	{
+		if (!isGpuEnabled_) {
+			return;
+		}
+
+		std::lock_guard<std::mutex> lock(mutex_);
+		inflightIndex_ = inflightIndex;
+		auto& frame = frames_[inflightIndex_];
+		if (frame.queryCount > 0) {
+			// Timestamp and availability per query, queries of unsubmitted command buffers are not available
+			std::vector<uint64_t> results(frame.queryCount * 2);
+			vk::Result result = pDevice_->GetDevice().getQueryPoolResults(
+				frame.queryPool.get(), 0, frame.queryCount,
+				results.size() * sizeof(uint64_t), results.data(), 2 * sizeof(uint64_t),
+				vk::QueryResultFlagBits::e64 | vk::QueryResultFlagBits::eWithAvailability
+			);
+			if (result == vk::Result::eSuccess || result == vk::Result::eNotReady) {
+				bool isTraced = TraceRecorder::IsEnabled();
+				std::unordered_map<std::string, double> frameTimes;
+				std::vector<std::string> order;
+				for (const auto& scope : frame.scopes) {
+					if (scope.endQuery == scope.beginQuery || results[scope.beginQuery * 2 + 1] == 0 || results[scope.endQuery * 2 + 1] == 0) {
+						continue;
+					}
+					uint64_t begin = results[scope.beginQuery * 2] & scope.validMask;
+					uint64_t end = results[scope.endQuery * 2] & scope.validMask;
+					double ms = static_cast<double>((end - begin) & scope.validMask) * timestampPeriod_ / 1000000.0;
+					if (!frameTimes.contains(scope.name)) {
+						order.push_back(scope.name);
+					}
+					frameTimes[scope.name] += ms;
+					if (isTraced) {
+						double beginUs = static_cast<double>(begin) * timestampPeriod_ / 1000.0 + gpuToCpuOffsetUs_;
+						TraceRecorder::AddGpuEvent(scope.name, static_cast<uint32_t>(scope.queueType), beginUs, ms * 1000.0);
+					}
+				}
+				for (const auto& name : order) {
+					AddSampleLocked(name, true, frameTimes[name]);
+				}
+			}
+			pDevice_->GetDevice().resetQueryPool(frame.queryPool.get(), 0, frame.queryCount);
+		}
+		frame.scopes.clear();
+		frame.queryCount = 0;
+	}
+
+	uint32_t Profiler::BeginGpuScope(vk::CommandBuffer commandBuffer, QueueContextType queueType, const std::string& name)
+	{
+		auto maskIt = validMasks_.find(queueType);
+		if (!isGpuEnabled_ || maskIt == validMasks_.end()) {
+			return InvalidScope;
+		}
+
+		std::lock_guard<std::mutex> lock(mutex_);
+		auto& frame = frames_[inflightIndex_];
+		if (frame.queryCount + 2 > maxQueryCount_) {
+			if (!isOverflowWarned_) {
+				cerr << "Warning: Too many GPU scopes in a frame of Profiler " << name_ << ", the rest are skipped" << endl;
+				isOverflowWarned_ = true;
+			}
+			return InvalidScope;
+		}
+		// The end query is reserved now so that nested scopes don't interleave the pair
+		GpuScope scope{ name, frame.queryCount, frame.queryCount, maskIt->second, queueType };
+		frame.queryCount += 2;
+		commandBuffer.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe, frame.queryPool.get(), scope.beginQuery);
+		frame.scopes.push_back(scope);
+		return static_cast<uint32_t>(frame.scopes.size() - 1);
+	}
+
+	void Profiler::EndGpuScope(vk::CommandBuffer commandBuffer, uint32_t scope)
+	{
+		if (scope == InvalidScope) {
+			return;
+		}
+
+		std::lock_guard<std::mutex> lock(mutex_);
+		auto& frame = frames_[inflightIndex_];
+		if (scope >= frame.scopes.size()) {
+			return;
+		}
+		auto& gpuScope = frame.scopes[scope];
+		gpuScope.endQuery = gpuScope.beginQuery + 1;
+		commandBuffer.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, frame.queryPool.get(), gpuScope.endQuery);
+	}
+
+	void Profiler::AddCpuSample(const std::string& name, double ms)
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		AddSampleLocked(name, false, ms);
+	}
+
+	std::vector<ProfileStats> Profiler::GetStats() const
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		std::vector<ProfileStats> stats;
+		stats.reserve(histories_.size());
+		for (const auto& history : histories_) {
+			if (history.samples.empty()) {
+				continue;
+			}
+			std::vector<double> sorted(history.samples.begin(), history.samples.end());
+			std::sort(sorted.begin(), sorted.end());
+			ProfileStats stat;
+			stat.name = history.name;
+			stat.isGpu = history.isGpu;
+			stat.lastMs = history.samples.back();
+			stat.minMs = sorted.front();
+			double sum = 0.0;
+			for (double sample : sorted) {
+				sum += sample;
+			}
+			stat.avgMs = sum / sorted.size();
+			size_t p99Index = static_cast<size_t>(std::ceil(sorted.size() * 0.99)) - 1;
+			stat.p99Ms = sorted[std::min(p99Index, sorted.size() - 1)];
+			stat.sampleCount = static_cast<uint32_t>(sorted.size());
+			stats.push_back(stat);
+		}
+		return stats;
+	}
+
+	bool Profiler::IsGpuEnabled() const
+	{
+		return isGpuEnabled_;
+	}
+
+	CpuProfileScope::CpuProfileScope(Profiler* pProfiler, const char* name)
+		: pProfiler_(pProfiler), name_(name), isTraced_(TraceRecorder::IsEnabled())
+	{
+		if (pProfiler_ || isTraced_) {
+			beginUs_ = TraceRecorder::NowUs();
+		}
+	}
+
+	CpuProfileScope::~CpuProfileScope()
+	{
+		if (!pProfiler_ && !isTraced_) {
+			return;
+		}
+		double durationUs = TraceRecorder::NowUs() - beginUs_;
+		if (pProfiler_) {
+			pProfiler_->AddCpuSample(name_, durationUs / 1000.0);
+		}
+		if (isTraced_) {
+			TraceRecorder::AddCpuEvent(name_, "cpu", beginUs_, durationUs);
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,685 @@
+#include "RenderGraph.hpp"
+
+#include "Buffer.hpp"
+#include "CommandBuffer.hpp"
+#include "Device.hpp"
+#include "Image.hpp"
+#include "Profiler.hpp"
+
+using namespace std;
+
+namespace sqrp
+{
+	namespace
+	{
+		void AddUnique(std::vector<uint32_t>& indices, uint32_t index)
+		{
+			if (std::find(indices.begin(), indices.end(), index) == indices.end()) {
+				indices.push_back(index);
+			}
+		}
+
+		vk::DeviceSize AlignUp(vk::DeviceSize value, vk::DeviceSize alignment)
+		{
+			return (value + alignment - 1) / alignment * alignment;
+		}
+	}
+
+	RenderGraph::PassBuilder::PassBuilder(RenderGraph& renderGraph, uint32_t passIndex)
+		: pRenderGraph_(&renderGraph), passIndex_(passIndex)
+	{
+
+	}
+
+	RenderGraph::PassBuilder& RenderGraph::PassBuilder::ReadImage(ImageHandle pImage, vk::ImageLayout layout, vk::PipelineStageFlags2 stageMask)
+	{
+		LayoutSyncInfo syncInfo = GetLayoutSyncInfo(layout);
+		ImageAccess imageAccess{};
+		imageAccess.pImage = pImage;
+		imageAccess.layout = layout;
+		imageAccess.stageMask = stageMask ? stageMask : syncInfo.stageMask;
+		imageAccess.accessMask = syncInfo.accessMask;
+		imageAccess.isRead = true;
+		pRenderGraph_->passes_[passIndex_].imageAccesses.push_back(imageAccess);
+		pRenderGraph_->isCompiled_ = false;
+		return *this;
+	}
+
+	RenderGraph::PassBuilder& RenderGraph::PassBuilder::WriteImage(ImageHandle pImage, vk::ImageLayout layout, vk::ImageLayout finalLayout, vk::PipelineStageFlags2 stageMask)
+	{
+		LayoutSyncInfo syncInfo = GetLayoutSyncInfo(layout);
+		ImageAccess imageAccess{};
+		imageAccess.pImage = pImage;
+		imageAccess.layout = layout;
+		imageAccess.finalLayout = finalLayout;
+		imageAccess.stageMask = stageMask ? stageMask : syncInfo.stageMask;
+		imageAccess.accessMask = syncInfo.accessMask;
+		imageAccess.isWrite = true;
+		pRenderGraph_->passes_[passIndex_].imageAccesses.push_back(imageAccess);
+		pRenderGraph_->isCompiled_ = false;
+		return *this;
+	}
+
+	RenderGraph::PassBuilder& RenderGraph::PassBuilder::ReadWriteImage(ImageHandle pImage, vk::ImageLayout layout, vk::ImageLayout finalLayout, vk::PipelineStageFlags2 stageMask)
+	{
+		WriteImage(pImage, layout, finalLayout, stageMask);
+		pRenderGraph_->passes_[passIndex_].imageAccesses.back().isRead = true;
+		return *this;
+	}
+
+	RenderGraph::PassBuilder& RenderGraph::PassBuilder::ReadBuffer(BufferHandle pBuffer, vk::PipelineStageFlags2 stageMask, vk::AccessFlags2 accessMask)
+	{
+		pRenderGraph_->passes_[passIndex_].bufferAccesses.push_back(BufferAccess{ pBuffer, stageMask, accessMask, true, false });
+		pRenderGraph_->isCompiled_ = false;
+		return *this;
+	}
+
+	RenderGraph::PassBuilder& RenderGraph::PassBuilder::WriteBuffer(BufferHandle pBuffer, vk::PipelineStageFlags2 stageMask, vk::AccessFlags2 accessMask)
+	{
+		pRenderGraph_->passes_[passIndex_].bufferAccesses.push_back(BufferAccess{ pBuffer, stageMask, accessMask, false, true });
+		pRenderGraph_->isCompiled_ = false;
+		return *this;
+	}
+
+	RenderGraph::PassBuilder& RenderGraph::PassBuilder::ReadWriteBuffer(BufferHandle pBuffer, vk::PipelineStageFlags2 stageMask, vk::AccessFlags2 accessMask)
+	{
+		pRenderGraph_->passes_[passIndex_].bufferAccesses.push_back(BufferAccess{ pBuffer, stageMask, accessMask, true, true });
+		pRenderGraph_->isCompiled_ = false;
+		return *this;
+	}
+
+	RenderGraph::PassBuilder& RenderGraph::PassBuilder::SetSideEffect()
+	{
+		pRenderGraph_->passes_[passIndex_].hasSideEffect = true;
+		pRenderGraph_->isCompiled_ = false;
+		return *this;
+	}
+
+	RenderGraph::PassBuilder& RenderGraph::PassBuilder::SetSecondaryCommandBuffers(bool isSecondary)
+	{
+		pRenderGraph_->passes_[passIndex_].isSecondaryCommandBuffers = isSecondary;
+		return *this;
+	}
+
+	RenderGraph::RenderGraph(const Device& device, std::string name)
+		: pDevice_(&device), name_(name)
+	{
+
+	}
+
+	RenderGraph::~RenderGraph()
+	{
+		for (size_t i = 0; i < transientMemories_.size(); i++) {
+			pDevice_->UntrackAllocation(MemoryCategory::Attachment, transientMemorySizes_[i]);
+			vmaFreeMemory(pDevice_->GetAllocator(), transientMemories_[i]);
+		}
+	}
+
+	RenderGraph::PassBuilder RenderGraph::AddPass(std::string name, ExecuteFunction execute)
+	{
+		Pass pass{};
+		pass.name = name;
+		pass.execute = std::move(execute);
+		passes_.push_back(std::move(pass));
+		isCompiled_ = false;
+		return PassBuilder(*this, static_cast<uint32_t>(passes_.size() - 1));
+	}
+
+	ImageHandle RenderGraph::CreateTransientImage(std::string name, vk::ImageCreateInfo imageCreateInfo, vk::ImageAspectFlags aspectFlags, vk::SamplerCreateInfo samplerCreateInfo)
+	{
+		ImageMemoryType memoryType = ImageMemoryType::Aliased;
+		if (imageCreateInfo.usage & vk::ImageUsageFlagBits::eTransientAttachment) {
+			// Mostly on tiled GPUs, the attachment may never be backed by memory
+			VmaAllocationCreateInfo lazyCreateInfo{};
+			lazyCreateInfo.usage = VMA_MEMORY_USAGE_GPU_LAZILY_ALLOCATED;
+			uint32_t memoryTypeIndex = 0;
+			if (vmaFindMemoryTypeIndexForImageInfo(pDevice_->GetAllocator(), reinterpret_cast<const VkImageCreateInfo*>(&imageCreateInfo), &lazyCreateInfo, &memoryTypeIndex) == VK_SUCCESS) {
+				memoryType = ImageMemoryType::LazilyAllocated;
+			}
+		}
+		auto pImage = std::make_shared<Image>(*pDevice_, name, imageCreateInfo, aspectFlags, samplerCreateInfo, memoryType);
+		TransientImage transientImage{};
+		transientImage.pImage = pImage;
+		transientImageIndices_[pImage.get()] = static_cast<uint32_t>(transientImages_.size());
+		transientImages_.push_back(transientImage);
+		return pImage;
+	}
+
+	void RenderGraph::ReleaseTransientMemory()
+	{
+		for (auto& transientImage : transientImages_) {
+			if (transientImage.memoryIndex < 0) {
+				continue;
+			}
+			transientImage.memoryIndex = -1;
+			transientImage.offset = 0;
+			transientImage.size = 0;
+			resourceStates_.erase(transientImage.pImage.get());
+			// Recreated without memory, bound again by the next plan
+			vk::Extent3D extent = transientImage.pImage->GetExtent3D();
+			transientImage.pImage->Recreate(extent.width, extent.height);
+		}
+		for (size_t i = 0; i < transientMemories_.size(); i++) {
+			pDevice_->UntrackAllocation(MemoryCategory::Attachment, transientMemorySizes_[i]);
+			vmaFreeMemory(pDevice_->GetAllocator(), transientMemories_[i]);
+		}
+		transientMemories_.clear();
+		transientMemorySizes_.clear();
+	}
+
+	void RenderGraph::MarkOutput(ImageHandle pImage)
+	{
+		outputs_.push_back(pImage.get());
+		isCompiled_ = false;
+	}
+
+	void RenderGraph::MarkOutput(BufferHandle pBuffer)
+	{
+		outputs_.push_back(pBuffer.get());
+		isCompiled_ = false;
+	}
+
+	void RenderGraph::Compile()
+	{
+		CompileInternal(true);
+	}
+
+	void RenderGraph::CompileInternal(bool isReplanAllowed)
+	{
+		struct ResourceUsage
+		{
+			int lastWriter = -1;
+			std::vector<uint32_t> readersSinceWrite;
+		};
+		std::unordered_map<const void*, ResourceUsage> resourceUsages;
+
+		// Dependencies in declaration order
+		for (uint32_t passIndex = 0; passIndex < passes_.size(); passIndex++) {
+			Pass& pass = passes_[passIndex];
+			pass.producers.clear();
+			pass.predecessors.clear();
+
+			// Accesses to the same resource in a pass are merged
+			std::vector<std::pair<const void*, std::pair<bool, bool>>> accesses;
+			auto addAccess = [&accesses](const void* resource, bool isRead, bool isWrite) {
+				for (auto& access : accesses) {
+					if (access.first == resource) {
+						access.second.first |= isRead;
+						access.second.second |= isWrite;
+						return;
+					}
+				}
+				accesses.push_back({ resource, { isRead, isWrite } });
+			};
+			for (const auto& imageAccess : pass.imageAccesses) {
+				addAccess(imageAccess.pImage.get(), imageAccess.isRead, imageAccess.isWrite);
+			}
+			for (const auto& bufferAccess : pass.bufferAccesses) {
+				addAccess(bufferAccess.pBuffer.get(), bufferAccess.isRead, bufferAccess.isWrite);
+			}
+
+			for (const auto& [resource, readWrite] : accesses) {
+				auto& usage = resourceUsages[resource];
+				auto [isRead, isWrite] = readWrite;
+				if (isRead && usage.lastWriter >= 0) {
+					// Read after write, the writer is needed by this pass
+					AddUnique(pass.producers, static_cast<uint32_t>(usage.lastWriter));
+					AddUnique(pass.predecessors, static_cast<uint32_t>(usage.lastWriter));
+				}
+				if (isWrite) {
+					// Write after write and write after read only order the passes
+					if (usage.lastWriter >= 0 && usage.lastWriter != static_cast<int>(passIndex)) {
+						AddUnique(pass.predecessors, static_cast<uint32_t>(usage.lastWriter));
+					}
+					for (uint32_t reader : usage.readersSinceWrite) {
+						if (reader != passIndex) {
+							AddUnique(pass.predecessors, reader);
+						}
+					}
+					usage.lastWriter = static_cast<int>(passIndex);
+					usage.readersSinceWrite.clear();
+				}
+				else {
+					usage.readersSinceWrite.push_back(passIndex);
+				}
+			}
+		}
+
+		// Culling, passes are kept if they have side effects or write outputs or what they read
+		std::vector<uint32_t> stack;
+		for (uint32_t passIndex = 0; passIndex < passes_.size(); passIndex++) {
+			passes_[passIndex].isCulled = true;
+			if (passes_[passIndex].hasSideEffect) {
+				stack.push_back(passIndex);
+			}
+		}
+		for (const void* output : outputs_) {
+			auto it = resourceUsages.find(output);
+			if (it != resourceUsages.end() && it->second.lastWriter >= 0) {
+				stack.push_back(static_cast<uint32_t>(it->second.lastWriter));
+			}
+		}
+		if (stack.empty() && !passes_.empty()) {
+			cerr << "Warning: RenderGraph " << name_ << " has no outputs or side effects, all passes are culled" << endl;
+		}
+		while (!stack.empty()) {
+			uint32_t passIndex = stack.back();
+			stack.pop_back();
+			if (!passes_[passIndex].isCulled) {
+				continue;
+			}
+			passes_[passIndex].isCulled = false;
+			for (uint32_t producer : passes_[passIndex].producers) {
+				stack.push_back(producer);
+			}
+		}
+
+		// Ordering, prefers a pass independent of the previous one to keep producers and consumers apart
+		std::vector<uint32_t> inDegrees(passes_.size(), 0);
+		std::vector<std::vector<uint32_t>> successors(passes_.size());
+		for (uint32_t passIndex = 0; passIndex < passes_.size(); passIndex++) {
+			if (passes_[passIndex].isCulled) {
+				continue;
+			}
+			for (uint32_t predecessor : passes_[passIndex].predecessors) {
+				if (!passes_[predecessor].isCulled) {
+					successors[predecessor].push_back(passIndex);
+					inDegrees[passIndex]++;
+				}
+			}
+		}
+		std::vector<uint32_t> readyPasses;
+		for (uint32_t passIndex = 0; passIndex < passes_.size(); passIndex++) {
+			if (!passes_[passIndex].isCulled && inDegrees[passIndex] == 0) {
+				readyPasses.push_back(passIndex);
+			}
+		}
+		executionOrder_.clear();
+		while (!readyPasses.empty()) {
+			auto selected = readyPasses.begin();
+			if (!executionOrder_.empty()) {
+				const auto& prevSuccessors = successors[executionOrder_.back()];
+				auto independent = std::find_if(readyPasses.begin(), readyPasses.end(), [&prevSuccessors](uint32_t passIndex) {
+					return std::find(prevSuccessors.begin(), prevSuccessors.end(), passIndex) == prevSuccessors.end();
+				});
+				if (independent != readyPasses.end()) {
+					selected = independent;
+				}
+			}
+			uint32_t passIndex = *selected;
+			readyPasses.erase(selected);
+			executionOrder_.push_back(passIndex);
+			for (uint32_t successor : successors[passIndex]) {
+				if (--inDegrees[successor] == 0) {
+					// Kept sorted so that ties follow the declaration order
+					readyPasses.insert(std::upper_bound(readyPasses.begin(), readyPasses.end(), successor), successor);
+				}
+			}
+		}
+
+		isCompiled_ = true;
+		PlanTransientMemory(isReplanAllowed);
+	}
+
+	bool RenderGraph::IsAliased(const TransientImage& lhs, const TransientImage& rhs) const
+	{
+		return lhs.memoryIndex >= 0 && lhs.memoryIndex == rhs.memoryIndex
+			&& lhs.offset < rhs.offset + rhs.size && rhs.offset < lhs.offset + lhs.size;
+	}
+
+	void RenderGraph::PlanTransientMemory(bool isReplanAllowed)
+	{
+		for (auto& transientImage : transientImages_) {
+			transientImage.firstUse = -1;
+			transientImage.lastUse = -1;
+			// Unbound by Recreate, the old range is no longer used
+			if (transientImage.pImage->GetMemoryType() == ImageMemoryType::Aliased && !transientImage.pImage->IsMemoryBound()) {
+				transientImage.memoryIndex = -1;
+			}
+		}
+		for (uint32_t position = 0; position < executionOrder_.size(); position++) {
+			for (const auto& imageAccess : passes_[executionOrder_[position]].imageAccesses) {
+				auto it = transientImageIndices_.find(imageAccess.pImage.get());
+				if (it == transientImageIndices_.end()) {
+					continue;
+				}
+				auto& transientImage = transientImages_[it->second];
+				if (transientImage.firstUse < 0) {
+					transientImage.firstUse = static_cast<int>(position);
+				}
+				transientImage.lastUse = static_cast<int>(position);
+			}
+		}
+		auto isLifetimeOverlapped = [](const TransientImage& lhs, const TransientImage& rhs) {
+			return lhs.firstUse >= 0 && rhs.firstUse >= 0 && lhs.firstUse <= rhs.lastUse && rhs.firstUse <= lhs.lastUse;
+		};
+
+		// Images bound by a previous plan can't move, so the memory is planned again from scratch
+		// if their lifetimes overlap now or unbound images would need allocations next to the old ones
+		bool isUnboundImage = false;
+		bool isOverlapped = false;
+		for (uint32_t i = 0; i < transientImages_.size(); i++) {
+			const auto& transientImage = transientImages_[i];
+			if (!transientMemories_.empty() && transientImage.firstUse >= 0 && transientImage.memoryIndex < 0
+				&& transientImage.pImage->GetMemoryType() == ImageMemoryType::Aliased) {
+				isUnboundImage = true;
+			}
+			for (uint32_t j = i + 1; j < transientImages_.size(); j++) {
+				if (IsAliased(transientImage, transientImages_[j]) && isLifetimeOverlapped(transientImage, transientImages_[j])) {
+					isOverlapped = true;
+				}
+			}
+		}
+		if (isUnboundImage || isOverlapped) {
+			if (isReplanAllowed) {
+				cerr << "Warning: RenderGraph " << name_ << " re-plans its transient memory, the device is idled and the aliased images are recreated" << endl;
+				// Frames in flight may still use the old memory and images
+				for (const auto& [type, context] : pDevice_->GetQueueContexts()) {
+					pDevice_->WaitIdle(type);
+				}
+				ReleaseTransientMemory();
+			}
+			else if (isOverlapped) {
+				// Aliased images used at the same time would overwrite each other
+				throw std::runtime_error("Transient images of RenderGraph " + name_ + " no longer fit the memory plan, call Compile() outside of the frame");
+			}
+			else {
+				// Unbound images get new allocations next to the old ones until the next Compile()
+				cerr << "Warning: RenderGraph " << name_ << " allocates extra transient memory, call Compile() outside of the frame to re-plan it" << endl;
+			}
+		}
+
+		// Images are grouped by the memory types they accept, each group gets one allocation
+		std::map<uint32_t, std::vector<uint32_t>> groups;
+		for (uint32_t i = 0; i < transientImages_.size(); i++) {
+			auto& transientImage = transientImages_[i];
+			if (transientImage.memoryIndex >= 0 || transientImage.firstUse < 0 || transientImage.pImage->GetMemoryType() != ImageMemoryType::Aliased) {
+				continue;
+			}
+			groups[transientImage.pImage->GetMemoryRequirements().memoryTypeBits].push_back(i);
+		}
+
+		for (auto& [memoryTypeBits, indices] : groups) {
+			std::vector<vk::MemoryRequirements> requirements(transientImages_.size());
+			for (uint32_t index : indices) {
+				requirements[index] = transientImages_[index].pImage->GetMemoryRequirements();
+			}
+			// Larger images first, each takes the lowest offset free during its lifetime
+			std::sort(indices.begin(), indices.end(), [&requirements](uint32_t lhs, uint32_t rhs) {
+				return requirements[lhs].size > requirements[rhs].size;
+			});
+			std::vector<uint32_t> placedIndices;
+			vk::DeviceSize totalSize = 0;
+			vk::DeviceSize maxAlignment = 1;
+			for (uint32_t index : indices) {
+				auto& transientImage = transientImages_[index];
+				const auto& requirement = requirements[index];
+
+				std::vector<std::pair<vk::DeviceSize, vk::DeviceSize>> usedRanges;
+				for (uint32_t placedIndex : placedIndices) {
+					const auto& placedImage = transientImages_[placedIndex];
+					if (isLifetimeOverlapped(transientImage, placedImage)) {
+						usedRanges.push_back({ placedImage.offset, placedImage.offset + placedImage.size });
+					}
+				}
+				std::sort(usedRanges.begin(), usedRanges.end());
+				vk::DeviceSize offset = 0;
+				for (const auto& [begin, end] : usedRanges) {
+					if (offset + requirement.size <= begin) {
+						break;
+					}
+					offset = std::max(offset, AlignUp(end, requirement.alignment));
+				}
+
+				transientImage.offset = offset;
+				transientImage.size = requirement.size;
+				totalSize = std::max(totalSize, offset + requirement.size);
+				maxAlignment = std::max(maxAlignment, requirement.alignment);
+				placedIndices.push_back(index);
+			}
+
+			VkMemoryRequirements memoryRequirements{};
+			memoryRequirements.size = totalSize;
+			memoryRequirements.alignment = maxAlignment;
+			memoryRequirements.memoryTypeBits = memoryTypeBits;
+			VmaAllocationCreateInfo allocCreateInfo{};
+			allocCreateInfo.preferredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+			VmaAllocation allocation = nullptr;
+			if (vmaAllocateMemory(pDevice_->GetAllocator(), &memoryRequirements, &allocCreateInfo, &allocation, nullptr) != VK_SUCCESS) {
+				throw std::runtime_error("Failed to allocate transient memory!");
+			}
+			vmaSetAllocationName(pDevice_->GetAllocator(), allocation, (name_ + "_TransientMemory").c_str());
+			pDevice_->TrackAllocation(MemoryCategory::Attachment, totalSize);
+
+			int memoryIndex = static_cast<int>(transientMemories_.size());
+			transientMemories_.push_back(allocation);
+			transientMemorySizes_.push_back(totalSize);
+			for (uint32_t index : placedIndices) {
+				transientImages_[index].memoryIndex = memoryIndex;
+				transientImages_[index].pImage->BindMemory(allocation, transientImages_[index].offset);
+			}
+		}
+	}
+
+	void RenderGraph::AddImageBarrier(const ImageAccess& imageAccess, const LayoutSyncInfo* pAliasSrc)
+	{
+		vk::ImageLayout currentLayout = imageAccess.pImage->GetImageLayout();
+		auto it = resourceStates_.find(imageAccess.pImage.get());
+		// The state is stale if the layout was changed outside the graph
+		bool isTracked = it != resourceStates_.end() && it->second.layout == currentLayout;
+		bool isPrevWrite = isTracked && it->second.isWrite;
+		if (!pAliasSrc && currentLayout == imageAccess.layout && !isPrevWrite && !imageAccess.isWrite) {
+			// Read after read
+			return;
+		}
+
+		LayoutSyncInfo src = GetLayoutSyncInfo(currentLayout);
+		if (pAliasSrc) {
+			// Waits for the images which used the memory before
+			src = *pAliasSrc;
+		}
+		else if (isTracked) {
+			src.stageMask = it->second.stageMask;
+			src.accessMask = isPrevWrite ? it->second.accessMask : vk::AccessFlags2{};
+		}
+		// Write only accesses and aliased memory don't keep the previous contents
+		vk::ImageLayout oldLayout = (imageAccess.isRead && !pAliasSrc) ? currentLayout : vk::ImageLayout::eUndefined;
+		barrierBatcher_.AddImageBarrier(
+			vk::ImageMemoryBarrier2()
+			.setSrcStageMask(src.stageMask)
+			.setSrcAccessMask(src.accessMask)
+			.setDstStageMask(imageAccess.stageMask)
+			.setDstAccessMask(imageAccess.accessMask)
+			.setOldLayout(oldLayout)
+			.setNewLayout(imageAccess.layout)
+			.setSrcQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+			.setDstQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+			.setImage(imageAccess.pImage->GetImage())
+			.setSubresourceRange(
+				vk::ImageSubresourceRange()
+				.setAspectMask(imageAccess.pImage->GetAspectFlags())
+				.setBaseMipLevel(0)
+				.setLevelCount(imageAccess.pImage->GetMipLevels())
+				.setBaseArrayLayer(0)
+				.setLayerCount(imageAccess.pImage->GetArrayLayers())
+			)
+		);
+		imageAccess.pImage->SetImageLayout(imageAccess.layout);
+	}
+
+	void RenderGraph::AddBufferBarrier(const BufferAccess& bufferAccess)
+	{
+		auto it = resourceStates_.find(bufferAccess.pBuffer.get());
+		// NOTE : Writes before the first use (e.g. uploads) are already visible
+		if (it == resourceStates_.end()) {
+			return;
+		}
+		const ResourceState& state = it->second;
+		if (!state.isWrite && !bufferAccess.isWrite) {
+			return;
+		}
+		barrierBatcher_.AddBufferBarrier(
+			bufferAccess.pBuffer,
+			state.stageMask, state.isWrite ? state.accessMask : vk::AccessFlags2{},
+			bufferAccess.stageMask, bufferAccess.accessMask
+		);
+	}
+
+	void RenderGraph::UpdateImageState(const ImageAccess& imageAccess)
+	{
+		auto& state = resourceStates_[imageAccess.pImage.get()];
+		if (!imageAccess.isWrite && !state.isWrite && state.layout == imageAccess.layout && state.stageMask) {
+			// Later writes wait for all readers
+			state.stageMask |= imageAccess.stageMask;
+			state.accessMask |= imageAccess.accessMask;
+		}
+		else {
+			state.stageMask = imageAccess.stageMask;
+			state.accessMask = imageAccess.accessMask;
+			state.isWrite = imageAccess.isWrite;
+		}
+		state.layout = imageAccess.layout;
+		if (imageAccess.finalLayout != vk::ImageLayout::eUndefined) {
+			state.layout = imageAccess.finalLayout;
+			imageAccess.pImage->SetImageLayout(imageAccess.finalLayout);
+		}
+	}
+
+	void RenderGraph::UpdateBufferState(const BufferAccess& bufferAccess)
+	{
+		auto it = resourceStates_.find(bufferAccess.pBuffer.get());
+		if (it != resourceStates_.end() && !bufferAccess.isWrite && !it->second.isWrite) {
+			it->second.stageMask |= bufferAccess.stageMask;
+			it->second.accessMask |= bufferAccess.accessMask;
+			return;
+		}
+		resourceStates_[bufferAccess.pBuffer.get()] = ResourceState{ bufferAccess.stageMask, bufferAccess.accessMask, vk::ImageLayout::eUndefined, bufferAccess.isWrite };
+	}
+
+	void RenderGraph::Execute(CommandBufferHandle pCommandBuffer)
+	{
+		CpuProfileScope profileScope(pDevice_->GetProfiler().get(), "Record");
+		barrierBatcher_.SetQueueFlags(pCommandBuffer->GetQueueFlags());
+		// NOTE : Never re-plans here, it would stall the device in the middle of the frame
+		if (!isCompiled_) {
+			CompileInternal(false);
+		}
+		else {
+			for (const auto& transientImage : transientImages_) {
+				if (transientImage.firstUse >= 0 && !transientImage.pImage->IsMemoryBound()) {
+					// Recreated since the last plan
+					PlanTransientMemory(false);
+					break;
+				}
+			}
+		}
+
+		std::vector<bool> isTransientUsed(transientImages_.size(), false);
+		for (uint32_t passIndex : executionOrder_) {
+			const Pass& pass = passes_[passIndex];
+			for (const auto& imageAccess : pass.imageAccesses) {
+				auto transientIt = transientImageIndices_.find(imageAccess.pImage.get());
+				if (transientIt == transientImageIndices_.end() || transientImages_[transientIt->second].memoryIndex < 0 || isTransientUsed[transientIt->second]) {
+					AddImageBarrier(imageAccess);
+					continue;
+				}
+				isTransientUsed[transientIt->second] = true;
+				const auto& transientImage = transientImages_[transientIt->second];
+				LayoutSyncInfo aliasSrc{};
+				for (const auto& otherImage : transientImages_) {
+					if (!IsAliased(transientImage, otherImage)) {
+						continue;
+					}
+					auto stateIt = resourceStates_.find(otherImage.pImage.get());
+					if (stateIt != resourceStates_.end()) {
+						aliasSrc.stageMask |= stateIt->second.stageMask;
+						if (stateIt->second.isWrite) {
+							aliasSrc.accessMask |= stateIt->second.accessMask;
+						}
+					}
+				}
+				AddImageBarrier(imageAccess, &aliasSrc);
+			}
+			for (const auto& bufferAccess : pass.bufferAccesses) {
+				AddBufferBarrier(bufferAccess);
+			}
+			// Barriers queued on the command buffer come first
+			pCommandBuffer->FlushBarriers();
+			barrierBatcher_.Flush(pCommandBuffer->GetCommandBuffer());
+
+			if (pass.execute) {
+				// Secondary command buffers can't be executed in an active query without inheritedQueries
+				bool isStatistics = !pass.isSecondaryCommandBuffers || pDevice_->GetEnabledFeatures().inheritedQueries;
+				pCommandBuffer->BeginProfileScope(pass.name);
+				if (isStatistics) {
+					pCommandBuffer->BeginStatisticsScope(pass.name);
+				}
+				pass.execute(pCommandBuffer);
+				if (isStatistics) {
+					pCommandBuffer->EndStatisticsScope();
+				}
+				pCommandBuffer->EndProfileScope();
+			}
+
+			for (const auto& imageAccess : pass.imageAccesses) {
+				UpdateImageState(imageAccess);
+			}
+			for (const auto& bufferAccess : pass.bufferAccesses) {
+				UpdateBufferState(bufferAccess);
+			}
+		}
+	}
+
+	void RenderGraph::Reset()
+	{
+		passes_.clear();
+		outputs_.clear();
+		executionOrder_.clear();
+		isCompiled_ = false;
+	}
+
+	const std::vector<uint32_t>& RenderGraph::GetExecutionOrder() const
+	{
+		return executionOrder_;
+	}
+
+	uint32_t RenderGraph::GetPassCount() const
+	{
+		return static_cast<uint32_t>(passes_.size());
+	}
+
+	uint32_t RenderGraph::GetCulledPassCount() const
+	{
+		return static_cast<uint32_t>(std::count_if(passes_.begin(), passes_.end(), [](const Pass& pass) { return pass.isCulled; }));
+	}
+
+	bool RenderGraph::IsCulled(uint32_t passIndex) const
+	{
+		return passes_.at(passIndex).isCulled;
+	}
+
+	std::string RenderGraph::GetPassName(uint32_t passIndex) const
+	{
+		return passes_.at(passIndex).name;
+	}
+
+	vk::DeviceSize RenderGraph::GetTransientMemorySize() const
+	{
+		vk::DeviceSize size = 0;
+		for (vk::DeviceSize memorySize : transientMemorySizes_) {
+			size += memorySize;
+		}
+		return size;
+	}
+
+	vk::DeviceSize RenderGraph::GetTransientRequiredSize() const
+	{
+		vk::DeviceSize size = 0;
+		for (const auto& transientImage : transientImages_) {
+			if (transientImage.memoryIndex >= 0) {
+				size += transientImage.size;
+			}
+		}
+		return size;
+	}
+}
\ No newline at end of file
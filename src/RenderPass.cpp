@@ -1,10 +1,55 @@
 #include "RenderPass.hpp"
 
 #include "Device.hpp"
+#include "Hash.hpp"
 #include "Swapchain.hpp"
 
 using namespace std;
 
+namespace
+{
+    uint64_t ComputeCompatibilityHash(
+        const std::vector<vk::AttachmentDescription>& attachments,
+        const std::vector<vk::SubpassDescription>& subpasses,
+        const std::vector<vk::SubpassDependency>& dependencies)
+    {
+        using namespace sqrp;
+
+        uint64_t hash = HashValue(static_cast<uint32_t>(attachments.size()));
+        for (const auto& attachment : attachments) {
+            hash = HashValue(static_cast<VkFormat>(attachment.format), hash);
+            hash = HashValue(static_cast<VkSampleCountFlagBits>(attachment.samples), hash);
+        }
+
+        hash = HashValue(static_cast<uint32_t>(subpasses.size()), hash);
+        for (const auto& subpass : subpasses) {
+            hash = HashValue(subpass.inputAttachmentCount, hash);
+            for (uint32_t i = 0; i < subpass.inputAttachmentCount; i++) {
+                hash = HashValue(subpass.pInputAttachments[i].attachment, hash);
+            }
+            hash = HashValue(subpass.colorAttachmentCount, hash);
+            for (uint32_t i = 0; i < subpass.colorAttachmentCount; i++) {
+                hash = HashValue(subpass.pColorAttachments[i].attachment, hash);
+            }
+            uint32_t depthAttachment = subpass.pDepthStencilAttachment ? subpass.pDepthStencilAttachment->attachment : VK_ATTACHMENT_UNUSED;
+            hash = HashValue(depthAttachment, hash);
+        }
+
+        hash = HashValue(static_cast<uint32_t>(dependencies.size()), hash);
+        for (const auto& dependency : dependencies) {
+            hash = HashValue(dependency.srcSubpass, hash);
+            hash = HashValue(dependency.dstSubpass, hash);
+            hash = HashValue(static_cast<VkPipelineStageFlags>(dependency.srcStageMask), hash);
+            hash = HashValue(static_cast<VkPipelineStageFlags>(dependency.dstStageMask), hash);
+            hash = HashValue(static_cast<VkAccessFlags>(dependency.srcAccessMask), hash);
+            hash = HashValue(static_cast<VkAccessFlags>(dependency.dstAccessMask), hash);
+            hash = HashValue(static_cast<VkDependencyFlags>(dependency.dependencyFlags), hash);
+        }
+
+        return hash;
+    }
+}
+
 namespace sqrp
 {
 	RenderPass::RenderPass(
@@ -17,6 +62,7 @@ namespace sqrp
 	{
         numColorAttachments_ = 1;
 		numDepthAttachments_ = 1;
+        subpassColorAttachmentCounts_ = { 1 };
 
 		// Color Attachment for swapchain
         vk::AttachmentDescription colorAttachment{};
@@ -85,36 +131,51 @@ namespace sqrp
             vk::ObjectType::eRenderPass,
             name + "_RenderPass"
 		);
+
+        compatibilityHash_ = ComputeCompatibilityHash(attachments, { subpass }, {});
 	}
 
     RenderPass::RenderPass(
         const Device& device,
         std::string name,
         std::vector<SubPassInfo> subPassInfos,
-        std::map<string, AttachmentInfo> attachmentNameToInfo
+        std::map<string, AttachmentInfo> attachmentNameToInfo,
+        std::vector<std::string> attachmentOrder
 	) : pDevice_(&device)
     {
-        vector<vk::AttachmentDescription> attachmentsDescs;
-		std::map<string, int> attachmentNameToDescID;
+        uniqueAttachmentNames_ = attachmentOrder;
         for (int i = 0; i < subPassInfos.size(); i++) {
             for (int j = 0; j < subPassInfos[i].attachmentInfos.size(); j++) {
 				string attachmentName = subPassInfos[i].attachmentInfos[j];
                 if (std::find(uniqueAttachmentNames_.begin(), uniqueAttachmentNames_.end(), attachmentName) == uniqueAttachmentNames_.end()) {
-					int uniqueID = static_cast<int>(uniqueAttachmentNames_.size());
-					uniqueAttachmentNames_.push_back(attachmentName);
-                    attachmentsDescs.push_back(attachmentNameToInfo[attachmentName].attachmentDesc);
-                    attachmentNameToDescID[attachmentName] = uniqueID;
-                    if (attachmentNameToInfo[attachmentName].imageLayout == vk::ImageLayout::eColorAttachmentOptimal) {
-                        numColorAttachments_++;
-                    }
-                    else if (attachmentNameToInfo[attachmentName].imageLayout == vk::ImageLayout::eDepthStencilAttachmentOptimal) {
-                        numDepthAttachments_++;
+                    if (!attachmentOrder.empty()) {
+                        throw std::runtime_error("Attachment " + attachmentName + " is not in attachmentOrder");
                     }
-                    attachmentInfos_.push_back(attachmentNameToInfo[attachmentName]);
+					uniqueAttachmentNames_.push_back(attachmentName);
                 }
             }
         }
 
+        vector<vk::AttachmentDescription> attachmentsDescs;
+		std::map<string, int> attachmentNameToDescID;
+        for (int i = 0; i < uniqueAttachmentNames_.size(); i++) {
+            const string& attachmentName = uniqueAttachmentNames_[i];
+            auto attachmentInfoItr = attachmentNameToInfo.find(attachmentName);
+            if (attachmentInfoItr == attachmentNameToInfo.end()) {
+                throw std::runtime_error("Attachment " + attachmentName + " is not in attachmentNameToInfo");
+            }
+            const AttachmentInfo& attachmentInfo = attachmentInfoItr->second;
+            attachmentsDescs.push_back(attachmentInfo.attachmentDesc);
+            attachmentNameToDescID[attachmentName] = i;
+            if (attachmentInfo.imageLayout == vk::ImageLayout::eColorAttachmentOptimal) {
+                numColorAttachments_++;
+            }
+            else if (attachmentInfo.imageLayout == vk::ImageLayout::eDepthStencilAttachmentOptimal) {
+                numDepthAttachments_++;
+            }
+            attachmentInfos_.push_back(attachmentInfo);
+        }
+
         vector<vk::SubpassDescription> subPassDescs;
         subPassDescs.resize(subPassInfos.size());
         vector<vector<vk::AttachmentReference>> allColorRefs(subPassInfos.size());
@@ -122,20 +183,23 @@ namespace sqrp
         for (int i = 0; i < subPassInfos.size(); i++) {
             for (int j = 0; j < subPassInfos[i].attachmentInfos.size(); j++) {
                 string attachmentName = subPassInfos[i].attachmentInfos[j];
-                if (attachmentNameToInfo[attachmentName].imageLayout == vk::ImageLayout::eColorAttachmentOptimal) {
+                // NOTE : Every subpass attachment was checked above
+                vk::ImageLayout imageLayout = attachmentNameToInfo.at(attachmentName).imageLayout;
+                if (imageLayout == vk::ImageLayout::eColorAttachmentOptimal) {
                     allColorRefs[i].push_back(
                         vk::AttachmentReference{}
-                        .setAttachment(attachmentNameToDescID[attachmentName])
+                        .setAttachment(attachmentNameToDescID.at(attachmentName))
                         .setLayout(vk::ImageLayout::eColorAttachmentOptimal)
 					);
                 }
-                else if (attachmentNameToInfo[attachmentName].imageLayout == vk::ImageLayout::eDepthStencilAttachmentOptimal) {
+                else if (imageLayout == vk::ImageLayout::eDepthStencilAttachmentOptimal) {
                     allDepthRefs[i] = vk::AttachmentReference{}
-                        .setAttachment(attachmentNameToDescID[attachmentName])
+                        .setAttachment(attachmentNameToDescID.at(attachmentName))
                         .setLayout(vk::ImageLayout::eDepthStencilAttachmentOptimal);
                 }
 			}
 
+			subpassColorAttachmentCounts_.push_back(static_cast<int>(allColorRefs[i].size()));
 			subPassDescs[i] = vk::SubpassDescription{}
 				.setPipelineBindPoint(vk::PipelineBindPoint::eGraphics)
 				.setColorAttachmentCount(static_cast<uint32_t>(allColorRefs[i].size()))
@@ -143,7 +207,7 @@ namespace sqrp
 				.setPDepthStencilAttachment(allDepthRefs[i] ? &(*allDepthRefs[i]) : nullptr);
         }
 
-		// NOTE : multi subpass synchronization is not supported yet.
+        vector<vk::SubpassDependency> dependencies;
         vk::SubpassDependency dependency{};
         dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
         dependency.dstSubpass = 0;
@@ -152,6 +216,23 @@ namespace sqrp
         dependency.srcAccessMask = {};
         dependency.dstAccessMask = vk::AccessFlagBits::eColorAttachmentWrite | vk::AccessFlagBits::eDepthStencilAttachmentWrite;
 		dependency.dependencyFlags = vk::DependencyFlagBits::eByRegion;  // Synchronize within the pixel region
+        dependencies.push_back(dependency);
+
+        // NOTE : Subpasses are executed in order, attachment writes of the previous subpass are visible to depth test / color blend / input attachment reads
+        for (uint32_t i = 1; i < subPassDescs.size(); i++) {
+            vk::SubpassDependency subpassDependency{};
+            subpassDependency.srcSubpass = i - 1;
+            subpassDependency.dstSubpass = i;
+            subpassDependency.srcStageMask = vk::PipelineStageFlagBits::eColorAttachmentOutput | vk::PipelineStageFlagBits::eLateFragmentTests;
+            subpassDependency.dstStageMask = vk::PipelineStageFlagBits::eColorAttachmentOutput | vk::PipelineStageFlagBits::eEarlyFragmentTests | vk::PipelineStageFlagBits::eFragmentShader;
+            subpassDependency.srcAccessMask = vk::AccessFlagBits::eColorAttachmentWrite | vk::AccessFlagBits::eDepthStencilAttachmentWrite;
+            subpassDependency.dstAccessMask =
+                vk::AccessFlagBits::eColorAttachmentRead | vk::AccessFlagBits::eColorAttachmentWrite |
+                vk::AccessFlagBits::eDepthStencilAttachmentRead | vk::AccessFlagBits::eDepthStencilAttachmentWrite |
+                vk::AccessFlagBits::eInputAttachmentRead;
+            subpassDependency.dependencyFlags = vk::DependencyFlagBits::eByRegion;
+            dependencies.push_back(subpassDependency);
+        }
 
         vk::RenderPassCreateInfo renderPassInfo{};
         renderPassInfo
@@ -159,8 +240,7 @@ namespace sqrp
             .setPAttachments(attachmentsDescs.data())
             .setSubpassCount(subPassDescs.size())
             .setPSubpasses(subPassDescs.data())
-            .setDependencyCount(1)
-            .setPDependencies(&dependency);
+            .setDependencies(dependencies);
 
 		renderPass_ = pDevice_->GetDevice().createRenderPassUnique(renderPassInfo);
         pDevice_->SetObjectName(
@@ -168,6 +248,8 @@ namespace sqrp
             vk::ObjectType::eRenderPass,
             name + "_RenderPass"
         );
+
+        compatibilityHash_ = ComputeCompatibilityHash(attachmentsDescs, subPassDescs, dependencies);
     }
 
     vk::RenderPass RenderPass::GetRenderPass() const
@@ -180,6 +262,14 @@ namespace sqrp
 		return numColorAttachments_;
     }
 
+    int RenderPass::GetNumSubpassColorAttachments(uint32_t subpass) const
+    {
+        if (subpass >= subpassColorAttachmentCounts_.size()) {
+            throw std::runtime_error("Subpass index is out of range");
+        }
+        return subpassColorAttachmentCounts_[subpass];
+    }
+
     int RenderPass::GetNumAttachments() const
     {
         return numColorAttachments_ + numDepthAttachments_;
@@ -189,4 +279,9 @@ namespace sqrp
     {
 		return attachmentInfos_;
     }
+
+    uint64_t RenderPass::GetCompatibilityHash() const
+    {
+        return compatibilityHash_;
+    }
 }
\ No newline at end of file
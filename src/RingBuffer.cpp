@@ -0,0 +1,100 @@
+#include "RingBuffer.hpp"
+
+#include "Buffer.hpp"
+#include "Device.hpp"
+
+using namespace std;
+
+namespace
+{
+	vk::DeviceSize AlignUp(vk::DeviceSize value, vk::DeviceSize alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+}
+
+namespace sqrp
+{
+	RingBuffer::RingBuffer(const Device& device, std::string name, vk::DeviceSize frameSize, uint32_t inflightCount, vk::BufferUsageFlags usage)
+		: pDevice_(&device), inflightCount_(inflightCount)
+	{
+		if (inflightCount_ == 0) {
+			throw std::runtime_error("RingBuffer requires at least one inflight frame");
+		}
+
+		const auto& limits = pDevice_->GetPhysicalDevice().getProperties().limits;
+		alignment_ = 1;
+		if (usage & vk::BufferUsageFlagBits::eUniformBuffer) {
+			alignment_ = std::max(alignment_, limits.minUniformBufferOffsetAlignment);
+		}
+		if (usage & vk::BufferUsageFlagBits::eStorageBuffer) {
+			alignment_ = std::max(alignment_, limits.minStorageBufferOffsetAlignment);
+		}
+		// Regions start at an aligned offset
+		frameSize_ = AlignUp(frameSize, alignment_);
+
+		pBuffer_ = pDevice_->CreateBuffer(
+			name + "_Ring",
+			static_cast<int>(frameSize_ * inflightCount_),
+			usage,
+			VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT,
+			VMA_MEMORY_USAGE_AUTO_PREFER_HOST
+		);
+		pMappedData_ = static_cast<uint8_t*>(pBuffer_->GetMappedData());
+		if (!pMappedData_) {
+			throw std::runtime_error("Failed to map ring buffer");
+		}
+	}
+
+	void RingBuffer::BeginFrame(uint32_t inflightIndex)
+	{
+		if (inflightIndex >= inflightCount_) {
+			throw std::runtime_error("Inflight index is out of range");
+		}
+		inflightIndex_ = inflightIndex;
+		head_ = 0;
+	}
+
+	RingAllocation RingBuffer::Allocate(vk::DeviceSize size)
+	{
+		vk::DeviceSize offset = AlignUp(head_, alignment_);
+		if (offset + size > frameSize_) {
+			throw std::runtime_error("RingBuffer frame region is full");
+		}
+		head_ = offset + size;
+
+		vk::DeviceSize bufferOffset = frameSize_ * inflightIndex_ + offset;
+		RingAllocation allocation{};
+		allocation.offset = static_cast<uint32_t>(bufferOffset);
+		allocation.size = size;
+		allocation.pData = pMappedData_ + bufferOffset;
+		return allocation;
+	}
+
+	void RingBuffer::Flush()
+	{
+		if (head_ > 0 && !pBuffer_->IsHostCoherent()) {
+			pBuffer_->Flush(frameSize_ * inflightIndex_, head_);
+		}
+	}
+
+	BufferHandle RingBuffer::GetBuffer() const
+	{
+		return pBuffer_;
+	}
+
+	vk::DeviceSize RingBuffer::GetAlignment() const
+	{
+		return alignment_;
+	}
+
+	vk::DeviceSize RingBuffer::GetFrameSize() const
+	{
+		return frameSize_;
+	}
+
+	vk::DeviceSize RingBuffer::GetUsedSize() const
+	{
+		return head_;
+	}
+}
\ No newline at end of file
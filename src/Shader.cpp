@@ -1,46 +1,53 @@
 #include "Shader.hpp"
 
 #include "Device.hpp"
+#include "Hash.hpp"
 
-namespace sqrp
+namespace
 {
-	Shader::Shader(const Device& device, const Compiler& compiler, const std::string& fileName, ShaderType shaderType)
-		: pDevice_(&device), pCompiler_(&compiler)
-	{
-		std::filesystem::path path(fileName);
-		std::string name = path.stem().string();
+    vk::ShaderStageFlagBits ToShaderStage(sqrp::ShaderType shaderType)
+    {
         switch (shaderType) {
-        case ShaderType::Vertex:
-            shaderStage_ = vk::ShaderStageFlagBits::eVertex; name + "_vertex"; break;
-        case ShaderType::Pixel:
-            shaderStage_ = vk::ShaderStageFlagBits::eFragment; name + "_fragment"; break;
-        case ShaderType::Geometry:
-            shaderStage_ = vk::ShaderStageFlagBits::eGeometry; name + "_geometry"; break;
-        case ShaderType::Domain:
-            shaderStage_ = vk::ShaderStageFlagBits::eTessellationEvaluation; name + "_tessellationEvalution"; break;
-        case ShaderType::Hull:
-            shaderStage_ = vk::ShaderStageFlagBits::eTessellationControl; name + "_tessellationControl"; break;
-        case ShaderType::Amplification:
-            shaderStage_ = vk::ShaderStageFlagBits::eTaskEXT; name + "_task"; break;
-        case ShaderType::Mesh:
-            shaderStage_ = vk::ShaderStageFlagBits::eMeshEXT; name + "_mesh"; break;
-        case ShaderType::Compute:
-            shaderStage_ = vk::ShaderStageFlagBits::eCompute; name + "_compute"; break;
-        case ShaderType::RayGen:
-            shaderStage_ = vk::ShaderStageFlagBits::eRaygenKHR; name + "_raygen"; break;
-        case ShaderType::Miss:
-            shaderStage_ = vk::ShaderStageFlagBits::eMissKHR; name + "_miss"; break;
-        case ShaderType::ClosestHit:
-            shaderStage_ = vk::ShaderStageFlagBits::eClosestHitKHR; name + "_closesthit"; break;
-        case ShaderType::AnyHit:
-            shaderStage_ = vk::ShaderStageFlagBits::eAnyHitKHR; name + "_anyhit"; break;
-        case ShaderType::Intersection:
-            shaderStage_ = vk::ShaderStageFlagBits::eIntersectionKHR; name + "_intersect"; break;
-        case ShaderType::Callable:
-            shaderStage_ = vk::ShaderStageFlagBits::eCallableKHR; name + "_callable"; break;
+        case sqrp::ShaderType::Vertex:
+            return vk::ShaderStageFlagBits::eVertex;
+        case sqrp::ShaderType::Pixel:
+            return vk::ShaderStageFlagBits::eFragment;
+        case sqrp::ShaderType::Geometry:
+            return vk::ShaderStageFlagBits::eGeometry;
+        case sqrp::ShaderType::Domain:
+            return vk::ShaderStageFlagBits::eTessellationEvaluation;
+        case sqrp::ShaderType::Hull:
+            return vk::ShaderStageFlagBits::eTessellationControl;
+        case sqrp::ShaderType::Amplification:
+            return vk::ShaderStageFlagBits::eTaskEXT;
+        case sqrp::ShaderType::Mesh:
+            return vk::ShaderStageFlagBits::eMeshEXT;
+        case sqrp::ShaderType::Compute:
+            return vk::ShaderStageFlagBits::eCompute;
+        case sqrp::ShaderType::RayGen:
+            return vk::ShaderStageFlagBits::eRaygenKHR;
+        case sqrp::ShaderType::Miss:
+            return vk::ShaderStageFlagBits::eMissKHR;
+        case sqrp::ShaderType::ClosestHit:
+            return vk::ShaderStageFlagBits::eClosestHitKHR;
+        case sqrp::ShaderType::AnyHit:
+            return vk::ShaderStageFlagBits::eAnyHitKHR;
+        case sqrp::ShaderType::Intersection:
+            return vk::ShaderStageFlagBits::eIntersectionKHR;
+        case sqrp::ShaderType::Callable:
+            return vk::ShaderStageFlagBits::eCallableKHR;
         default:
             throw std::runtime_error("Unsupported shader type");
         }
+    }
+}
+
+namespace sqrp
+{
+	Shader::Shader(const Device& device, const Compiler& compiler, const std::string& fileName, ShaderType shaderType)
+		: pDevice_(&device), pCompiler_(&compiler)
+	{
+        shaderStage_ = ToShaderStage(shaderType);
 
         std::ifstream file(fileName, std::ios::ate | std::ios::binary);
         if (!file.is_open()) {
@@ -55,12 +62,27 @@ namespace sqrp
         file.read(reinterpret_cast<char*>(buffer.data()), fileSize);
         file.close();*/
 
+        CreateShaderModule(buffer);
+	}
+
+    Shader::Shader(const Device& device, const std::vector<uint32_t>& spirv, ShaderType shaderType)
+        : pDevice_(&device)
+    {
+        shaderStage_ = ToShaderStage(shaderType);
+
+        CreateShaderModule(spirv);
+    }
+
+    void Shader::CreateShaderModule(const std::vector<uint32_t>& spirv)
+    {
+        hash_ = HashBytes(spirv.data(), spirv.size() * sizeof(uint32_t), HashValue(static_cast<VkShaderStageFlags>(shaderStage_)));
+
         shaderModule_ = pDevice_->GetDevice().createShaderModuleUnique(
             vk::ShaderModuleCreateInfo()
-            .setCodeSize(buffer.size() * sizeof(uint32_t))
-            .setPCode(buffer.data())
+            .setCodeSize(spirv.size() * sizeof(uint32_t))
+            .setPCode(spirv.data())
 		);
-	}
+    }
 
     vk::ShaderModule Shader::GetShaderModule() const
     { 
@@ -71,4 +93,9 @@ namespace sqrp
     {
         return shaderStage_; 
     }
+
+    uint64_t Shader::GetHash() const
+    {
+        return hash_;
+    }
 }
\ No newline at end of file
@@ -0,0 +1,155 @@
+#include "SubmitBatch.hpp"
+
+#include "Barrier.hpp"
+#include "CommandBuffer.hpp"
+#include "Fence.hpp"
+#include "Profiler.hpp"
+#include "UploadManager.hpp"
+
+using namespace std;
+
+namespace sqrp
+{
+	namespace
+	{
+		vk::SemaphoreSubmitInfo ToSemaphoreSubmitInfo(const SubmitSemaphore& submitSemaphore)
+		{
+			return vk::SemaphoreSubmitInfo()
+				.setSemaphore(submitSemaphore.semaphore)
+				.setValue(submitSemaphore.value)
+				.setStageMask(ToPipelineStageFlags2(submitSemaphore.stageMask));
+		}
+	}
+
+	SubmitBatch::SubmitBatch(const Device& device, QueueContextType queueType)
+		: pDevice_(&device), queueType_(queueType)
+	{
+		if (pDevice_->GetQueueContexts().find(queueType_) == pDevice_->GetQueueContexts().end()) {
+			throw std::runtime_error("No such queue context type for SubmitBatch");
+		}
+	}
+
+	SubmitBatch& SubmitBatch::Add(
+		CommandBufferHandle pCommandBuffer,
+		const std::vector<SubmitSemaphore>& waitSemaphores,
+		const std::vector<SubmitSemaphore>& signalSemaphores
+	)
+	{
+		// Waits must happen before the command buffers of an entry and signals after all of them
+		// so the previous entry can only be extended if it has no signals and this has no waits,
+		// or if it only has waits from Wait, which must gate this command buffer as well
+		bool canMerge = !entries_.empty() && entries_.back().signalCount == 0 &&
+			(waitSemaphores.empty() || entries_.back().commandBufferCount == 0);
+		if (!canMerge) {
+			Entry entry{};
+			entry.waitOffset = static_cast<uint32_t>(waitInfos_.size());
+			entry.commandBufferOffset = static_cast<uint32_t>(commandBufferInfos_.size());
+			entries_.push_back(entry);
+		}
+		Entry& entry = entries_.back();
+
+		for (const auto& waitSemaphore : waitSemaphores) {
+			waitInfos_.push_back(ToSemaphoreSubmitInfo(waitSemaphore));
+		}
+		entry.waitCount += static_cast<uint32_t>(waitSemaphores.size());
+
+		commandBufferInfos_.push_back(vk::CommandBufferSubmitInfo().setCommandBuffer(pCommandBuffer->GetCommandBuffer()));
+		entry.commandBufferCount++;
+
+		entry.signalOffset = static_cast<uint32_t>(signalInfos_.size());
+		for (const auto& signalSemaphore : signalSemaphores) {
+			signalInfos_.push_back(ToSemaphoreSubmitInfo(signalSemaphore));
+		}
+		entry.signalCount = static_cast<uint32_t>(signalSemaphores.size());
+
+		return *this;
+	}
+
+	SubmitBatch& SubmitBatch::Wait(const SubmitSemaphore& waitSemaphore)
+	{
+		// Can't be merged into an entry which already has command buffers or signals
+		if (entries_.empty() || entries_.back().commandBufferCount != 0 || entries_.back().signalCount != 0) {
+			Entry entry{};
+			entry.waitOffset = static_cast<uint32_t>(waitInfos_.size());
+			entry.commandBufferOffset = static_cast<uint32_t>(commandBufferInfos_.size());
+			entry.signalOffset = static_cast<uint32_t>(signalInfos_.size());
+			entries_.push_back(entry);
+		}
+		waitInfos_.push_back(ToSemaphoreSubmitInfo(waitSemaphore));
+		entries_.back().waitCount++;
+		return *this;
+	}
+
+	SubmitBatch& SubmitBatch::Signal(const SubmitSemaphore& signalSemaphore)
+	{
+		if (entries_.empty()) {
+			Entry entry{};
+			entry.waitOffset = static_cast<uint32_t>(waitInfos_.size());
+			entry.commandBufferOffset = static_cast<uint32_t>(commandBufferInfos_.size());
+			entries_.push_back(entry);
+		}
+		Entry& entry = entries_.back();
+		if (entry.signalCount == 0) {
+			entry.signalOffset = static_cast<uint32_t>(signalInfos_.size());
+		}
+		// Signals of an entry are contiguous since Add always closes the previous signals
+		signalInfos_.push_back(ToSemaphoreSubmitInfo(signalSemaphore));
+		entry.signalCount++;
+		return *this;
+	}
+
+	void SubmitBatch::Flush(FenceHandle pFence)
+	{
+		if (entries_.empty()) {
+			return;
+		}
+		CpuProfileScope profileScope(pDevice_->GetProfiler().get(), "Submit");
+		// Pending uploads are submitted and acquired first so that the command buffers can use them
+		if (pDevice_->GetUploadManager().GetDstQueueType() == queueType_) {
+			pDevice_->GetUploadManager().Flush();
+		}
+
+		submitInfos_.clear();
+		submitInfos_.reserve(entries_.size());
+		for (const auto& entry : entries_) {
+			submitInfos_.push_back(
+				vk::SubmitInfo2()
+				.setWaitSemaphoreInfoCount(entry.waitCount)
+				.setPWaitSemaphoreInfos(waitInfos_.data() + entry.waitOffset)
+				.setCommandBufferInfoCount(entry.commandBufferCount)
+				.setPCommandBufferInfos(commandBufferInfos_.data() + entry.commandBufferOffset)
+				.setSignalSemaphoreInfoCount(entry.signalCount)
+				.setPSignalSemaphoreInfos(signalInfos_.data() + entry.signalOffset)
+			);
+		}
+		{
+			auto queueLock = pDevice_->LockQueue(queueType_);
+			pDevice_->GetQueue(queueType_).submit2(submitInfos_, pFence ? pFence->GetFence() : nullptr);
+		}
+
+		entries_.clear();
+		waitInfos_.clear();
+		commandBufferInfos_.clear();
+		signalInfos_.clear();
+	}
+
+	bool SubmitBatch::IsEmpty() const
+	{
+		return entries_.empty();
+	}
+
+	uint32_t SubmitBatch::GetCommandBufferCount() const
+	{
+		return static_cast<uint32_t>(commandBufferInfos_.size());
+	}
+
+	uint32_t SubmitBatch::GetEntryCount() const
+	{
+		return static_cast<uint32_t>(entries_.size());
+	}
+
+	QueueContextType SubmitBatch::GetQueueType() const
+	{
+		return queueType_;
+	}
+}
\ No newline at end of file
@@ -2,8 +2,10 @@
 
 #include "CommandBuffer.hpp"
 #include "Device.hpp"
-#include "Fence.hpp"
+#include "FrameCommandAllocator.hpp"
+#include "Profiler.hpp"
 #include "Semaphore.hpp"
+#include "TimelineSemaphore.hpp"
 
 using namespace std;
 
@@ -25,6 +27,12 @@ namespace sqrp
 			}
 		}
 
+		// RenderTarget | Copy Destination, Copy Source for FrameCapture if the surface supports it
+		imageUsage_ = vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eTransferDst;
+		if (capabilities_.supportedUsageFlags & vk::ImageUsageFlagBits::eTransferSrc) {
+			imageUsage_ |= vk::ImageUsageFlagBits::eTransferSrc;
+		}
+
 		auto presentModes = pDevice_->GetPhysicalDevice().getSurfacePresentModesKHR(pDevice_->GetSurface());
 		presentMode_ = presentModes[0];
 		for (const auto& presentMode : presentModes) {
@@ -48,7 +56,7 @@ namespace sqrp
 			.setImageColorSpace(surfaceFormat_.colorSpace)
 			.setImageExtent({ width_, height_ })
 			.setImageArrayLayers(1)
-			.setImageUsage(vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eTransferDst) // RenderTarget | Copy Destination
+			.setImageUsage(imageUsage_)
 			.setPreTransform(vk::SurfaceTransformFlagBitsKHR::eIdentity) // NOTE : This specify no rotation if you support rotation for mobile, fix it
 			.setPresentMode(presentMode_)
 			.setClipped(true)
@@ -59,19 +67,14 @@ namespace sqrp
 
 		for (const auto& [flag, context] : pDevice_->GetQueueContexts()) {
 			if (flag == QueueContextType::General || flag == QueueContextType::Graphics) {
+				// Allocated from the pool of the frame in WaitFrame
+				graphicsCommandAllocator_ = pDevice_->CreateFrameCommandAllocator("graphics", inflightCount_, flag);
 				graphicsCommandBuffers_.resize(inflightCount_);
-				graphicsFences_.resize(inflightCount_);
-				for (int i = 0; i < inflightCount_; i++) {
-					graphicsCommandBuffers_[i] = pDevice_->CreateCommandBuffer("graphics", flag);
-					graphicsFences_[i] = pDevice_->CreateFence("graphics");
-				}
 			}
 			else if (flag == QueueContextType::Compute) {
 				computeCommandBuffers_.resize(inflightCount_);
-				computeFences_.resize(inflightCount_);
 				for (int i = 0; i < inflightCount_; i++) {
 					computeCommandBuffers_[i] = pDevice_->CreateCommandBuffer("compute", flag);
-					computeFences_[i] = pDevice_->CreateFence("compute");
 				}
 			}
 		}
@@ -82,6 +85,9 @@ namespace sqrp
 			imageAcquireSemaphores_[i] = pDevice_->CreateSemaphore("ImageAcquireSemaphore" + to_string(i));
 			renderCompleteSemaphores_[i] = pDevice_->CreateSemaphore("RenderCompleteSemaphore" + to_string(i));
 		}
+
+		frameTimeline_ = pDevice_->CreateTimelineSemaphore("FrameTimeline");
+		inflightFrameValues_.assign(inflightCount_, 0);
 	}
 
 	void Swapchain::Recreate(uint32_t width, uint32_t height)
@@ -93,9 +99,10 @@ namespace sqrp
 
 		swapchainImages_.clear();
 		graphicsCommandBuffers_.clear();
-		graphicsFences_.clear();
+		graphicsCommandAllocator_.reset();
 		computeCommandBuffers_.clear();
-		computeFences_.clear();
+		// NOTE : The caller waits for the queue to be idle, so no frame value is pending
+		inflightFrameValues_.assign(inflightCount_, 0);
 		imageAcquireSemaphores_.clear();
 		renderCompleteSemaphores_.clear();
 
@@ -114,6 +121,12 @@ namespace sqrp
 			}
 		}
 
+		// RenderTarget | Copy Destination, Copy Source for FrameCapture if the surface supports it
+		imageUsage_ = vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eTransferDst;
+		if (capabilities_.supportedUsageFlags & vk::ImageUsageFlagBits::eTransferSrc) {
+			imageUsage_ |= vk::ImageUsageFlagBits::eTransferSrc;
+		}
+
 		auto presentModes = pDevice_->GetPhysicalDevice().getSurfacePresentModesKHR(pDevice_->GetSurface());
 		presentMode_ = presentModes[0];
 		for (const auto& presentMode : presentModes) {
@@ -137,7 +150,7 @@ namespace sqrp
 			.setImageColorSpace(surfaceFormat_.colorSpace)
 			.setImageExtent({ width_, height_ })
 			.setImageArrayLayers(1)
-			.setImageUsage(vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eTransferDst) // RenderTarget | Copy Destination
+			.setImageUsage(imageUsage_)
 			.setPreTransform(vk::SurfaceTransformFlagBitsKHR::eIdentity) // NOTE : This specify no rotation if you support rotation for mobile, fix it
 			.setPresentMode(presentMode_)
 			.setClipped(true)
@@ -148,19 +161,14 @@ namespace sqrp
 
 		for (const auto& [flag, context] : pDevice_->GetQueueContexts()) {
 			if (flag == QueueContextType::General || flag == QueueContextType::Graphics) {
+				// Allocated from the pool of the frame in WaitFrame
+				graphicsCommandAllocator_ = pDevice_->CreateFrameCommandAllocator("graphics", inflightCount_, flag);
 				graphicsCommandBuffers_.resize(inflightCount_);
-				graphicsFences_.resize(inflightCount_);
-				for (int i = 0; i < inflightCount_; i++) {
-					graphicsCommandBuffers_[i] = pDevice_->CreateCommandBuffer("graphics", flag);
-					graphicsFences_[i] = pDevice_->CreateFence("graphics");
-				}
 			}
 			else if (flag == QueueContextType::Compute) {
 				computeCommandBuffers_.resize(inflightCount_);
-				computeFences_.resize(inflightCount_);
 				for (int i = 0; i < inflightCount_; i++) {
 					computeCommandBuffers_[i] = pDevice_->CreateCommandBuffer("compute", flag);
-					computeFences_[i] = pDevice_->CreateFence("compute");
 				}
 			}
 		}
@@ -180,23 +188,38 @@ namespace sqrp
 
 	void Swapchain::WaitFrame()
 	{
-		graphicsFences_[inflightIndex_]->Wait();
+		CpuProfileScope profileScope(pDevice_->GetProfiler().get(), "WaitFrame");
+		// Wait for the frame which used this inflight index, no reset is required unlike fences
+		frameTimeline_->Wait(inflightFrameValues_[inflightIndex_]);
+
+		// Command buffers of the frame are reset at once with the pool
+		graphicsCommandAllocator_->BeginFrame(inflightIndex_);
+		graphicsCommandBuffers_[inflightIndex_] = graphicsCommandAllocator_->Allocate();
 
+		CpuProfileScope acquireScope(pDevice_->GetProfiler().get(), "Acquire");
 		auto result = pDevice_->GetDevice().acquireNextImageKHR(swapchain_.get(), std::numeric_limits<uint64_t>::max(), imageAcquireSemaphores_[inflightIndex_]->GetSemaphore(), nullptr);
 
 		imageIndex_ = result.value;
 
-		graphicsFences_[inflightIndex_]->Reset();
+		inflightFrameValues_[inflightIndex_] = frameTimeline_->NextValue();
+		// VMA refreshes the heap budgets when the frame index changes
+		vmaSetCurrentFrameIndex(pDevice_->GetAllocator(), static_cast<uint32_t>(inflightFrameValues_[inflightIndex_]));
 	}
 
 	void Swapchain::Present()
 	{
+		CpuProfileScope profileScope(pDevice_->GetProfiler().get(), "Present");
 		vk::PresentInfoKHR presentInfo;
 		presentInfo.setSwapchains(swapchain_.get());
 		presentInfo.setImageIndices(imageIndex_);
 		vk::Semaphore semaphore = renderCompleteSemaphores_[inflightIndex_]->GetSemaphore();
 		presentInfo.setWaitSemaphores(semaphore);
-		if (pDevice_->GetQueue(QueueContextType::General).presentKHR(presentInfo) != vk::Result::eSuccess) {
+		vk::Result result;
+		{
+			auto queueLock = pDevice_->LockQueue(QueueContextType::General);
+			result = pDevice_->GetQueue(QueueContextType::General).presentKHR(presentInfo);
+		}
+		if (result != vk::Result::eSuccess) {
 			return;
 		}
 		inflightIndex_++;
@@ -263,9 +286,24 @@ namespace sqrp
 		return renderCompleteSemaphores_[inflightIndex_];
 	}
 
-	FenceHandle Swapchain::GetCurrentFence() const
+	FrameCommandAllocatorHandle Swapchain::GetGraphicsCommandAllocator() const
+	{
+		return graphicsCommandAllocator_;
+	}
+
+	vk::ImageUsageFlags Swapchain::GetImageUsage() const
+	{
+		return imageUsage_;
+	}
+
+	TimelineSemaphoreHandle Swapchain::GetFrameTimeline() const
+	{
+		return frameTimeline_;
+	}
+
+	uint64_t Swapchain::GetCurrentFrameValue() const
 	{
-		return graphicsFences_[inflightIndex_];
+		return inflightFrameValues_[inflightIndex_];
 	}
 
 }
\ No newline at end of file
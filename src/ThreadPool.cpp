@@ -0,0 +1,56 @@
+#include "ThreadPool.hpp"
+
+#include "TraceRecorder.hpp"
+
+using namespace std;
+
+namespace sqrp
+{
+	ThreadPool::ThreadPool(uint32_t threadCount)
+	{
+		if (threadCount == 0) {
+			threadCount = std::max(1u, std::thread::hardware_concurrency());
+		}
+		workers_.reserve(threadCount);
+		for (uint32_t i = 0; i < threadCount; i++) {
+			workers_.emplace_back([this]() { WorkerLoop(); });
+		}
+	}
+
+	ThreadPool::~ThreadPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			isStopping_ = true;
+		}
+		condition_.notify_all();
+		// Remaining tasks are drained before workers exit
+		for (auto& worker : workers_) {
+			worker.join();
+		}
+	}
+
+	void ThreadPool::WorkerLoop()
+	{
+		TraceRecorder::SetThreadName("Worker");
+		while (true) {
+			std::function<void()> task;
+			{
+				std::unique_lock<std::mutex> lock(mutex_);
+				condition_.wait(lock, [this]() { return isStopping_ || !tasks_.empty(); });
+				if (isStopping_ && tasks_.empty()) {
+					return;
+				}
+				task = std::move(tasks_.front());
+				tasks_.pop();
+			}
+			// Exceptions are captured by packaged_task and rethrown from future::get
+			task();
+		}
+	}
+
+	uint32_t ThreadPool::GetThreadCount() const
+	{
+		return static_cast<uint32_t>(workers_.size());
+	}
+}
\ No newline at end of file
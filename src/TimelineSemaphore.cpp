@@ -0,0 +1,72 @@
+#include "TimelineSemaphore.hpp"
+
+#include "Device.hpp"
+
+using namespace std;
+
+namespace sqrp
+{
+	TimelineSemaphore::TimelineSemaphore(const Device& device, std::string name, uint64_t initialValue)
+		: pDevice_(&device), name_(name), lastValue_(initialValue)
+	{
+		vk::StructureChain<vk::SemaphoreCreateInfo, vk::SemaphoreTypeCreateInfo> createInfoChain{
+			vk::SemaphoreCreateInfo(),
+			vk::SemaphoreTypeCreateInfo()
+			.setSemaphoreType(vk::SemaphoreType::eTimeline)
+			.setInitialValue(initialValue)
+		};
+		semaphore_ = pDevice_->GetDevice().createSemaphoreUnique(createInfoChain.get<vk::SemaphoreCreateInfo>());
+		pDevice_->SetObjectName((uint64_t)(VkSemaphore)semaphore_.get(), vk::ObjectType::eSemaphore, name_);
+	}
+
+	uint64_t TimelineSemaphore::NextValue()
+	{
+		return ++lastValue_;
+	}
+
+	uint64_t TimelineSemaphore::GetLastValue() const
+	{
+		return lastValue_;
+	}
+
+	uint64_t TimelineSemaphore::GetCompletedValue() const
+	{
+		return pDevice_->GetDevice().getSemaphoreCounterValue(semaphore_.get());
+	}
+
+	bool TimelineSemaphore::IsCompleted(uint64_t value) const
+	{
+		return GetCompletedValue() >= value;
+	}
+
+	bool TimelineSemaphore::Wait(uint64_t value, uint64_t timeout) const
+	{
+		vk::Semaphore semaphore = semaphore_.get();
+		auto result = pDevice_->GetDevice().waitSemaphores(
+			vk::SemaphoreWaitInfo()
+			.setSemaphores(semaphore)
+			.setValues(value),
+			timeout
+		);
+		if (result != vk::Result::eSuccess && result != vk::Result::eTimeout) {
+			throw std::runtime_error("Failed to wait for timeline semaphore");
+		}
+		return result == vk::Result::eSuccess;
+	}
+
+	void TimelineSemaphore::Signal(uint64_t value)
+	{
+		pDevice_->GetDevice().signalSemaphore(
+			vk::SemaphoreSignalInfo()
+			.setSemaphore(semaphore_.get())
+			.setValue(value)
+		);
+		uint64_t lastValue = lastValue_;
+		while (lastValue < value && !lastValue_.compare_exchange_weak(lastValue, value)) {}
+	}
+
+	vk::Semaphore TimelineSemaphore::GetSemaphore() const
+	{
+		return semaphore_.get();
+	}
+}
\ No newline at end of file
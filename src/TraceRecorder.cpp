@@ -0,0 +1,229 @@
+#include "TraceRecorder.hpp"
+
+using namespace std;
+
+namespace
+{
+	void WriteJsonString(std::ostream& stream, const char* str)
+	{
+		stream << '"';
+		for (const char* c = str; *c != '\0'; c++) {
+			switch (*c) {
+			case '"':
+				stream << "\\\"";
+				break;
+			case '\\':
+				stream << "\\\\";
+				break;
+			default:
+				if (static_cast<unsigned char>(*c) < 0x20) {
+					stream << ' ';
+				}
+				else {
+					stream << *c;
+				}
+			}
+		}
+		stream << '"';
+	}
+}
+
+namespace sqrp
+{
+	std::atomic<bool> TraceRecorder::isEnabled_ = false;
+	std::atomic<uint64_t> TraceRecorder::sessionId_ = 0;
+	std::mutex TraceRecorder::registryMutex_;
+	std::vector<std::unique_ptr<TraceRecorder::ThreadBuffer>> TraceRecorder::threadBuffers_;
+	std::map<uint32_t, std::string> TraceRecorder::gpuTrackNames_;
+
+	TraceRecorder::ThreadBuffer::~ThreadBuffer()
+	{
+		FreeChunks(pHead.load());
+	}
+
+	void TraceRecorder::FreeChunks(Chunk* pChunk)
+	{
+		while (pChunk) {
+			Chunk* pNext = pChunk->pNext.load();
+			delete pChunk;
+			pChunk = pNext;
+		}
+	}
+
+	TraceRecorder::ThreadBuffer& TraceRecorder::GetThreadBuffer()
+	{
+		thread_local ThreadBuffer* pThreadBuffer = nullptr;
+		if (!pThreadBuffer) {
+			std::lock_guard<std::mutex> lock(registryMutex_);
+			auto pBuffer = std::make_unique<ThreadBuffer>();
+			pBuffer->threadId = static_cast<uint32_t>(threadBuffers_.size());
+			pBuffer->sessionId.store(sessionId_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+			pThreadBuffer = pBuffer.get();
+			threadBuffers_.push_back(std::move(pBuffer));
+		}
+		return *pThreadBuffer;
+	}
+
+	void TraceRecorder::Append(const Event& event)
+	{
+		ThreadBuffer& buffer = GetThreadBuffer();
+		uint64_t sessionId = sessionId_.load(std::memory_order_relaxed);
+		if (buffer.sessionId.load(std::memory_order_relaxed) != sessionId) {
+			// Only the owner appends, and WriteChromeTrace reads under the lock, so the old chunks can be freed here
+			std::lock_guard<std::mutex> lock(registryMutex_);
+			FreeChunks(buffer.pHead.exchange(nullptr));
+			buffer.pTail = nullptr;
+			buffer.sessionId.store(sessionId, std::memory_order_relaxed);
+		}
+		if (!buffer.pTail) {
+			buffer.pTail = new Chunk();
+			buffer.pHead.store(buffer.pTail, std::memory_order_release);
+		}
+		uint32_t count = buffer.pTail->count.load(std::memory_order_relaxed);
+		if (count == Chunk::Capacity) {
+			Chunk* pChunk = new Chunk();
+			buffer.pTail->pNext.store(pChunk, std::memory_order_release);
+			buffer.pTail = pChunk;
+			count = 0;
+		}
+		buffer.pTail->events[count] = event;
+		buffer.pTail->count.store(count + 1, std::memory_order_release);
+	}
+
+	void TraceRecorder::SetEnabled(bool isEnabled)
+	{
+		isEnabled_.store(isEnabled, std::memory_order_relaxed);
+	}
+
+	bool TraceRecorder::IsEnabled()
+	{
+		return isEnabled_.load(std::memory_order_relaxed);
+	}
+
+	double TraceRecorder::NowUs()
+	{
+		static const auto epoch = std::chrono::steady_clock::now();
+		return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - epoch).count();
+	}
+
+	void TraceRecorder::SetThreadName(const std::string& name)
+	{
+		ThreadBuffer& buffer = GetThreadBuffer();
+		std::lock_guard<std::mutex> lock(registryMutex_);
+		buffer.threadName = name;
+	}
+
+	void TraceRecorder::SetGpuTrackName(uint32_t trackId, const std::string& name)
+	{
+		std::lock_guard<std::mutex> lock(registryMutex_);
+		gpuTrackNames_[trackId] = name;
+	}
+
+	void TraceRecorder::AddCpuEvent(std::string_view name, const char* category, double beginUs, double durationUs)
+	{
+		if (!IsEnabled()) {
+			return;
+		}
+		Event event;
+		name.copy(event.name, sizeof(event.name) - 1);
+		event.category = category;
+		event.processId = 0;
+		event.trackId = GetThreadBuffer().threadId;
+		event.beginUs = beginUs;
+		event.durationUs = durationUs;
+		Append(event);
+	}
+
+	void TraceRecorder::AddGpuEvent(std::string_view name, uint32_t trackId, double beginUs, double durationUs)
+	{
+		if (!IsEnabled()) {
+			return;
+		}
+		Event event;
+		name.copy(event.name, sizeof(event.name) - 1);
+		event.category = "gpu";
+		event.processId = 1;
+		event.trackId = trackId;
+		event.beginUs = beginUs;
+		event.durationUs = durationUs;
+		Append(event);
+	}
+
+	void TraceRecorder::Clear()
+	{
+		std::lock_guard<std::mutex> lock(registryMutex_);
+		sessionId_.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	bool TraceRecorder::WriteChromeTrace(const std::string& path)
+	{
+		// Copied under the lock and written without it, so that new threads don't wait for the file
+		std::map<uint32_t, std::string> gpuTrackNames;
+		std::vector<std::pair<uint32_t, std::string>> threadNames;
+		std::vector<Event> events;
+		{
+			std::lock_guard<std::mutex> lock(registryMutex_);
+			gpuTrackNames = gpuTrackNames_;
+			uint64_t sessionId = sessionId_.load(std::memory_order_relaxed);
+			for (const auto& pBuffer : threadBuffers_) {
+				if (!pBuffer->threadName.empty()) {
+					threadNames.push_back({ pBuffer->threadId, pBuffer->threadName });
+				}
+				// Not cleared yet by the owner thread
+				if (pBuffer->sessionId.load(std::memory_order_relaxed) != sessionId) {
+					continue;
+				}
+				for (const Chunk* pChunk = pBuffer->pHead.load(std::memory_order_acquire); pChunk; pChunk = pChunk->pNext.load(std::memory_order_acquire)) {
+					uint32_t count = pChunk->count.load(std::memory_order_acquire);
+					events.insert(events.end(), pChunk->events.begin(), pChunk->events.begin() + count);
+				}
+			}
+		}
+
+		std::ofstream file(path, std::ios::out | std::ios::trunc);
+		if (!file.is_open()) {
+			cerr << "Warning: Failed to write trace " << path << endl;
+			return false;
+		}
+		file << std::fixed << std::setprecision(3);
+		file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+		file << "{\"ph\":\"M\",\"name\":\"process_name\",\"pid\":0,\"args\":{\"name\":\"CPU\"}},\n";
+		file << "{\"ph\":\"M\",\"name\":\"process_name\",\"pid\":1,\"args\":{\"name\":\"GPU\"}}";
+
+		for (const auto& [trackId, name] : gpuTrackNames) {
+			file << ",\n{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":" << trackId << ",\"args\":{\"name\":";
+			WriteJsonString(file, name.c_str());
+			file << "}}";
+		}
+		for (const auto& [threadId, name] : threadNames) {
+			file << ",\n{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":0,\"tid\":" << threadId << ",\"args\":{\"name\":";
+			WriteJsonString(file, name.c_str());
+			file << "}}";
+		}
+		for (const Event& event : events) {
+			file << ",\n{\"ph\":\"X\",\"name\":";
+			WriteJsonString(file, event.name);
+			file << ",\"cat\":\"" << event.category << "\",\"pid\":" << event.processId << ",\"tid\":" << event.trackId
+				<< ",\"ts\":" << event.beginUs << ",\"dur\":" << event.durationUs << "}";
+		}
+		file << "\n]}\n";
+
+		cout << "Wrote trace " << path << endl;
+		return true;
+	}
+
+	TraceScope::TraceScope(const char* name, const char* category)
+		: name_(name), category_(category)
+	{
+		if (TraceRecorder::IsEnabled()) {
+			beginUs_ = TraceRecorder::NowUs();
+		}
+	}
+
+	TraceScope::~TraceScope()
+	{
+		if (beginUs_ >= 0.0) {
+			TraceRecorder::AddCpuEvent(name_, category_, beginUs_, TraceRecorder::NowUs() - beginUs_);
+		}
+	}
+}
\ No newline at end of file
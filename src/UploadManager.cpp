@@ -0,0 +1,444 @@
+#include "UploadManager.hpp"
+
+#include "Barrier.hpp"
+#include "Buffer.hpp"
+#include "CommandBuffer.hpp"
+#include "Image.hpp"
+#include "TimelineSemaphore.hpp"
+
+using namespace std;
+
+namespace sqrp
+{
+	namespace
+	{
+		// Satisfies optimalBufferCopyOffsetAlignment and texel size of common formats
+		constexpr vk::DeviceSize StagingAlignment = 16;
+
+		vk::DeviceSize AlignUp(vk::DeviceSize value, vk::DeviceSize alignment)
+		{
+			return (value + alignment - 1) / alignment * alignment;
+		}
+	}
+
+	UploadManager::UploadManager(const Device& device, vk::DeviceSize stagingSize, QueueContextType queueType, QueueContextType dstQueueType)
+		: pDevice_(&device), queueType_(queueType), dstQueueType_(dstQueueType), stagingSize_(AlignUp(stagingSize, StagingAlignment))
+	{
+		const auto& queueContexts = pDevice_->GetQueueContexts();
+		auto queueContextItr = queueContexts.find(queueType_);
+		auto dstQueueContextItr = queueContexts.find(dstQueueType_);
+		if (queueContextItr == queueContexts.end() || dstQueueContextItr == queueContexts.end()) {
+			throw std::runtime_error("No such queue context type for UploadManager");
+		}
+		queueFamilyIndex_ = queueContextItr->second.queueFamilyIndex;
+		dstQueueFamilyIndex_ = dstQueueContextItr->second.queueFamilyIndex;
+
+		pStagingBuffer_ = pDevice_->CreateBuffer(
+			"UploadManager_staging",
+			static_cast<int>(stagingSize_),
+			vk::BufferUsageFlagBits::eTransferSrc,
+			VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT,
+			VMA_MEMORY_USAGE_AUTO_PREFER_HOST
+		);
+		pStagingData_ = static_cast<uint8_t*>(pStagingBuffer_->GetMappedData());
+
+		timeline_ = pDevice_->CreateTimelineSemaphore("UploadManager");
+		if (IsOwnershipTransferRequired()) {
+			copyTimeline_ = pDevice_->CreateTimelineSemaphore("UploadManager_copy");
+		}
+	}
+
+	UploadManager::~UploadManager()
+	{
+		WaitAll();
+	}
+
+	bool UploadManager::IsOwnershipTransferRequired() const
+	{
+		return queueFamilyIndex_ != dstQueueFamilyIndex_;
+	}
+
+	UploadManager::Batch& UploadManager::GetRecordingBatch()
+	{
+		if (!recordingBatch_) {
+			Batch batch;
+			if (!freeBatches_.empty()) {
+				batch = std::move(freeBatches_.back());
+				freeBatches_.pop_back();
+			}
+			else {
+				batch.pCommandBuffer = pDevice_->CreateCommandBuffer("UploadManager", queueType_);
+				if (IsOwnershipTransferRequired()) {
+					batch.pAcquireCommandBuffer = pDevice_->CreateCommandBuffer("UploadManager_acquire", dstQueueType_);
+				}
+			}
+			batch.ticket = nextTicket_++;
+			batch.isAcquired = false;
+			batch.stagingEnd = stagingHead_;
+			// NOTE : The command pool has eResetCommandBuffer, so Begin resets the recycled command buffer
+			batch.pCommandBuffer->Begin(vk::CommandBufferUsageFlagBits::eOneTimeSubmit);
+			recordingBatch_ = std::move(batch);
+		}
+		return *recordingBatch_;
+	}
+
+	vk::DeviceSize UploadManager::AllocateStaging(vk::DeviceSize size)
+	{
+		size = AlignUp(size, StagingAlignment);
+		while (true) {
+			// Restart from the beginning of the ring when it is empty
+			if (stagingHead_ == stagingTail_) {
+				stagingHead_ = stagingTail_ = AlignUp(stagingHead_, stagingSize_);
+			}
+			uint64_t head = stagingHead_;
+			vk::DeviceSize offset = head % stagingSize_;
+			// Skip the tail of the ring instead of splitting the allocation
+			if (offset + size > stagingSize_) {
+				head += stagingSize_ - offset;
+				offset = 0;
+			}
+			if (head + size - stagingTail_ <= stagingSize_) {
+				stagingHead_ = head + size;
+				return offset;
+			}
+
+			// Ring is full, free the space of completed batches first
+			if (RetireBatch(false)) {
+				continue;
+			}
+			if (recordingBatch_) {
+				SubmitRecordingBatch();
+			}
+			if (!RetireBatch(true)) {
+				throw std::runtime_error("Failed to allocate staging memory for upload");
+			}
+		}
+	}
+
+	void UploadManager::AddBufferBarrier(Batch& batch, BufferHandle pBuffer, vk::DeviceSize offset, vk::DeviceSize size)
+	{
+		// Buffers on the same queue are covered by a global memory barrier
+		if (!IsOwnershipTransferRequired()) {
+			return;
+		}
+		// Release barrier, the destination stages and accesses are defined by the acquire barrier
+		vk::BufferMemoryBarrier2 barrier{};
+		barrier.setSrcStageMask(vk::PipelineStageFlagBits2::eAllTransfer);
+		barrier.setSrcAccessMask(vk::AccessFlagBits2::eTransferWrite);
+		barrier.setSrcQueueFamilyIndex(queueFamilyIndex_);
+		barrier.setDstQueueFamilyIndex(dstQueueFamilyIndex_);
+		barrier.setBuffer(pBuffer->GetBuffer());
+		barrier.setOffset(offset);
+		barrier.setSize(size);
+		batch.bufferBarriers.push_back(barrier);
+	}
+
+	void UploadManager::AddImageBarrier(Batch& batch, ImageHandle pImage, vk::ImageLayout finalLayout)
+	{
+		vk::ImageMemoryBarrier2 barrier{};
+		barrier.setOldLayout(vk::ImageLayout::eTransferDstOptimal);
+		barrier.setNewLayout(finalLayout);
+		if (IsOwnershipTransferRequired()) {
+			barrier.setSrcQueueFamilyIndex(queueFamilyIndex_);
+			barrier.setDstQueueFamilyIndex(dstQueueFamilyIndex_);
+		}
+		else {
+			barrier.setSrcQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED);
+			barrier.setDstQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED);
+			barrier.setDstStageMask(vk::PipelineStageFlagBits2::eAllCommands);
+			barrier.setDstAccessMask(vk::AccessFlagBits2::eMemoryRead | vk::AccessFlagBits2::eMemoryWrite);
+		}
+		barrier.setImage(pImage->GetImage());
+		barrier.setSubresourceRange(
+			vk::ImageSubresourceRange()
+			.setAspectMask(pImage->GetAspectFlags())
+			.setBaseMipLevel(0)
+			.setLevelCount(pImage->GetMipLevels())
+			.setBaseArrayLayer(0)
+			.setLayerCount(pImage->GetArrayLayers())
+		);
+		barrier.setSrcStageMask(vk::PipelineStageFlagBits2::eAllTransfer);
+		barrier.setSrcAccessMask(vk::AccessFlagBits2::eTransferWrite);
+		batch.imageBarriers.push_back(barrier);
+		pImage->SetImageLayout(finalLayout);
+	}
+
+	void UploadManager::SubmitRecordingBatch()
+	{
+		Batch batch = std::move(*recordingBatch_);
+		recordingBatch_.reset();
+
+		auto commandBuffer = batch.pCommandBuffer->GetCommandBuffer();
+		BarrierBatcher barrierBatcher(batch.pCommandBuffer->GetQueueFlags());
+		for (const auto& barrier : batch.imageBarriers) {
+			barrierBatcher.AddImageBarrier(barrier);
+		}
+		// NOTE : Not through Device::Submit, which flushes this manager
+		if (IsOwnershipTransferRequired()) {
+			// Release barriers, the destination access is defined by the acquire barriers
+			for (const auto& barrier : batch.bufferBarriers) {
+				barrierBatcher.AddBufferBarrier(barrier);
+			}
+			batch.pCommandBuffer->FlushBarriers();
+			barrierBatcher.Flush(commandBuffer);
+			batch.pCommandBuffer->End();
+			vk::Semaphore signalSemaphore = copyTimeline_->GetSemaphore();
+			vk::StructureChain<vk::SubmitInfo, vk::TimelineSemaphoreSubmitInfo> submitInfoChain{
+				vk::SubmitInfo()
+				.setCommandBuffers(commandBuffer)
+				.setSignalSemaphores(signalSemaphore),
+				vk::TimelineSemaphoreSubmitInfo()
+				.setSignalSemaphoreValues(batch.ticket)
+			};
+			auto queueLock = pDevice_->LockQueue(queueType_);
+			pDevice_->GetQueue(queueType_).submit(submitInfoChain.get<vk::SubmitInfo>(), nullptr);
+		}
+		else {
+			// Make the copies visible to every later command on the queue
+			barrierBatcher.AddMemoryBarrier(
+				vk::PipelineStageFlagBits2::eAllTransfer, vk::AccessFlagBits2::eTransferWrite,
+				vk::PipelineStageFlagBits2::eAllCommands, vk::AccessFlagBits2::eMemoryRead | vk::AccessFlagBits2::eMemoryWrite
+			);
+			batch.pCommandBuffer->FlushBarriers();
+			barrierBatcher.Flush(commandBuffer);
+			batch.pCommandBuffer->End();
+			vk::Semaphore signalSemaphore = timeline_->GetSemaphore();
+			vk::StructureChain<vk::SubmitInfo, vk::TimelineSemaphoreSubmitInfo> submitInfoChain{
+				vk::SubmitInfo()
+				.setCommandBuffers(commandBuffer)
+				.setSignalSemaphores(signalSemaphore),
+				vk::TimelineSemaphoreSubmitInfo()
+				.setSignalSemaphoreValues(batch.ticket)
+			};
+			{
+				// NOTE : Reached from any uploading thread when the ring is full, the rendering queue is shared with Device::Submit
+				auto queueLock = pDevice_->LockQueue(queueType_);
+				pDevice_->GetQueue(queueType_).submit(submitInfoChain.get<vk::SubmitInfo>(), nullptr);
+			}
+			batch.imageBarriers.clear();
+			batch.isAcquired = true;
+		}
+		submittedBatches_.push_back(std::move(batch));
+	}
+
+	void UploadManager::SubmitAcquire(Batch& batch)
+	{
+		// Acquire barriers must match the release barriers except for the stage and access masks
+		// The source stages chain with the semaphore wait, the writes are made available by the release barriers
+		BarrierBatcher barrierBatcher(batch.pAcquireCommandBuffer->GetQueueFlags());
+		for (auto& barrier : batch.bufferBarriers) {
+			barrier.setSrcStageMask(vk::PipelineStageFlagBits2::eAllCommands);
+			barrier.setSrcAccessMask(vk::AccessFlagBits2::eNone);
+			barrier.setDstStageMask(vk::PipelineStageFlagBits2::eAllCommands);
+			barrier.setDstAccessMask(vk::AccessFlagBits2::eMemoryRead | vk::AccessFlagBits2::eMemoryWrite);
+			barrierBatcher.AddBufferBarrier(barrier);
+		}
+		for (auto& barrier : batch.imageBarriers) {
+			barrier.setSrcStageMask(vk::PipelineStageFlagBits2::eAllCommands);
+			barrier.setSrcAccessMask(vk::AccessFlagBits2::eNone);
+			barrier.setDstStageMask(vk::PipelineStageFlagBits2::eAllCommands);
+			barrier.setDstAccessMask(vk::AccessFlagBits2::eMemoryRead | vk::AccessFlagBits2::eMemoryWrite);
+			barrierBatcher.AddImageBarrier(barrier);
+		}
+
+		batch.pAcquireCommandBuffer->Begin(vk::CommandBufferUsageFlagBits::eOneTimeSubmit);
+		auto commandBuffer = batch.pAcquireCommandBuffer->GetCommandBuffer();
+		barrierBatcher.Flush(commandBuffer);
+		batch.pAcquireCommandBuffer->End();
+
+		// Only this small batch waits for the copies, later submits are ordered after its barriers
+		vk::Semaphore waitSemaphore = copyTimeline_->GetSemaphore();
+		vk::Semaphore signalSemaphore = timeline_->GetSemaphore();
+		vk::PipelineStageFlags waitDstStageMask = vk::PipelineStageFlagBits::eAllCommands;
+		vk::StructureChain<vk::SubmitInfo, vk::TimelineSemaphoreSubmitInfo> submitInfoChain{
+			vk::SubmitInfo()
+			.setWaitSemaphores(waitSemaphore)
+			.setWaitDstStageMask(waitDstStageMask)
+			.setCommandBuffers(commandBuffer)
+			.setSignalSemaphores(signalSemaphore),
+			vk::TimelineSemaphoreSubmitInfo()
+			.setWaitSemaphoreValues(batch.ticket)
+			.setSignalSemaphoreValues(batch.ticket)
+		};
+		{
+			// NOTE : Also reached from streaming threads through Wait, WaitAll and a full staging ring
+			auto queueLock = pDevice_->LockQueue(dstQueueType_);
+			pDevice_->GetQueue(dstQueueType_).submit(submitInfoChain.get<vk::SubmitInfo>(), nullptr);
+		}
+		batch.bufferBarriers.clear();
+		batch.imageBarriers.clear();
+		batch.isAcquired = true;
+	}
+
+	bool UploadManager::RetireBatch(bool wait)
+	{
+		if (submittedBatches_.empty()) {
+			return false;
+		}
+		Batch& batch = submittedBatches_.front();
+		if (!batch.isAcquired) {
+			if (!wait) {
+				return false;
+			}
+			SubmitAcquire(batch);
+		}
+		if (wait) {
+			timeline_->Wait(batch.ticket);
+		}
+		else if (!timeline_->IsCompleted(batch.ticket)) {
+			return false;
+		}
+
+		// NOTE : Batches without ring allocations may hold a position before the ring restart
+		stagingTail_ = std::max(stagingTail_, batch.stagingEnd);
+		completedTicket_ = batch.ticket;
+		batch.pBuffers.clear();
+		batch.pImages.clear();
+		freeBatches_.push_back(std::move(batch));
+		submittedBatches_.pop_front();
+		return true;
+	}
+
+	uint64_t UploadManager::UploadBuffer(BufferHandle pDstBuffer, const void* data, vk::DeviceSize size, vk::DeviceSize dstOffset)
+	{
+		if (dstOffset + size > pDstBuffer->GetSize()) {
+			throw std::runtime_error("Upload exceeds the destination buffer size");
+		}
+		// Ticket 0 is always complete
+		if (size == 0) {
+			return 0;
+		}
+
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (size > stagingSize_) {
+			// Too large for the ring, a dedicated staging buffer is kept alive by the batch
+			BufferHandle pStagingBuffer = pDevice_->CreateBuffer(
+				"UploadManager_dedicatedstaging",
+				static_cast<int>(size),
+				vk::BufferUsageFlagBits::eTransferSrc,
+				VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT,
+				VMA_MEMORY_USAGE_AUTO_PREFER_HOST
+			);
+			pStagingBuffer->Write(data, size);
+			Batch& batch = GetRecordingBatch();
+			batch.pCommandBuffer->CopyBufferRegion(pStagingBuffer, 0, pDstBuffer, dstOffset, size);
+			AddBufferBarrier(batch, pDstBuffer, dstOffset, size);
+			batch.pBuffers.push_back(pStagingBuffer);
+			batch.pBuffers.push_back(pDstBuffer);
+			return batch.ticket;
+		}
+
+		vk::DeviceSize stagingOffset = AllocateStaging(size);
+		pStagingBuffer_->Write(stagingOffset, data, size);
+		Batch& batch = GetRecordingBatch();
+		batch.pCommandBuffer->CopyBufferRegion(pStagingBuffer_, stagingOffset, pDstBuffer, dstOffset, size);
+		AddBufferBarrier(batch, pDstBuffer, dstOffset, size);
+		batch.pBuffers.push_back(pDstBuffer);
+		batch.stagingEnd = stagingHead_;
+		return batch.ticket;
+	}
+
+	uint64_t UploadManager::UploadImage(ImageHandle pDstImage, const void* data, vk::DeviceSize size, vk::ImageLayout finalLayout)
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		BufferHandle pStagingBuffer = pStagingBuffer_;
+		vk::DeviceSize stagingOffset = 0;
+		if (size > stagingSize_) {
+			pStagingBuffer = pDevice_->CreateBuffer(
+				"UploadManager_dedicatedstaging",
+				static_cast<int>(size),
+				vk::BufferUsageFlagBits::eTransferSrc,
+				VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT,
+				VMA_MEMORY_USAGE_AUTO_PREFER_HOST
+			);
+		}
+		else {
+			stagingOffset = AllocateStaging(size);
+		}
+		pStagingBuffer->Write(stagingOffset, data, size);
+
+		Batch& batch = GetRecordingBatch();
+		// NOTE : The upload queue doesn't own the previous contents, so they are discarded with eUndefined
+		vk::ImageLayout oldLayout = IsOwnershipTransferRequired() ? vk::ImageLayout::eUndefined : pDstImage->GetImageLayout();
+		batch.pCommandBuffer->ImageBarrier(
+			pDstImage,
+			oldLayout, vk::ImageLayout::eTransferDstOptimal,
+			vk::PipelineStageFlagBits::eAllCommands, vk::PipelineStageFlagBits::eTransfer,
+			{}, vk::AccessFlagBits::eTransferWrite
+		);
+		batch.pCommandBuffer->CopyBufferToImage(pStagingBuffer, pDstImage, stagingOffset);
+		AddImageBarrier(batch, pDstImage, finalLayout);
+
+		if (pStagingBuffer != pStagingBuffer_) {
+			batch.pBuffers.push_back(pStagingBuffer);
+		}
+		batch.pImages.push_back(pDstImage);
+		batch.stagingEnd = stagingHead_;
+		return batch.ticket;
+	}
+
+	uint64_t UploadManager::SubmitCopies()
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (recordingBatch_) {
+			SubmitRecordingBatch();
+		}
+		return nextTicket_ - 1;
+	}
+
+	uint64_t UploadManager::Flush()
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (recordingBatch_) {
+			SubmitRecordingBatch();
+		}
+		for (auto& batch : submittedBatches_) {
+			if (!batch.isAcquired) {
+				SubmitAcquire(batch);
+			}
+		}
+		// Release references of completed batches without waiting
+		while (RetireBatch(false)) {}
+		return nextTicket_ - 1;
+	}
+
+	bool UploadManager::IsComplete(uint64_t ticket)
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		while (completedTicket_ < ticket && RetireBatch(false)) {}
+		return completedTicket_ >= ticket;
+	}
+
+	void UploadManager::Wait(uint64_t ticket)
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (recordingBatch_ && recordingBatch_->ticket <= ticket) {
+			SubmitRecordingBatch();
+		}
+		while (completedTicket_ < ticket && RetireBatch(true)) {}
+	}
+
+	void UploadManager::WaitAll()
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (recordingBatch_) {
+			SubmitRecordingBatch();
+		}
+		while (RetireBatch(true)) {}
+	}
+
+	QueueContextType UploadManager::GetQueueType() const
+	{
+		return queueType_;
+	}
+
+	QueueContextType UploadManager::GetDstQueueType() const
+	{
+		return dstQueueType_;
+	}
+
+	TimelineSemaphoreHandle UploadManager::GetTimeline() const
+	{
+		return timeline_;
+	}
+}
\ No newline at end of file